@@ -0,0 +1,159 @@
+#include "Item.h"
+#include "ItemStore.h"
+#include "Mesh.h"
+
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/**
+ * The ItemStore against the vector of the items which keep their own data: the items
+ * are added, the visible items' transformations are read the way the frame reads them
+ * and the random items are removed.
+ */
+
+using namespace custom_scene;
+
+namespace
+{
+
+constexpr std::size_t ItemsCount{1000000};
+
+/** The vector's removal searches the item, so only a part of the items is removed */
+constexpr std::size_t RemovesCount{10000};
+constexpr int IterationsCount{10};
+
+using Items = std::vector<std::shared_ptr<Item>>;
+
+double getMs(const QElapsedTimer& timer)
+{
+    return static_cast<double>(timer.nsecsElapsed()) / 1000000.0;
+}
+
+float sum(const Mat4& transformation)
+{
+    return transformation(0, 3) + transformation(1, 3) + transformation(2, 3);
+}
+
+Items createItems()
+{
+    auto mesh = std::make_shared<Mesh>(3, 3);
+    Items items;
+    items.reserve(ItemsCount);
+
+    for (std::size_t i = 0; i < ItemsCount; i++)
+    {
+        items.push_back(std::make_shared<Item>(mesh, nullptr, nullptr, nullptr));
+        items.back()->setIsVisible(i % 8 != 0);
+    }
+
+    return items;
+}
+
+void benchmarkVector(const Items& items, const Items& removed)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Items vector;
+    for (const auto& item : items)
+    {
+        vector.push_back(item);
+    }
+
+    auto addMs = getMs(timer);
+    float checksum{0.0f};
+    timer.restart();
+
+    for (int i = 0; i < IterationsCount; i++)
+    {
+        for (const auto& item : vector)
+        {
+            if (item->isVisible())
+            {
+                checksum += sum(item->getTransformation());
+            }
+        }
+    }
+
+    auto iterateMs = getMs(timer) / IterationsCount;
+    timer.restart();
+
+    for (const auto& item : removed)
+    {
+        vector.erase(std::find(vector.begin(), vector.end(), item));
+    }
+
+    auto removeMs = getMs(timer);
+
+    std::printf("vector: add %.2f ms, iterate %.2f ms, remove %.2f ms (%f)\n",
+                addMs, iterateMs, removeMs, checksum);
+}
+
+void benchmarkStore(const Items& items, const Items& removed)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    ItemStore store;
+    for (const auto& item : items)
+    {
+        store.add(item);
+    }
+
+    auto addMs = getMs(timer);
+    float checksum{0.0f};
+    timer.restart();
+
+    for (int i = 0; i < IterationsCount; i++)
+    {
+        const auto& transformations = store.getTransformations();
+
+        for (const auto& drawList : store.getDrawLists())
+        {
+            for (auto index : drawList.indices)
+            {
+                checksum += sum(transformations[index]);
+            }
+        }
+    }
+
+    auto iterateMs = getMs(timer) / IterationsCount;
+    timer.restart();
+
+    for (const auto& item : removed)
+    {
+        store.remove(*item);
+    }
+
+    auto removeMs = getMs(timer);
+
+    auto stats = store.getStats();
+    std::printf("store: add %.2f ms, iterate %.2f ms, remove %.2f ms (%f)\n",
+                addMs, iterateMs, removeMs, checksum);
+    std::printf("store: hot %zu bytes, cold %zu bytes\n", stats.hotBytes, stats.coldBytes);
+
+    // the items get their data back for the next run
+    store.clear();
+}
+
+}
+
+int main()
+{
+    auto items = createItems();
+
+    std::mt19937 random(1);
+    Items removed(items);
+    std::shuffle(removed.begin(), removed.end(), random);
+    removed.resize(RemovesCount);
+
+    std::printf("items: %zu, removed: %zu\n", ItemsCount, RemovesCount);
+
+    benchmarkVector(items, removed);
+    benchmarkStore(items, removed);
+
+    return 0;
+}
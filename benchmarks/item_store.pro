@@ -0,0 +1,13 @@
+QT -= gui
+QT += opengl
+
+TEMPLATE = app
+CONFIG += console c++17
+TARGET = item_store
+DESTDIR = ../bin
+
+INCLUDEPATH += ../inc
+LIBS += -L../bin -lcustom_scene
+
+SOURCES += \
+    item_store.cpp
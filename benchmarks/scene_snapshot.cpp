@@ -0,0 +1,132 @@
+#include "Item.h"
+#include "Mesh.h"
+#include "Program.h"
+#include "Scene.h"
+#include "ScenePipe.h"
+#include "Defaults.h"
+
+#include <QElapsedTimer>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+/**
+ * The throughput of the scene's changes: the writers change the items' transformations
+ * and move the items in and out of the pipe while the reader acquires the changes and
+ * reads the store's arrays the way the frame does.
+ */
+
+using namespace custom_scene;
+
+namespace
+{
+
+constexpr std::size_t ItemsCount{100000};
+constexpr qint64 DurationMs{3000};
+
+/** Every n-th change of the writer removes the item and adds it again */
+constexpr std::size_t RemoveInterval{64};
+
+/** The program is not linked, the pipe is not rendered */
+const ShaderSources Sources;
+
+}
+
+int main()
+{
+    auto writersCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+
+    auto pipe = std::make_shared<ScenePipe>(std::make_shared<Program>(Sources),
+                                            defaults::attributes::Vertex);
+    Scene scene({pipe});
+
+    auto mesh = std::make_shared<Mesh>(3, 3);
+    std::vector<std::shared_ptr<Item>> items;
+    items.reserve(ItemsCount);
+
+    for (std::size_t i = 0; i < ItemsCount; i++)
+    {
+        items.push_back(std::make_shared<Item>(mesh, nullptr, nullptr, nullptr));
+    }
+
+    scene.addItems(pipe, items);
+    scene.acquire();
+
+    std::atomic<bool> isRunning{true};
+    std::atomic<std::uint64_t> changesCount{0};
+    std::vector<std::thread> writers;
+
+    for (uint writer = 0; writer < writersCount; writer++)
+    {
+        writers.emplace_back([&, writer]()
+        {
+            // every writer changes its own items
+            auto first = ItemsCount * writer / writersCount;
+            auto last = ItemsCount * (writer + 1) / writersCount;
+            std::uint64_t count{0};
+
+            for (auto i = first; isRunning; i = i + 1 == last ? first : i + 1)
+            {
+                const auto& item = items[i];
+
+                if (++count % RemoveInterval == 0)
+                {
+                    scene.removeItem(pipe, item);
+                    scene.addItem(pipe, item);
+                    continue;
+                }
+
+                Mat4 transformation;
+                transformation.translate(static_cast<float>(count), 0.0f, 0.0f);
+
+                scene.changeItem(pipe, item, [transformation](Item& item)
+                {
+                    item.setTransformation(transformation);
+                });
+            }
+
+            changesCount += count;
+        });
+    }
+
+    std::uint64_t framesCount{0};
+    float checksum{0.0f};
+    QElapsedTimer timer;
+    timer.start();
+
+    while (timer.elapsed() < DurationMs)
+    {
+        scene.acquire();
+
+        const auto& store = pipe->getItemStore();
+        for (const auto& transformation : store.getTransformations())
+        {
+            checksum += transformation(0, 3);
+        }
+
+        framesCount++;
+    }
+
+    isRunning = false;
+
+    for (auto& writer : writers)
+    {
+        writer.join();
+    }
+
+    auto elapsed = static_cast<double>(timer.elapsed()) / 1000.0;
+    auto stats = scene.getStats();
+
+    std::printf("writers: %u, items: %zu, store: %zu\n",
+                writersCount, ItemsCount, pipe->getItemStore().getSize());
+    std::printf("changes: %.0f/s, frames: %.1f/s, applied operations: %.0f/s\n",
+                changesCount / elapsed,
+                framesCount / elapsed,
+                stats.operationsCount / elapsed);
+    std::printf("contentions: %llu, checksum: %f\n",
+                static_cast<unsigned long long>(stats.contentionsCount), checksum);
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+QT -= gui
+QT += opengl
+
+TEMPLATE = app
+CONFIG += console c++17
+TARGET = scene_snapshot
+DESTDIR = ../bin
+
+INCLUDEPATH += ../inc
+LIBS += -L../bin -lcustom_scene
+
+SOURCES += \
+    scene_snapshot.cpp
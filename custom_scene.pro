@@ -6,40 +6,91 @@ CONFIG += staticlib c++17
 DESTDIR = ../bin
 
 SOURCES += \
+    src/BrickPyramid.cpp \
     src/Camera.cpp \
+    src/ChangeJournal.cpp \
+    src/ContextGuard.cpp \
     src/Defaults.cpp \
     src/Generator.cpp \
     src/Geometry.cpp \
     src/Item.cpp \
+    src/ItemStore.cpp \
+    src/JobSystem.cpp \
+    src/LinePipe.cpp \
     src/Manipulator.cpp \
+    src/Material.cpp \
+    src/MaterialTable.cpp \
+    src/Memory.cpp \
     src/Mesh.cpp \
+    src/MeshRegistry.cpp \
+    src/MeshWriter.cpp \
+    src/MultiresolutionPolyline.cpp \
     src/Pipe.cpp \
+    src/PointCloud.cpp \
+    src/PointCloudPipe.cpp \
     src/Program.cpp \
+    src/ProgramCache.cpp \
+    src/ProgramCompiler.cpp \
     src/Projection.cpp \
+    src/RenderThread.cpp \
     src/Scene.cpp \
+    src/SceneGraph.cpp \
     src/ScenePipe.cpp \
+    src/ScenePreparer.cpp \
+    src/StreamBuffer.cpp \
+    src/TerrainPipe.cpp \
+    src/TextureManager.cpp \
+    src/TrackPipe.cpp \
+    src/TransformBuffer.cpp \
     src/Utils.cpp \
-    src/View.cpp
+    src/View.cpp \
+    src/VolumePipe.cpp
 
 HEADERS += \
+    inc/AsyncLoader.h \
+    inc/BrickPyramid.h \
     inc/Camera.h \
+    inc/ChangeJournal.h \
     inc/Common.h \
+    inc/ContextGuard.h \
     inc/Defaults.h \
     inc/Figures.h \
     inc/Generator.h \
     inc/Geometry.h \
     inc/Item.h \
+    inc/ItemStore.h \
+    inc/JobSystem.h \
     inc/Light.h \
+    inc/LinePipe.h \
     inc/Manipulator.h \
     inc/Material.h \
+    inc/MaterialTable.h \
+    inc/Memory.h \
     inc/Mesh.h \
+    inc/MeshRegistry.h \
+    inc/MeshWriter.h \
+    inc/MultiresolutionPolyline.h \
     inc/Pipe.h \
+    inc/PointCloud.h \
+    inc/PointCloudPipe.h \
     inc/Program.h \
+    inc/ProgramCache.h \
+    inc/ProgramCompiler.h \
     inc/Projection.h \
+    inc/RenderThread.h \
     inc/Scene.h \
+    inc/SceneGraph.h \
     inc/ScenePipe.h \
+    inc/ScenePreparer.h \
+    inc/StreamBuffer.h \
+    inc/TerrainPipe.h \
+    inc/TextureManager.h \
+    inc/TrackPipe.h \
+    inc/TransformBuffer.h \
+    inc/TripleBuffer.h \
     inc/Utils.h \
-    inc/View.h
+    inc/View.h \
+    inc/VolumePipe.h
 
 INCLUDEPATH += inc
 
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace custom_scene
+{
+
+/**
+ * The AsyncLoader Class
+ * @brief The background job which loads data by keys, e.g. tiles or chunks from disk.
+ * The job loads one key and schedules itself again while there are requests,
+ * so the loader does not hold the shared JobSystem's worker for the whole session.
+ * The rendering thread requests keys while it traverses its structure and takes the
+ * loaded data at the beginning of the next frame. Requests are served in the order
+ * they are made, the requests which are not needed anymore are dropped by cancel().
+ */
+template<typename Key, typename Value>
+class AsyncLoader
+{
+public:
+    using Loader = std::function<Value(const Key& key)>;
+
+    struct Result
+    {
+        Key key;
+        Value value;
+    };
+
+    AsyncLoader(Loader loader) :
+        mLoader(std::move(loader))
+    {
+    }
+
+    ~AsyncLoader()
+    {
+        // the job is waited for without executing other jobs on the calling thread
+        std::unique_lock lock(mMutex);
+        mIsRunning = false;
+        mCondition.wait(lock, [this]() { return !mIsLoading; });
+    }
+
+    AsyncLoader(const AsyncLoader&) = delete;
+    AsyncLoader& operator=(const AsyncLoader&) = delete;
+
+    /**
+     * @brief Requests the key if it is neither queued nor loaded and not taken yet
+     */
+    void request(const Key& key)
+    {
+        std::lock_guard lock(mMutex);
+
+        if (!mPendingKeys.insert(key).second)
+        {
+            return;
+        }
+
+        mRequests.push_back(key);
+
+        if (!mIsLoading)
+        {
+            mIsLoading = true;
+            schedule();
+        }
+    }
+
+    /**
+     * @brief Drops the requests which are not started yet
+     */
+    void cancel()
+    {
+        std::lock_guard lock(mMutex);
+
+        for (const auto& key : mRequests)
+        {
+            mPendingKeys.erase(key);
+        }
+        mRequests.clear();
+    }
+
+    /**
+     * @brief Takes up to count loaded values, their keys could be requested again
+     */
+    std::vector<Result> take(std::size_t count)
+    {
+        std::vector<Result> results;
+        std::lock_guard lock(mMutex);
+
+        count = std::min(count, mResults.size());
+        results.reserve(count);
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            mPendingKeys.erase(mResults[i].key);
+            results.push_back(std::move(mResults[i]));
+        }
+        mResults.erase(mResults.begin(), mResults.begin() + count);
+
+        return results;
+    }
+
+    std::size_t getPendingCount() const
+    {
+        std::lock_guard lock(mMutex);
+        return mPendingKeys.size();
+    }
+
+private:
+    void schedule()
+    {
+        JobSystem::getInstance().schedule([this]() { run(); });
+    }
+
+    void run()
+    {
+        std::unique_lock lock(mMutex);
+
+        // the next request schedules the job again
+        if (!mIsRunning || mRequests.empty())
+        {
+            mIsLoading = false;
+            mCondition.notify_all();
+            return;
+        }
+
+        auto key = mRequests.front();
+        mRequests.pop_front();
+
+        lock.unlock();
+        auto value = mLoader(key);
+        lock.lock();
+
+        mResults.push_back({key, std::move(value)});
+
+        // the other jobs run between the keys
+        schedule();
+    }
+
+private:
+    Loader mLoader;
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<Key> mRequests;
+    std::unordered_set<Key> mPendingKeys;
+    std::vector<Result> mResults;
+    bool mIsRunning{true};
+    bool mIsLoading{false};
+};
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Figures.h"
+
+#include <array>
+#include <memory_resource>
+
+namespace custom_scene
+{
+
+/**
+ * The BrickPyramid Class
+ * @brief The min/max pyramid of the volume. The volume is split into bricks of
+ * brickSize^3 cells, the level 0 keeps the range of values of every brick, every
+ * next level joins 2x2x2 bricks of the previous one. The pyramid does not depend
+ * on the iso value, so it is built once and reused for all queries.
+ */
+class BrickPyramid
+{
+public:
+    using Brick = std::array<uint, 3>;
+
+    struct Range
+    {
+        float min;
+        float max;
+    };
+
+    /**
+     * @brief Builds the pyramid in parallel
+     * @param volume - the volume, it must outlive the pyramid's queries
+     * @param brickSize - the count of cells in the brick's side
+     */
+    BrickPyramid(const figures::Volume& volume, uint brickSize = 16);
+
+    /**
+     * @brief Collects the bricks which are crossed by the isosurface,
+     * i.e. some of their samples are below the value and some are not
+     * @param value - the iso value
+     * @param resource - the memory resource the result is allocated from
+     * @return The bricks' coordinates
+     */
+    std::pmr::vector<Brick> findBricks(float value,
+                                       std::pmr::memory_resource* resource
+                                       = std::pmr::get_default_resource()) const;
+
+    /**
+     * @brief Collects the bricks which have values inside [min, max]
+     */
+    std::pmr::vector<Brick> findBricks(float min,
+                                       float max,
+                                       std::pmr::memory_resource* resource
+                                       = std::pmr::get_default_resource()) const;
+
+    /** getters */
+    const Range& getRange(const Brick& brick) const;
+    const Brick& getBricksCount() const;
+    uint getBrickSize() const;
+
+    /**
+     * @brief Returns the range of cells [first, last) covered by the brick by each axis
+     */
+    std::array<Brick, 2> getCells(const Brick& brick) const;
+
+private:
+    struct Level
+    {
+        Brick size;
+        std::vector<Range> ranges;
+
+        const Range& at(uint x, uint y, uint z) const;
+    };
+
+    template<typename Predicate>
+    void findBricks(uint level,
+                    const Brick& brick,
+                    const Predicate& predicate,
+                    std::pmr::vector<Brick>& bricks) const;
+
+private:
+    Brick mCellsCount;
+    uint mBrickSize;
+    std::vector<Level> mLevels;
+};
+
+}
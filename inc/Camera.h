@@ -2,6 +2,9 @@
 
 #include "Common.h"
 
+#include <cstdint>
+#include <memory_resource>
+
 namespace custom_scene
 {
 
@@ -160,11 +163,14 @@ public:
      * @brief Projects the screen's points to the OXY plane
      * @param screen_points - the container with screen's points
      * @param world_z - the z coordinate of the OXY plane
+     * @param resource - the memory resource the result is allocated from
      * @return Point's in  world coordinates
      */
-    std::vector<Point3f> toWorldXYCoordinates(
+    std::pmr::vector<Point3f> toWorldXYCoordinates(
             const std::vector<Point2i>& screenPoints,
-            float worldZ = 0.0f);
+            float worldZ = 0.0f,
+            std::pmr::memory_resource* resource
+            = std::pmr::get_default_resource());
 
     /**
      * @brief Projects the screen's point to the camera plane
@@ -179,11 +185,14 @@ public:
      * @brief Projects the screen's point to the camera plane
      * @param screen_points - the container with screen's points
      * @param distance - the relative value of camera plane (0 coresponds to near plane, 1 coresponds to far plane)
+     * @param resource - the memory resource the result is allocated from
      * @return Points in world coordinates
      */
-    std::vector<Point3f> toWorldCoordinates(
+    std::pmr::vector<Point3f> toWorldCoordinates(
             const std::vector<Point2i>& screenPoints,
-            float distance);
+            float distance,
+            std::pmr::memory_resource* resource
+            = std::pmr::get_default_resource());
 
     /** setters */
     void setPitch(float pitch);
@@ -195,6 +204,12 @@ public:
     void setSpeed(float speed);
     void setProjectionIndex(int index);
     void setViewPort(int view_width, int view_height);
+
+    /**
+     * @brief Sets the layers which are shown through the camera
+     * @param layerMask - the bitmask of the layers, all layers are shown by default
+     */
+    void setLayerMask(std::uint32_t layerMask);
     bool isProjectionPerspective() const;
 
     /** getters */
@@ -212,8 +227,21 @@ public:
     const Vec3& getLook() const;
     const Vec3& getLookPoint() const;
     const std::pair<int, int>& getViewPortSize() const;
+    std::uint32_t getLayerMask() const;
+
+    /**
+     * @brief Calculates the size of the pixel in world units
+     * @param distance - the distance from the camera, it is not used by the orthographic projection
+     */
+    float getProjectionKoef(float distance) const;
     std::shared_ptr<Manipulator> getManipulator() const;
 
+    /**
+     * @brief Copies the camera's state, the copy has its own projection and no manipulator,
+     * so it is read by another thread while the camera is changed
+     */
+    std::shared_ptr<Camera> getSnapshot() const;
+
 private:
     void update(bool use_angles = true, bool update_look = false);
     void calculateViewMatrix();
@@ -240,6 +268,7 @@ private:
     std::pair<int, int> mViewPortSize;
     Mat4 mViewMatrix;
     uint mCurrentProjectionIndex;
+    std::uint32_t mLayerMask{0xffffffff};
 };
 
 }
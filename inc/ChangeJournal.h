@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Common.h"
+
+#include <QMetaType>
+#include <memory>
+#include <unordered_map>
+
+namespace custom_scene
+{
+
+class Item;
+class ScenePipe;
+struct Light;
+
+/**
+ * The Changes Structure
+ * @brief The delta of the scene since the previous notification
+ */
+struct Changes
+{
+    template<typename T>
+    struct Delta
+    {
+        std::vector<std::shared_ptr<T>> added;
+        std::vector<std::shared_ptr<T>> removed;
+        std::vector<std::shared_ptr<T>> modified;
+
+        bool isEmpty() const
+        {
+            return added.empty() && removed.empty() && modified.empty();
+        }
+    };
+
+    Delta<ScenePipe> pipes;
+    Delta<Item> items;
+    Delta<Light> lights;
+    Delta<Texture> textures;
+
+    /** The pipes whose items are added, removed or modified */
+    std::vector<std::shared_ptr<ScenePipe>> changedPipes;
+
+    bool isEmpty() const;
+};
+
+/**
+ * The ChangeJournal Class
+ * @brief The class records the scene's changes and coalesces the changes of one object:
+ * the object which is added and removed is dropped, the added and modified one
+ * is added, the removed and added one is modified.
+ */
+class ChangeJournal
+{
+public:
+    void addPipe(std::shared_ptr<ScenePipe> pipe);
+    void removePipe(std::shared_ptr<ScenePipe> pipe);
+
+    void addItem(std::shared_ptr<ScenePipe> pipe, std::shared_ptr<Item> item);
+    void removeItem(std::shared_ptr<ScenePipe> pipe, std::shared_ptr<Item> item);
+    void modifyItem(std::shared_ptr<ScenePipe> pipe, std::shared_ptr<Item> item);
+
+    void addLight(std::shared_ptr<Light> light);
+    void removeLight(std::shared_ptr<Light> light);
+
+    void addTexture(std::shared_ptr<Texture> texture);
+    void removeTexture(std::shared_ptr<Texture> texture);
+
+    bool isEmpty() const;
+
+    /**
+     * @brief Returns the recorded changes and clears the journal
+     */
+    Changes take();
+
+private:
+    enum class Change
+    {
+        kAdded,
+        kRemoved,
+        kModified
+    };
+
+    template<typename T>
+    struct Record
+    {
+        std::shared_ptr<T> object;
+        Change change;
+    };
+
+    template<typename T>
+    using Records = std::unordered_map<const T*, Record<T>>;
+
+    template<typename T>
+    static void record(Records<T>& records, std::shared_ptr<T> object, Change change);
+
+    template<typename T>
+    static void take(Records<T>& records, Changes::Delta<T>& delta);
+
+private:
+    Records<ScenePipe> mPipes;
+    Records<Item> mItems;
+    Records<Light> mLights;
+    Records<Texture> mTextures;
+    std::unordered_map<const ScenePipe*, std::shared_ptr<ScenePipe>> mChangedPipes;
+};
+
+}
+
+Q_DECLARE_METATYPE(custom_scene::Changes)
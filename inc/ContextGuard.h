@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QOpenGLExtraFunctions>
+#include <functional>
+#include <memory>
+
+class QOpenGLContext;
+
+namespace custom_scene
+{
+
+/**
+ * The ContextGuard Class
+ * @brief The guard of the GL objects which are created by their owner in one context.
+ * The objects are deleted only while that context is current: at once if the owner is
+ * destroyed in it, by the context's next collect() if the owner is destroyed elsewhere,
+ * or by releaseAll() which the context's owner calls before the context is destroyed.
+ * So the owner which outlives the context or dies on another thread does not delete
+ * its objects in a dead or foreign context.
+ */
+class ContextGuard
+{
+public:
+    /** Deletes the taken objects, it must not refer to their owner */
+    using Release = std::function<void(QOpenGLExtraFunctions& functions)>;
+
+    /** Takes the owner's objects and leaves the owner uninitialized */
+    using Take = std::function<Release()>;
+
+    ContextGuard() = default;
+    ~ContextGuard();
+
+    ContextGuard(const ContextGuard&) = delete;
+    ContextGuard& operator=(const ContextGuard&) = delete;
+
+    /**
+     * @brief Attaches the owner to the current context, it is called when the objects
+     * are created. The owner which is attached to the context already keeps its take,
+     * the owner which is attached to another context releases its objects first.
+     * @param take - the function which takes the owner's objects
+     */
+    void attach(Take take);
+
+    /**
+     * @brief Releases the owner's objects and detaches the owner,
+     * the owner calls it by its destructor
+     */
+    void release();
+
+    bool isAttached() const;
+
+    /**
+     * @brief Deletes the objects of the owners which are destroyed out of the current
+     * context, it is called every frame
+     */
+    static void collect();
+
+    /**
+     * @brief Releases the objects of all the owners which are attached to the current
+     * context, it is called by the context's owner before the context is destroyed
+     */
+    static void releaseAll();
+
+private:
+    struct State;
+    struct Registry;
+
+    static Registry& getRegistry();
+    static std::shared_ptr<State> getState(QOpenGLContext* context);
+    static void destroy(State& state);
+
+private:
+    std::shared_ptr<State> mState;
+};
+
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Common.h"
+#include "Pipe.h"
+#include "Program.h"
 
 namespace custom_scene
 {
@@ -10,6 +12,56 @@ namespace colors{
 
 
 
+}
+
+namespace attributes
+{
+
+/** The attributes of the Vertex structure: position, normal, color, texture */
+extern const std::vector<Pipe::Attribute> Vertex;
+
+}
+
+namespace shaders
+{
+
+/** The program of the TerrainPipe: the grid patch is displaced by the height map */
+extern const ShaderSources Terrain;
+
+/** The program of the VolumePipe: the volume's box is ray marched through the bricks' atlas */
+extern const ShaderSources Volume;
+
+/** The program of the PointCloudPipe: the points are drawn as round sprites */
+extern const ShaderSources PointCloud;
+
+/** The program of the LinePipe: the segments' instances are expanded to screen-aligned quads */
+extern const ShaderSources Line;
+
+/** The program of the TrackPipe: the segments are read from the tracks' rings of points */
+extern const ShaderSources Track;
+
+/**
+ * The declarations of the vertex shader which reads the item's transformation from
+ * the TransformBuffer: getModel() and getNormal() replace the model and normal uniforms
+ */
+extern const QString TransformFetch;
+
+/**
+ * The declarations of the vertex shader which passes the material's index of the MaterialTable
+ * to the fragment shader, main() writes MaterialIndex = aMaterialIndex
+ */
+extern const QString MaterialIndex;
+
+/**
+ * The declarations of the fragment shader which reads the material from the MaterialTable:
+ * getMaterial() applies the material's maps, getMaterialNormal() applies its normal map.
+ * The maps which are packed by the TextureManager are read from its arrays.
+ */
+extern const QString MaterialFetch;
+
+/** The program of the View's compositor: the rendered frame is drawn by the fullscreen triangle */
+extern const ShaderSources Composite;
+
 }
 }
 }
@@ -20,5 +20,64 @@ struct Cube
     float size;
 };
 
+/** The figures below are generated directly to welded vertices and indices.
+ *  The Z axis is the up axis, figures are centered at the origin. */
+
+struct Sphere
+{
+    float radius;
+    uint slices;
+    uint stacks;
+};
+
+struct Cylinder
+{
+    float radius;
+    float height;
+    uint slices;
+};
+
+struct Cone
+{
+    float radius;
+    float height;
+    uint slices;
+};
+
+struct Torus
+{
+    float majorRadius;
+    float minorRadius;
+    uint slices;
+    uint rings;
+};
+
+struct Grid
+{
+    float width;
+    float height;
+    uint columns;
+    uint rows;
+};
+
+struct Heightfield
+{
+    const float* heights;
+    uint columns;
+    uint rows;
+    float cellSize;
+    float heightScale;
+};
+
+/** The scalar field sampled on the regular grid, x changes fastest */
+struct Volume
+{
+    const float* values;
+    uint width;
+    uint height;
+    uint depth;
+    float cellSize;
+};
+
 }
 }
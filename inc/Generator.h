@@ -1,7 +1,10 @@
 #pragma once
 
+#include "BrickPyramid.h"
 #include "Geometry.h"
 #include "Figures.h"
+#include "Mesh.h"
+#include "MeshWriter.h"
 
 #define GENERATE custom_scene::Generator::generate
 
@@ -16,13 +19,109 @@ namespace custom_scene
 class Generator
 {
  public:
+    struct Size
+    {
+        uint verticesCount;
+        uint indicesCount;
+    };
+
     /**
      * @brief The set of functions for geometry generation
      * @param figure - the data structure containing the figure's geometry
+     * @param resource - the memory resource the geometry is allocated from
      * @return the container with points
      */
-    static Geometry generate(const figures::Cube& figure);
-    static Geometry generate(const figures::Quad& figure);
+    static Geometry generate(const figures::Cube& figure,
+                             std::pmr::memory_resource* resource
+                             = std::pmr::get_default_resource());
+    static Geometry generate(const figures::Quad& figure,
+                             std::pmr::memory_resource* resource
+                             = std::pmr::get_default_resource());
+
+    /**
+     * @brief The set of functions which return the count of vertices and indices of the figure
+     * @param figure - the data structure containing the figure's parameters
+     * @return the size of the figure's mesh
+     */
+    static Size getSize(const figures::Sphere& figure);
+    static Size getSize(const figures::Cylinder& figure);
+    static Size getSize(const figures::Cone& figure);
+    static Size getSize(const figures::Torus& figure);
+    static Size getSize(const figures::Grid& figure);
+    static Size getSize(const figures::Heightfield& figure);
+
+    /**
+     * @brief The set of kernels which write welded vertices and indices of the figure
+     * @param figure - the data structure containing the figure's parameters
+     * @param vertices - the output vertices, there must be getSize(figure).verticesCount of them
+     * @param indices - the output indices, there must be getSize(figure).indicesCount of them
+     */
+    static void generate(const figures::Sphere& figure, Vertex* vertices, uint* indices);
+    static void generate(const figures::Cylinder& figure, Vertex* vertices, uint* indices);
+    static void generate(const figures::Cone& figure, Vertex* vertices, uint* indices);
+    static void generate(const figures::Torus& figure, Vertex* vertices, uint* indices);
+    static void generate(const figures::Grid& figure, Vertex* vertices, uint* indices);
+    static void generate(const figures::Heightfield& figure, Vertex* vertices, uint* indices);
+
+    /**
+     * @brief Generates the figure's mesh
+     * @param figure - the data structure containing the figure's parameters
+     * @param resource - the memory resource the mesh is allocated from
+     * @return the mesh
+     */
+    template<typename Figure>
+    static Mesh generateMesh(const Figure& figure,
+                             std::pmr::memory_resource* resource
+                             = std::pmr::get_default_resource())
+    {
+        auto size = getSize(figure);
+        Mesh mesh(size.verticesCount, size.indicesCount, resource);
+
+        generate(figure, mesh.getVertices().data(), mesh.getIndices().data());
+
+        return mesh;
+    }
+
+    /**
+     * @brief Extracts the isosurface of the volume by marching cubes. Only the bricks
+     * crossed by the surface are visited, they are processed in parallel. Every worker
+     * welds the vertices inside its bricks, the vertices on the bricks' faces are welded
+     * when the workers' results are merged. The normals point to the lower values.
+     * @param volume - the scalar field
+     * @param isoValue - the value of the surface, the values above it are inside
+     * @param pyramid - the min/max pyramid of the volume, it is reused for every iso value
+     * @param resource - the memory resource the mesh is allocated from
+     * @return the welded mesh
+     */
+    static Mesh generateMesh(const figures::Volume& volume,
+                             float isoValue,
+                             const BrickPyramid& pyramid,
+                             std::pmr::memory_resource* resource
+                             = std::pmr::get_default_resource());
+    static Mesh generateMesh(const figures::Volume& volume,
+                             float isoValue,
+                             std::pmr::memory_resource* resource
+                             = std::pmr::get_default_resource());
+
+    /**
+     * @brief Generates the figure directly to the mapped range of the pipe's buffers
+     * @param figure - the data structure containing the figure's parameters
+     * @param writer - the writer which was created for getSize(figure)
+     * @return False if the figure does not fit the writer's range, nothing is written then
+     */
+    template<typename Figure>
+    static bool generate(const Figure& figure, MeshWriter& writer)
+    {
+        auto size = getSize(figure);
+
+        if (!writer.isFitting(size.verticesCount, size.indicesCount))
+        {
+            return false;
+        }
+
+        generate(figure, writer.getVertices(), writer.getIndices());
+        return true;
+    }
 };
 
 }  // namespace gl_scene
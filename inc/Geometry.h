@@ -2,6 +2,8 @@
 
 #include "Common.h"
 
+#include <memory_resource>
+
 namespace custom_scene
 {
 
@@ -18,12 +20,18 @@ struct Geometry
     template<typename T>
     struct Attribute
     {
-        std::vector<T> data;
-        std::vector<uint> indices;
+        Attribute(std::pmr::memory_resource* resource
+                  = std::pmr::get_default_resource());
+
+        std::pmr::vector<T> data;
+        std::pmr::vector<uint> indices;
 
         Attribute& operator+=(const Attribute& rhv);
     };
 
+    Geometry(std::pmr::memory_resource* resource
+             = std::pmr::get_default_resource());
+
     Attribute<Point3f> points;
     Attribute<Point3f> normals;
     Attribute<Point3f> colors;
@@ -4,12 +4,23 @@
 #include "Geometry.h"
 #include "Mesh.h"
 
+#include <cstdint>
+#include <memory>
+
 namespace custom_scene
 {
 
 struct Material;
 class Pipe;
+class ItemStore;
 
+/**
+ * The Item Class
+ * @brief The facade of the item's data. The item which is added to the pipe keeps
+ * its data in the pipe's ItemStore, the item which is not in any pipe keeps it itself.
+ * The store is changed by the renderer, so the item which is in a pipe is read and
+ * changed by the renderer only, the other threads change it by Scene::changeItem().
+ */
 class Item
 {
 public:
@@ -22,37 +33,95 @@ public:
         std::vector<GLenum> disableAttributes;
     };
 
+    /** The shared resources, they are not used by the per-frame passes */
+    struct Resources
+    {
+        std::shared_ptr<Mesh> mesh;
+        std::shared_ptr<RenderParameters> renderParameters;
+        std::shared_ptr<Material> material;
+        std::shared_ptr<Texture> texture;
+    };
+
+    struct DrawRange
+    {
+        uint startIndex;
+        uint elementsCount;
+        uint baseVertex;
+    };
+
+    /** The box of the mesh's vertices in the item's coordinates */
+    struct Bounds
+    {
+        Vec3 min;
+        Vec3 max;
+    };
+
     Item(const std::shared_ptr<Mesh> mesh,
          std::shared_ptr<RenderParameters> renderParameters,
          std::shared_ptr<Material> material,
          std::shared_ptr<Texture> texture);
 
+    Item(const Item&) = delete;
+    Item& operator=(const Item&) = delete;
+
     void setMesh(const std::shared_ptr<Mesh> mesh);
     const std::shared_ptr<Mesh> getMesh() const;
 
-    void updateIndices(uint startIndex);
+    void updateIndices(uint startIndex, uint baseVertex = 0);
+    void updateIndices(uint startIndex, uint elementsCount, uint baseVertex);
     uint getElementsStartIndex() const;
     uint getElementsCount() const;
+    uint getBaseVertex() const;
 
     void setTransformation(const Mat4& transformation);
     const Mat4& getTransformation() const;
 
+    /**
+     * @brief The version is unique among all items and changes with every
+     * transformation, so the copies of the transformation know when they are stale
+     */
+    std::uint64_t getTransformationVersion() const;
+
     bool isVisible() const;
     void setIsVisible(bool isVisible);
 
+    /**
+     * @brief Sets the layers the item belongs to, the item is drawn by the view
+     * whose layer mask has any of them
+     * @param layers - the bitmask of the layers, the item is in the layer 0 by default
+     */
+    void setLayers(std::uint32_t layers);
+    std::uint32_t getLayers() const;
+
+    const Bounds& getBounds() const;
     RenderParameters* getRenderParameters() const;
     Material* getMaterial() const;
     Texture* getTexture() const;
 
+    /** @return The store which keeps the item's data, null if the item is not in a pipe */
+    ItemStore* getStore() const;
+
+private:
+    friend class ItemStore;
+
+    /** The item's data while it is not in a store */
+    struct Data
+    {
+        Resources resources;
+        Mat4 transformation;
+        std::uint64_t transformationVersion;
+        DrawRange range;
+        Bounds bounds;
+        std::uint32_t layers;
+        bool isVisible;
+    };
+
+    uint getIndex() const;
+
 private:
-    std::shared_ptr<Mesh> mMesh;
-    std::shared_ptr<RenderParameters> mRenderParameters;
-    std::shared_ptr<Material> mMaterial;
-    std::shared_ptr<Texture> mTexture;    
-    Mat4 mTransformation;
-    bool mIsVisible{true};
-    uint mElementsStartIndex{0};
-    uint mElementsCount{0};
+    std::unique_ptr<Data> mData;
+    ItemStore* mStore{nullptr};
+    uint mSlot{0};
 };
 
 }
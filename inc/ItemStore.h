@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Item.h"
+
+#include <limits>
+#include <unordered_map>
+
+namespace custom_scene
+{
+
+/**
+ * The ItemStore Class
+ * @brief The slot map of the pipe's items. The data which is read every frame
+ * (transformations, draw ranges, bounds, state keys and flags) is kept in the dense
+ * arrays, one element per item, the shared resources are kept apart. The removal
+ * moves the last item to the removed one's place, so the arrays have no gaps and
+ * adding and removing take constant time. The handle stays valid while the item is
+ * in the store, the items' indices in the arrays change with removals.
+ * The visible items are kept in the draw lists, one list per combination of layers,
+ * the lists are changed by the items' changes only, so the view's layer mask
+ * selects the lists to draw without going through the items.
+ */
+class ItemStore
+{
+public:
+    using Handle = std::uint64_t;
+    using Items = std::vector<std::shared_ptr<Item>>;
+
+    static constexpr Handle InvalidHandle{std::numeric_limits<Handle>::max()};
+
+    /** The bits of the flags */
+    static constexpr std::uint8_t VisibleFlag{1};
+
+    /** The indices of the visible items which have the same layers */
+    struct DrawList
+    {
+        std::uint32_t layers;
+        std::vector<uint> indices;
+    };
+
+    struct Stats
+    {
+        std::size_t itemsCount;
+        std::size_t drawListsCount;
+        std::size_t slotsCount;
+        std::size_t freeSlotsCount;
+        std::size_t hotBytes;
+        std::size_t coldBytes;
+        std::size_t addsCount;
+        std::size_t removesCount;
+    };
+
+    ItemStore() = default;
+    ~ItemStore();
+
+    ItemStore(const ItemStore&) = delete;
+    ItemStore& operator=(const ItemStore&) = delete;
+
+    /**
+     * @brief Moves the item's data to the store, the item is removed from its previous store
+     * @return The item's handle, the same one if the item is already in the store
+     */
+    Handle add(std::shared_ptr<Item> item);
+
+    /**
+     * @brief Moves the item's data back to the item
+     */
+    void remove(Handle handle);
+    void remove(const Item& item);
+
+    void clear();
+
+    bool isValid(Handle handle) const;
+    Handle getHandle(const Item& item) const;
+
+    /** @return The index of the item in the arrays */
+    uint getIndex(Handle handle) const;
+
+    std::size_t getSize() const;
+    bool isEmpty() const;
+
+    /** The arrays, indexed by the items' indices */
+    const Items& getItems() const;
+    const std::vector<Mat4>& getTransformations() const;
+    const std::vector<std::uint64_t>& getTransformationVersions() const;
+    const std::vector<Item::DrawRange>& getDrawRanges() const;
+    const std::vector<Item::Bounds>& getBounds() const;
+    const std::vector<std::uint64_t>& getStateKeys() const;
+    const std::vector<std::uint8_t>& getFlags() const;
+    const std::vector<std::uint32_t>& getLayers() const;
+    const std::vector<Item::Resources>& getResources() const;
+    const std::vector<DrawList>& getDrawLists() const;
+
+    Stats getStats() const;
+
+    /**
+     * @brief The key of the GL state which the item is drawn with,
+     * the items with equal keys are drawn without the state changes
+     */
+    static std::uint64_t getStateKey(const Item::Resources& resources);
+
+private:
+    friend class Item;
+
+    static constexpr uint InvalidIndex{std::numeric_limits<uint>::max()};
+
+    void setDrawState(uint index, bool isVisible, std::uint32_t layers);
+    void insertDrawable(uint index);
+    void eraseDrawable(uint index);
+    DrawList& getDrawList(std::uint32_t layers);
+
+private:
+    /** By slots */
+    std::vector<uint> mIndices;
+    std::vector<uint> mGenerations;
+    std::vector<uint> mFreeSlots;
+
+    /** By indices */
+    std::vector<uint> mSlots;
+    std::vector<Mat4> mTransformations;
+    std::vector<std::uint64_t> mTransformationVersions;
+    std::vector<Item::DrawRange> mDrawRanges;
+    std::vector<Item::Bounds> mBounds;
+    std::vector<std::uint64_t> mStateKeys;
+    std::vector<std::uint8_t> mFlags;
+    std::vector<std::uint32_t> mLayers;
+    std::vector<uint> mDrawPositions;
+    std::vector<Item::Resources> mResources;
+    Items mItems;
+
+    std::vector<DrawList> mDrawLists;
+    std::unordered_map<std::uint32_t, uint> mDrawListIndices;
+
+    std::size_t mAddsCount{0};
+    std::size_t mRemovesCount{0};
+};
+
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "Common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace custom_scene
+{
+
+/**
+ * The JobSystem Class
+ * @brief The pool of workers which is shared by the library, so the subsystems do not
+ * start their own threads. Every worker has its own queue: it takes its newest job first
+ * and steals the oldest jobs of other workers when its queue is empty. The jobs scheduled
+ * by other threads are taken from the shared queue. The job starts when its dependencies
+ * are done. The states and jobs of parallelFor are reused and the queues grow only,
+ * so the warmed up frames do not allocate.
+ */
+class JobSystem
+{
+public:
+    struct Job;
+    using Function = std::function<void()>;
+    using Handle = std::shared_ptr<Job>;
+
+    struct Parameters
+    {
+        /** The count of workers, 0 means the count of hardware threads */
+        uint workersCount{0};
+        /** Pins the worker to the core of its number, it is supported on Linux only */
+        bool isAffinity{false};
+    };
+
+    struct Stats
+    {
+        uint workersCount{0};
+        std::uint64_t scheduledCount{0};
+        std::uint64_t executedCount{0};
+        /** The jobs which are taken from the queues of other workers */
+        std::uint64_t stolenCount{0};
+        /** The jobs whose dependencies are not done yet */
+        std::uint64_t waitingCount{0};
+        /** The jobs which are ready but not started yet */
+        std::uint64_t queuedCount{0};
+        std::uint64_t parallelForsCount{0};
+    };
+
+    /**
+     * @brief Sets the parameters of the pool, it is called before the pool is used
+     * @return False if the pool is already started
+     */
+    static bool configure(const Parameters& parameters);
+
+    /** @return The shared pool, it is started by the first call */
+    static JobSystem& getInstance();
+
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /**
+     * @brief Schedules the job
+     * @param function - the job's function
+     * @param dependencies - the jobs which are done before the job starts
+     * @return The handle which is waited for or passed as the dependency
+     */
+    Handle schedule(Function function, const std::vector<Handle>& dependencies = {});
+
+    /**
+     * @brief Waits for the job, the calling thread executes other jobs meanwhile
+     */
+    void wait(const Handle& job);
+
+    static bool isDone(const Handle& job);
+
+    /**
+     * @brief Calls the function for every index in [0, count) on several workers.
+     * Workers take the indices one by one, so the items could have a different cost.
+     * The calling thread is the worker 0, the function returns when all items are done.
+     * The workers which do not start in time are not waited for.
+     * The function is referred to, not copied, so its captures are not allocated.
+     * @param count - the count of items
+     * @param function - the function which takes the item's index and the worker's number
+     * @param workersCount - the count of workers, 0 means getWorkersCount()
+     */
+    template<typename Function>
+    void parallelFor(std::size_t count, const Function& function, uint workersCount = 0)
+    {
+        parallelFor(count, &function, [](const void* function, std::size_t index, uint worker)
+        {
+            (*static_cast<const Function*>(function))(index, worker);
+        }, workersCount);
+    }
+
+    /**
+     * @brief Maps every index in [0, count) to the value and reduces the values,
+     * the reduction must be associative and commutative
+     * @param identity - the value which does not change the reduced one
+     * @param map - the function which takes the index and returns the value
+     * @param reduce - the function which takes two values and returns the reduced one
+     */
+    template<typename T, typename Map, typename Reduce>
+    T parallelReduce(std::size_t count,
+                     T identity,
+                     const Map& map,
+                     const Reduce& reduce,
+                     uint workersCount = 0)
+    {
+        if (workersCount == 0)
+        {
+            workersCount = getWorkersCount();
+        }
+
+        std::vector<T> partials(workersCount, identity);
+
+        parallelFor(count, [&](std::size_t index, uint worker)
+        {
+            partials[worker] = reduce(partials[worker], map(index));
+        }, workersCount);
+
+        for (const auto& partial : partials)
+        {
+            identity = reduce(identity, partial);
+        }
+
+        return identity;
+    }
+
+    uint getWorkersCount() const;
+    Stats getStats() const;
+
+private:
+    /** Calls the function which is referred to by parallelFor */
+    using IndexFunction = void (*)(const void* function, std::size_t index, uint worker);
+
+    struct ParallelFor;
+
+    /** The ring of the jobs, it grows when it is full and keeps its capacity */
+    struct Queue
+    {
+        std::mutex mutex;
+        std::vector<Handle> jobs;
+        std::size_t first{0};
+        std::size_t count{0};
+
+        void pushBack(Handle job);
+        Handle popBack();
+        Handle popFront();
+    };
+
+    explicit JobSystem(const Parameters& parameters);
+
+    void parallelFor(std::size_t count, const void* function, IndexFunction invoke, uint workersCount);
+
+    /** @return The state which is not used by any job, it is taken under the pool's lock */
+    ParallelFor& acquireParallelFor();
+
+    /** @return The finished job which is not referred to by anyone but the pool */
+    Handle acquireJob();
+
+    void run(uint worker);
+    void release(const Handle& job);
+    void push(Handle job);
+    Handle pop();
+    void execute(const Handle& job);
+
+private:
+    /** The workers' queues and the shared one at the end */
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::atomic<std::size_t> mQueuedCount{0};
+    bool mIsRunning{true};
+
+    std::mutex mPoolMutex;
+    std::vector<std::unique_ptr<ParallelFor>> mParallelFors;
+    std::vector<Handle> mJobs;
+
+    std::atomic<std::uint64_t> mScheduledCount{0};
+    std::atomic<std::uint64_t> mExecutedCount{0};
+    std::atomic<std::uint64_t> mStolenCount{0};
+    std::atomic<std::uint64_t> mWaitingCount{0};
+    std::atomic<std::uint64_t> mParallelForsCount{0};
+};
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "ScenePipe.h"
+#include "MultiresolutionPolyline.h"
+#include "ContextGuard.h"
+
+#include <cstdint>
+
+namespace custom_scene
+{
+
+/**
+ * The LinePipe Class
+ * @brief The pipe renders thick polylines. Every segment is one instance which is
+ * expanded to the screen-aligned quad in the vertex shader, so the width is in pixels
+ * and does not depend on glLineWidth. The segments keep their neighbours' points for
+ * the joins, all segments of the pipe are drawn by one instanced draw call.
+ * The multiresolution polylines are simplified for the view every frame and
+ * drawn by the second instanced draw call.
+ * The pipe works with the defaults::shaders::Line program.
+ */
+class LinePipe : public ScenePipe
+{
+public:
+    enum class Join
+    {
+        kMiter,
+        kRound
+    };
+
+    enum class Cap
+    {
+        kButt,
+        kSquare,
+        kRound
+    };
+
+    /**
+     * @brief The polyline, the widths in pixels and the colors are set per segment
+     * or one value is set for all segments
+     */
+    struct Polyline
+    {
+        std::vector<Vec3> points;
+        std::vector<float> widths;
+        std::vector<Color> colors;
+        Join join;
+        Cap cap;
+        bool isClosed;
+    };
+
+    using Handle = uint;
+
+    /**
+     * @brief Constructor for LinePipe
+     * @param program - the line program
+     * @param miterLimit - the maximal length of the miter join relative to the half width
+     */
+    LinePipe(std::shared_ptr<Program> program, float miterLimit = 4.0f);
+    ~LinePipe() override;
+
+    Handle addPolyline(const Polyline& polyline);
+
+    /**
+     * @brief Adds the polyline which is simplified for the view every frame
+     * @param polyline - the preprocessed polyline
+     * @param width - the width of all segments in pixels
+     * @param color - the color of all segments
+     */
+    Handle addPolyline(std::shared_ptr<const MultiresolutionPolyline> polyline,
+                       float width,
+                       const Color& color,
+                       Join join,
+                       Cap cap);
+
+    void removePolyline(Handle handle);
+    void clearPolylines();
+
+    void render(std::shared_ptr<Camera> camera,
+                const Lights& lights,
+                const Textures& textures) override;
+
+    /**
+     * @brief Sets the maximal deviation of the simplified polylines in pixels
+     */
+    void setPixelTolerance(float tolerance);
+
+    /**
+     * @brief Returns the count of the segments of the last frame
+     */
+    std::size_t getSegmentsCount() const;
+
+    /**
+     * @brief Packs the join and the cap to the style bits of the line program,
+     * the bits of the neighbours are not set
+     */
+    static std::uint32_t getStyle(Join join, Cap cap);
+
+private:
+    /** The instance's layout of the segment */
+    struct Segment
+    {
+        Point3f previous;
+        Point3f start;
+        Point3f end;
+        Point3f next;
+        float width;
+        std::uint32_t color;
+        std::uint32_t style;
+    };
+
+    struct Span
+    {
+        std::size_t first;
+        std::size_t count;
+    };
+
+    struct SimplifiedPolyline
+    {
+        std::shared_ptr<const MultiresolutionPolyline> polyline;
+        float width;
+        std::uint32_t color;
+        std::uint32_t style;
+    };
+
+    void createVertexArray(GLuint& vertexArray, GLuint& buffer);
+    void upload();
+    void uploadSimplified(const Camera& camera);
+
+    /** Takes the arrays and buffers, the segments are uploaded again by the next frame */
+    ContextGuard::Release takeArrays();
+
+private:
+    float mMiterLimit;
+    std::vector<Segment> mSegments;
+    std::unordered_map<Handle, Span> mPolylines;
+    Handle mNextHandle{0};
+    GLuint mVertexArray{0};
+    GLuint mBuffer{0};
+    std::size_t mBufferCapacity{0};
+    bool mIsUploaded{false};
+    std::unordered_map<Handle, SimplifiedPolyline> mSimplifiedPolylines;
+    float mPixelTolerance{0.5f};
+    GLuint mSimplifiedVertexArray{0};
+    GLuint mSimplifiedBuffer{0};
+    std::size_t mSimplifiedCapacity{0};
+    std::size_t mSimplifiedSegmentsCount{0};
+    ContextGuard mContextGuard;
+};
+
+}
@@ -2,31 +2,64 @@
 
 #include "Common.h"
 
+#include <memory>
+
 namespace custom_scene
 {
 
+/**
+ * The Material Structure
+ * @brief The base of the materials, the type tag tells the material's structure
+ * to the renderer and to the shaders without RTTI
+ */
 struct Material
 {
+    enum class Type
+    {
+        kStandart,
+        kTextured,
+        kBumped
+    };
+
+    /** The texture units of the material's maps */
+    static constexpr GLint DiffuseUnit{8};
+    static constexpr GLint SpecularUnit{9};
+    static constexpr GLint NormalUnit{10};
+    static constexpr GLint DisplacementUnit{11};
+
+    explicit Material(Type type);
     virtual ~Material() = default;
 
-    float shininess;
+    /**
+     * @brief Binds the material's maps to their units, the standart material has none
+     */
+    void bindMaps() const;
+
+    const Type type;
+    float shininess{32.0f};
 };
 
 struct StandartMaterial : Material {
+    StandartMaterial();
+
     Vec3 ambient;
     Vec3 diffuse;
     Vec3 specular;
 };
 
 struct TexturedMaterial : Material {
-    Texture diffuse;
-    Texture specular;
+    TexturedMaterial();
+
+    std::shared_ptr<Texture> diffuse;
+    std::shared_ptr<Texture> specular;
 };
 
 struct BumpedMaterial : Material {
-    Texture diffuse;
-    Texture normal;
-    Texture displacement;
+    BumpedMaterial();
+
+    std::shared_ptr<Texture> diffuse;
+    std::shared_ptr<Texture> normal;
+    std::shared_ptr<Texture> displacement;
 };
 
 }
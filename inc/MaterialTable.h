@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Common.h"
+#include "ContextGuard.h"
+
+#include <QOpenGLExtraFunctions>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace custom_scene
+{
+
+struct Material;
+class Program;
+class TextureManager;
+
+/**
+ * The MaterialTable Class
+ * @brief The buffer texture of the pipe's materials, the item's shader reads its material
+ * by the index instead of the material's uniforms, so the change of the material between
+ * the draws sets one attribute. The entry keeps the material's colors, shininess, type tag
+ * and the bitmask of its maps, it is packed by the type tag without RTTI. The materials are
+ * added by the first draw and held weakly, the entries of the released materials are reused.
+ * The changed materials are found by comparing the packed entries, only they are written.
+ * With the TextureManager the entry keeps the locations of the material's packed maps,
+ * so only the material whose maps are not packed binds them. The maps are packed by add()
+ * and update() before the arrays are bound, the draws do not pack them.
+ * The shaders read the table with defaults::shaders::MaterialIndex and MaterialFetch.
+ */
+class MaterialTable : protected QOpenGLExtraFunctions
+{
+public:
+    /** The texture unit the table is bound to */
+    static constexpr GLint TextureUnit{6};
+
+    /** The location of the material's index, the attribute has no array, its current value is set */
+    static constexpr GLuint IndexLocation{5};
+
+    static constexpr uint InvalidIndex{std::numeric_limits<uint>::max()};
+
+    /** The bits of the entry's maps */
+    static constexpr uint DiffuseMap{1};
+    static constexpr uint SpecularMap{2};
+    static constexpr uint NormalMap{4};
+    static constexpr uint DisplacementMap{8};
+
+    MaterialTable() = default;
+    ~MaterialTable();
+
+    MaterialTable(const MaterialTable&) = delete;
+    MaterialTable& operator=(const MaterialTable&) = delete;
+
+    /**
+     * @brief Adds the material which is not in the table yet, its entry is written at once
+     * and its maps are packed, so it is called before bind()
+     * @return The material's index in the table
+     */
+    uint add(const std::shared_ptr<Material>& material);
+
+    /**
+     * @brief Writes the entries of the changed materials and frees the entries
+     * of the released ones, it is called before the frame's draws
+     */
+    void update();
+
+    /**
+     * @brief Binds the buffer texture and sets the units of the maps to the program
+     */
+    void bind(Program& program);
+
+    /**
+     * @brief Sets the index of the material which is drawn next and binds its maps.
+     * The material which is not added before bind() is added without packing its maps,
+     * they are bound by the draws until the next update packs them.
+     */
+    void setMaterial(const std::shared_ptr<Material>& material);
+
+    /**
+     * @brief Packs the materials' maps to the manager's arrays, the entries are written
+     * with the maps' locations by the next update
+     */
+    void setTextureManager(std::shared_ptr<TextureManager> manager);
+    std::shared_ptr<TextureManager> getTextureManager() const;
+
+    uint getIndex(const Material* material) const;
+
+    /** @return The count of the materials in the table */
+    std::size_t getSize() const;
+
+    /** @return The count of the entries written since the last update */
+    std::size_t getWrittenCount() const;
+
+private:
+    void initialize();
+    void reserve(std::size_t materialsCount);
+    uint insert(const std::shared_ptr<Material>& material, bool isPacking);
+    void write(uint index, const Material& material, bool isPacking);
+
+    /** Takes the buffer and its texture, the entries are written again by the next update */
+    ContextGuard::Release take();
+
+private:
+    GLuint mBuffer{0};
+    GLuint mTexture{0};
+    uint mCapacity{0};
+    std::size_t mWrittenCount{0};
+
+    /** By indices, the records are the copy of the buffer */
+    std::vector<std::weak_ptr<Material>> mMaterials;
+    std::vector<const Material*> mKeys;
+    /** The materials whose maps are bound because some of them is not packed */
+    std::vector<bool> mIsBinding;
+    std::vector<float> mRecords;
+    std::vector<uint> mFreeIndices;
+    std::unordered_map<const Material*, uint> mIndices;
+    std::shared_ptr<TextureManager> mTextureManager;
+    bool mIsInitialized{false};
+    ContextGuard mContextGuard;
+};
+
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <memory_resource>
+
+namespace custom_scene
+{
+
+namespace memory
+{
+
+/**
+ * The CountingResource Class
+ * @brief The memory resource which forwards requests to the upstream resource
+ * and counts them. It is used to check how often the library goes to the heap.
+ */
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    struct Statistics
+    {
+        std::size_t allocations;
+        std::size_t deallocations;
+        std::size_t bytesAllocated;
+        std::size_t bytesInUse;
+    };
+
+    CountingResource(std::pmr::memory_resource* upstream
+                     = std::pmr::new_delete_resource());
+
+    Statistics getStatistics() const;
+    void resetStatistics();
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* pointer,
+                       std::size_t bytes,
+                       std::size_t alignment) override;
+    bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    std::pmr::memory_resource* mUpstream;
+    std::atomic<std::size_t> mAllocations{0};
+    std::atomic<std::size_t> mDeallocations{0};
+    std::atomic<std::size_t> mBytesAllocated{0};
+    std::atomic<std::size_t> mBytesInUse{0};
+};
+
+/**
+ * The Arena Class
+ * @brief The monotonic arena for transient data. Memory is never freed
+ * piecemeal, everything is released at once by reset(). The arena remembers
+ * how much it has spilled to the heap since the last reset and grows its
+ * own block accordingly, so a warmed up arena makes no heap allocations.
+ * The arena is not thread safe, every thread uses its own one.
+ */
+class Arena
+{
+    static constexpr std::size_t DefaultInitialSize{64 * 1024};
+
+public:
+    Arena(std::size_t initialSize = DefaultInitialSize,
+          std::pmr::memory_resource* upstream = nullptr);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief Releases all the memory allocated from the arena
+     */
+    void reset();
+
+    /** getters */
+    std::pmr::memory_resource* getResource();
+    std::size_t getCapacity() const;
+    std::size_t getHeapAllocationsCount() const;
+
+private:
+    friend class ArenaScope;
+
+    std::pmr::memory_resource* mUpstream;
+    CountingResource mSpill;
+    void* mBuffer{nullptr};
+    std::size_t mCapacity{0};
+    std::size_t mHeapAllocationsCount{0};
+    int mScopeDepth{0};
+    std::optional<std::pmr::monotonic_buffer_resource> mResource;
+};
+
+/**
+ * The ArenaScope Class
+ * @brief The guard for the nested usage of an arena. The arena is reset when
+ * the outermost scope is left, so the helpers which build transient data
+ * in the arena could call each other safely.
+ */
+class ArenaScope
+{
+public:
+    ArenaScope(Arena& arena);
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    std::pmr::memory_resource* getResource();
+
+private:
+    Arena& mArena;
+};
+
+/**
+ * The HeapCheck Class
+ * @brief The check of the frames which must not go to the heap. It counts the global
+ * operator new calls of the calling thread between begin() and end(), the frame which
+ * does not change the scene after the warm up must make none. The operators are counted
+ * when the library is built with SHOW_DEBUG, otherwise the count is zero.
+ */
+class HeapCheck
+{
+    static constexpr std::size_t WarmUpFramesCount{60};
+
+public:
+    void begin();
+
+    /**
+     * @brief Finishes the frame's count
+     * @param version - the scene's version which is rendered by the frame
+     * @return False if the warmed up frame of the unchanged scene goes to the heap
+     */
+    bool end(std::uint64_t version);
+
+    /** @return The count of the last frame's operator new calls */
+    std::size_t getCount() const;
+
+private:
+    std::size_t mStart{0};
+    std::size_t mCount{0};
+    std::size_t mFramesCount{0};
+    std::uint64_t mVersion{0};
+};
+
+/**
+ * @brief The count of the global operator new calls made by the calling thread
+ */
+extern std::size_t getNewCount();
+
+/**
+ * @brief The resource which counts all heap allocations made by the library arenas
+ */
+extern CountingResource* getHeapResource();
+
+/**
+ * @brief The calling thread's arena for transient builds (combined meshes, batch conversions)
+ */
+extern Arena& getTransientArena();
+
+/**
+ * @brief The calling thread's scratch arena which lives for one frame.
+ * It is reset by View::paintGL at the beginning of each frame.
+ */
+extern Arena& getFrameArena();
+
+}
+}
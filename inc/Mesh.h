@@ -2,6 +2,8 @@
 
 #include "Geometry.h"
 
+#include <functional>
+
 namespace custom_scene
 {
 
@@ -13,22 +15,52 @@ namespace custom_scene
 class Mesh
 {
 public:
-    Mesh();
-    Mesh(const Geometry& geometry, std::function<void(Vertex&)> processor);
+    Mesh(std::pmr::memory_resource* resource
+         = std::pmr::get_default_resource());
+    Mesh(const Geometry& geometry,
+         std::function<void(Vertex&)> processor,
+         std::pmr::memory_resource* resource
+         = std::pmr::get_default_resource());
+    Mesh(std::size_t verticesCount,
+         std::size_t indicesCount,
+         std::pmr::memory_resource* resource
+         = std::pmr::get_default_resource());
 
     /** getters */
-    const std::vector<Vertex>& getVertices() const;
-    const std::vector<uint>& getIndices() const;
+    const std::pmr::vector<Vertex>& getVertices() const;
+    const std::pmr::vector<uint>& getIndices() const;
+    std::pmr::vector<Vertex>& getVertices();
+    std::pmr::vector<uint>& getIndices();
     uint getElementsCount() const;
+    std::size_t getSize() const;
+    std::uint64_t getHash() const;
+
+    void reserve(std::size_t verticesCount, std::size_t indicesCount);
+
+    /**
+     * @brief Converts the geometry to vertices and indices in place.
+     * Both outputs must have the space for geometry.points.indices.size() elements.
+     * The large geometry is expanded by the shared JobSystem's workers.
+     * @param geometry - the source geometry
+     * @param processor - the function which is applied to each vertex, it is called
+     * from several threads at once
+     * @param vertices - the output vertices
+     * @param indices - the output indices
+     */
+    static void expand(const Geometry& geometry,
+                       const std::function<void(Vertex&)>& processor,
+                       Vertex* vertices,
+                       uint* indices);
 
     Mesh& operator+=(const Mesh& rhv);
+    bool operator==(const Mesh& rhv) const;
 
 private:
     void calculateNormals();
 
 private:
-    std::vector<Vertex> mVertices;
-    std::vector<uint> mIndices;
+    std::pmr::vector<Vertex> mVertices;
+    std::pmr::vector<uint> mIndices;
 };
 
 }
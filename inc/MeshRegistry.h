@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace custom_scene
+{
+
+/**
+ * The MeshRegistry Class
+ * @brief The class interns meshes by their content. Meshes with equal vertices
+ * and indices are replaced by one canonical instance, so pipes upload them once.
+ * The registry does not own the meshes, a canonical mesh lives while it is used.
+ * The interned meshes are remembered by their pointers, so the mesh which is interned
+ * again is neither hashed nor counted again. The interned mesh must not be changed.
+ */
+class MeshRegistry
+{
+public:
+    /** The counts of the distinct meshes which are interned */
+    struct Report
+    {
+        std::size_t meshesCount;
+        std::size_t uniqueMeshesCount;
+        std::size_t totalBytes;
+        std::size_t uniqueBytes;
+        std::size_t deduplicatedBytes;
+    };
+
+    /**
+     * @brief Finds the mesh with the same content or registers the given one
+     * @param mesh - the mesh to intern
+     * @return The canonical mesh
+     */
+    std::shared_ptr<Mesh> intern(const std::shared_ptr<Mesh>& mesh);
+
+    void clear();
+
+    /** getters */
+    Report getReport() const;
+
+private:
+    /** The interned mesh and its canonical one */
+    struct Known
+    {
+        std::weak_ptr<Mesh> mesh;
+        std::weak_ptr<Mesh> canonical;
+    };
+
+    /** Drops the known meshes which are destroyed, when their count is doubled */
+    void prune();
+
+private:
+    mutable std::mutex mMutex;
+    std::unordered_multimap<std::uint64_t, std::weak_ptr<Mesh>> mMeshes;
+    std::unordered_map<const Mesh*, Known> mKnown;
+    std::size_t mPrunedCount{0};
+    Report mReport{0, 0, 0, 0, 0};
+};
+
+}
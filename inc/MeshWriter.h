@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Pipe.h"
+#include "Mesh.h"
+
+#include <functional>
+
+namespace custom_scene
+{
+
+/**
+ * The MeshWriter Class
+ * @brief The class gives the direct access to the mapped range of the pipe's buffers.
+ * Vertices and indices are written straight to the GPU memory without staging copies.
+ * Indices are local to the range. The range is unmapped by unmap() or by destructor.
+ */
+class MeshWriter
+{
+public:
+    using Callback = std::function<void(const Pipe::Range&)>;
+
+    /**
+     * @brief Constructor for MeshWriter, the pipe must be bound
+     * @param pipe - the pipe which owns the buffers
+     * @param range - the reserved range of the buffers
+     * @param onUnmap - the function which is called when the range is unmapped
+     */
+    MeshWriter(Pipe& pipe, const Pipe::Range& range, Callback onUnmap = {});
+    MeshWriter(MeshWriter&& other) noexcept;
+    ~MeshWriter();
+
+    MeshWriter(const MeshWriter&) = delete;
+    MeshWriter& operator=(const MeshWriter&) = delete;
+    MeshWriter& operator=(MeshWriter&&) = delete;
+
+    /** getters */
+    Vertex* getVertices() const;
+    uint* getIndices() const;
+    const Pipe::Range& getRange() const;
+
+    /** @return True if the range is mapped and has the room for the counts */
+    bool isFitting(std::size_t verticesCount, std::size_t indicesCount) const;
+
+    /**
+     * @brief Copies the mesh to the range
+     * @return False if the mesh does not fit the range, nothing is written then
+     */
+    bool write(const Mesh& mesh);
+
+    /**
+     * @brief Converts the geometry directly to the range, the geometry takes
+     * geometry.points.indices.size() vertices and indices
+     * @return False if the geometry does not fit the range, nothing is written then
+     */
+    bool write(const Geometry& geometry,
+               const std::function<void(Vertex&)>& processor = {});
+
+    /**
+     * @brief Unmaps the range, releases the pipe and calls the callback
+     */
+    void unmap();
+
+private:
+    Pipe* mPipe;
+    Pipe::Range mRange;
+    Vertex* mVertices;
+    uint* mIndices;
+    Callback mOnUnmap;
+};
+
+}
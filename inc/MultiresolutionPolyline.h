@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Common.h"
+
+#include <cstdint>
+#include <memory_resource>
+
+namespace custom_scene
+{
+
+class Camera;
+
+/**
+ * The MultiresolutionPolyline Class
+ * @brief The polyline which is simplified by Douglas-Peucker for any tolerance without
+ * recalculation. The polyline is split into chunks, every interior point of the chunk
+ * keeps the error at which the Douglas-Peucker recursion inserts it. The errors are
+ * clamped by the parents' ones, so the points of any tolerance are a prefix of the
+ * chunk's points sorted by the errors. The tolerance of the chunk is taken from the
+ * distance to the chunk, so the near parts of the polyline keep more points than
+ * the far ones, and the chunks out of the view keep their ends only.
+ */
+class MultiresolutionPolyline
+{
+public:
+    static constexpr uint DefaultChunkSize{4096};
+
+    /**
+     * @brief Builds the errors of the chunks in parallel
+     * @param points - the polyline's points
+     * @param chunkSize - the count of segments in the chunk, at most 65535
+     */
+    MultiresolutionPolyline(std::vector<Point3f> points, uint chunkSize = DefaultChunkSize);
+
+    /**
+     * @brief Selects the points which keep the polyline's deviation on the screen
+     * below the tolerance
+     * @param camera - the camera, its projection gives the size of the pixel
+     * @param pixelTolerance - the maximal deviation in pixels
+     * @param resource - the memory resource the result is allocated from
+     * @return The points in the polyline's order
+     */
+    std::pmr::vector<Point3f> select(const Camera& camera,
+                                     float pixelTolerance,
+                                     std::pmr::memory_resource* resource
+                                     = std::pmr::get_default_resource()) const;
+
+    const std::vector<Point3f>& getPoints() const;
+
+private:
+    struct Chunk
+    {
+        uint first;
+        uint last;
+        Vec3 min;
+        Vec3 max;
+    };
+
+    void buildChunk(Chunk& chunk);
+
+private:
+    std::vector<Point3f> mPoints;
+    std::vector<Chunk> mChunks;
+
+    /**
+     * The interior points of the chunk sorted by the errors are at [first + 1, last),
+     * the offsets are from the chunk's first point
+     */
+    std::vector<float> mErrors;
+    std::vector<std::uint16_t> mOffsets;
+};
+
+}
@@ -1,17 +1,25 @@
 #pragma once
 
 #include <QOpenGLVertexArrayObject>
-#include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLBuffer>
 #include <memory>
+#include <vector>
 
 namespace custom_scene
 {
 
 class Program;
 class Mesh;
+struct Vertex;
 
-class Pipe : public QOpenGLFunctions
+/**
+ * The Pipe Class
+ * @brief The class owns the program, the vertex array and the vertex and index buffers.
+ * Buffers are filled by ranges: every range keeps its own vertices and the indices
+ * which are local to the range, they are drawn with the range's base vertex.
+ */
+class Pipe : public QOpenGLExtraFunctions
 {
 public:
     struct Attribute
@@ -21,6 +29,14 @@ public:
         GLint shift;
     };
 
+    struct Range
+    {
+        uint baseVertex;
+        uint verticesCount;
+        uint startIndex;
+        uint indicesCount;
+    };
+
     Pipe(std::shared_ptr<Program> program,
          const std::vector<Attribute>& attributes);
     virtual ~Pipe() = default;
@@ -30,8 +46,52 @@ public:
     void release();
     void allocate(const Mesh& mesh);
 
+    /**
+     * @brief Reserves the range at the end of the buffers, the pipe must be bound.
+     * The buffers grow if needed, the stored data is copied on the GPU side.
+     * @param verticesCount - the count of vertices in the range
+     * @param indicesCount - the count of indices in the range
+     * @return The reserved range
+     */
+    Range reserve(uint verticesCount, uint indicesCount);
+
+    /**
+     * @brief Maps the range of the buffers for writing. The pipe must be bound.
+     * Only one range could be mapped at the same time.
+     */
+    Vertex* mapVertices(const Range& range);
+    uint* mapIndices(const Range& range);
+    void unmap();
+
+    /**
+     * @brief Copies the range's vertices and indices from the buffer on the GPU side,
+     * the pipe must be bound
+     * @param range - the reserved range
+     * @param buffer - the buffer, e.g. written by another context of the share group
+     * @param verticesOffset - the offset of the vertices in the buffer in bytes
+     * @param indicesOffset - the offset of the indices in the buffer in bytes
+     */
+    void copy(const Range& range, GLuint buffer, GLintptr verticesOffset, GLintptr indicesOffset);
+
+    /**
+     * @brief Moves the ranges to the beginning of the buffers one after another
+     * and drops the rest of data. The ranges are updated.
+     */
+    void compact(const std::vector<Range*>& ranges);
+
+    /**
+     * @brief Forgets all the ranges, the buffers' storage is kept for reuse
+     */
+    void reset();
+
     bool isInitialized() const;
+
+    /** @return True if the pipe is initialized and its program is linked, so it is rendered */
+    bool isReady() const;
     bool isAllocated() const;
+    std::shared_ptr<Program> getProgram() const;
+    uint getVerticesCount() const;
+    uint getIndicesCount() const;
 
 protected:
     std::shared_ptr<Program> mProgram;
@@ -41,12 +101,21 @@ protected:
 private:
     void initializeAttributes();
     void create();
+    void relocate(uint verticesCapacity,
+                  uint indicesCapacity,
+                  const std::vector<Range*>& ranges);
 
 private:
     std::vector<Attribute> mAttributes;
     QOpenGLVertexArrayObject mVAO;
-    QOpenGLBuffer mVBO;
-    QOpenGLBuffer mEBO;
+    QOpenGLBuffer mVBO{QOpenGLBuffer::VertexBuffer};
+    QOpenGLBuffer mEBO{QOpenGLBuffer::IndexBuffer};
+    uint mVerticesCount{0};
+    uint mIndicesCount{0};
+    uint mVerticesCapacity{0};
+    uint mIndicesCapacity{0};
+    bool mIsVerticesMapped{false};
+    bool mIsIndicesMapped{false};
 };
 
 }
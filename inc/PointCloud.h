@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Common.h"
+
+#include <QString>
+#include <cstdint>
+#include <unordered_map>
+
+namespace custom_scene
+{
+
+/** The point as it is stored in the nodes' files and in the GPU buffers */
+struct CloudPoint
+{
+    Point3f position;
+    std::uint32_t color;
+};
+
+/**
+ * The PointCloudIndex Struct
+ * @brief The hierarchy of the disk-backed octree. Every node keeps the subsample of
+ * the points inside its cube: at most one point per cell of the gridSize^3 grid, the
+ * rest of points go to the children. The points of the node are stored in its own
+ * file, the index keeps the root's cube and the count of points of every node.
+ * The node's key keeps its level in the high 6 bits and the path of children's
+ * numbers from the root in 3 bits per level.
+ */
+struct PointCloudIndex
+{
+    static constexpr uint MaxDepth{19};
+
+    struct Node
+    {
+        std::uint64_t key;
+        std::uint64_t pointsCount;
+    };
+
+    Vec3 min;
+    float size;
+    uint gridSize;
+    std::vector<Node> nodes;
+
+    bool read(const QString& directory);
+    bool write(const QString& directory) const;
+
+    /**
+     * @brief Calculates the cube of the node
+     * @param key - the node's key
+     * @param min - the minimal corner of the node's cube
+     * @return The size of the node's cube
+     */
+    float getBounds(std::uint64_t key, Vec3& min) const;
+
+    static std::uint64_t getChildKey(std::uint64_t key, uint child);
+    static uint getLevel(std::uint64_t key);
+    static QString getNodePath(const QString& directory, std::uint64_t key);
+    static std::vector<CloudPoint> readNode(const QString& directory, std::uint64_t key);
+};
+
+/**
+ * The PointCloudWriter Class
+ * @brief Builds the disk-backed octree from the stream of points. Only the octree's
+ * occupancy grids and the small buffers of points are kept in memory, the buffers are
+ * appended to the nodes' files when they are full, so clouds larger than the memory
+ * could be converted in one pass.
+ */
+class PointCloudWriter
+{
+    static constexpr uint DefaultGridSize{32};
+    static constexpr std::size_t NodeBufferSize{4096};
+    static constexpr std::size_t MaxBufferedPoints{4 * 1024 * 1024};
+
+public:
+    /**
+     * @brief Constructor for PointCloudWriter
+     * @param directory - the directory of the octree's files, it must exist
+     * @param min - the minimal corner of the cloud's bounding box
+     * @param max - the maximal corner of the cloud's bounding box
+     * @param maxDepth - the level whose nodes take all points without the subsampling
+     */
+    PointCloudWriter(const QString& directory,
+                     const Vec3& min,
+                     const Vec3& max,
+                     uint maxDepth = 12);
+
+    /**
+     * @brief Adds the points to the octree, the points out of the box are clamped
+     * @return False if some node's file could not be written
+     */
+    bool add(const CloudPoint* points, std::size_t count);
+
+    /**
+     * @brief Writes the rest of the buffered points and the index
+     */
+    bool finish();
+
+private:
+    struct Node
+    {
+        std::vector<std::uint64_t> cells;
+        std::vector<CloudPoint> buffer;
+        std::uint64_t pointsCount{0};
+    };
+
+    bool flush(std::uint64_t key, Node& node);
+    bool flush();
+
+private:
+    QString mDirectory;
+    PointCloudIndex mIndex;
+    uint mMaxDepth;
+    std::unordered_map<std::uint64_t, Node> mNodes;
+    std::size_t mBufferedPoints{0};
+};
+
+}
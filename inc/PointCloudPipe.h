@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ScenePipe.h"
+#include "PointCloud.h"
+#include "AsyncLoader.h"
+#include "ContextGuard.h"
+
+#include <array>
+
+namespace custom_scene
+{
+
+/**
+ * The PointCloudPipe Class
+ * @brief The pipe renders the point cloud written by PointCloudWriter. The nodes of
+ * the octree are selected by their screen-space error, the coarsest nodes first,
+ * until the error is small enough or the budget of points is spent. The nodes are
+ * read from disk by the background thread, the resident nodes keep their own
+ * buffers, the least recently used ones are evicted when there are too many points
+ * on the GPU. So the cloud of any size is browsed with the bounded memory.
+ * The pipe works with the defaults::shaders::PointCloud program.
+ */
+class PointCloudPipe : public ScenePipe
+{
+public:
+    struct Parameters
+    {
+        QString directory;
+        std::size_t pointBudget;
+        std::size_t maxResidentPoints;
+        float maxScreenSpaceError;
+        float pointSize;
+        uint maxUploadsPerFrame;
+    };
+
+    struct Statistics
+    {
+        std::size_t visibleNodesCount;
+        std::size_t visiblePointsCount;
+        std::size_t residentNodesCount;
+        std::size_t residentPointsCount;
+        std::size_t pendingNodesCount;
+    };
+
+    /**
+     * @brief Constructor for PointCloudPipe
+     * @param program - the point cloud program
+     * @param parameters - the directory of the octree, the count of points which are
+     * drawn per frame and kept on the GPU, the screen-space error in pixels which
+     * stops the refinement and the size of points in pixels
+     */
+    PointCloudPipe(std::shared_ptr<Program> program, const Parameters& parameters);
+    ~PointCloudPipe() override;
+
+    void render(std::shared_ptr<Camera> camera,
+                const Lights& lights,
+                const Textures& textures) override;
+
+    Statistics getStatistics() const;
+
+private:
+    struct Node
+    {
+        std::uint64_t key;
+        std::uint64_t pointsCount;
+        Vec3 min;
+        float size;
+        std::array<int, 8> children;
+        GLuint vertexArray;
+        GLuint buffer;
+        GLsizei residentCount;
+        bool isResident;
+        std::size_t lastUsedFrame;
+    };
+
+    void selectNodes(std::shared_ptr<Camera> camera, std::pmr::vector<uint>& nodes);
+    void uploadNodes();
+    void evictNodes();
+    void releaseNode(Node& node);
+
+    /** Takes the buffers of the resident nodes, they are loaded again by the next frames */
+    ContextGuard::Release takeNodes();
+
+private:
+    Parameters mParameters;
+    PointCloudIndex mIndex;
+    std::vector<Node> mNodes;
+    std::unordered_map<std::uint64_t, uint> mNodeIndices;
+    std::size_t mFrame{0};
+    std::size_t mVisibleNodesCount{0};
+    std::size_t mVisiblePointsCount{0};
+    std::size_t mResidentNodesCount{0};
+    std::size_t mResidentPointsCount{0};
+    AsyncLoader<std::uint64_t, std::vector<CloudPoint>> mLoader;
+    ContextGuard mContextGuard;
+};
+
+}
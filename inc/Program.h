@@ -3,6 +3,8 @@
 #include "Common.h"
 
 #include <map>
+#include <vector>
+#include <QElapsedTimer>
 #include <QOpenGLShaderProgram>
 
 namespace custom_scene
@@ -20,17 +22,65 @@ class Program : public QOpenGLShaderProgram
 public:
     Program(const ShaderSources& sources, QObject* parent = nullptr);
 
+    /**
+     * @brief Compiles and links the program, the link is waited for
+     */
     void initialize();
 
+    /**
+     * @brief Creates the program and links it from the cached binary,
+     * the context must be current
+     * @return True if the program is linked from the cache, otherwise it is compiled
+     */
+    bool submit();
+
+    /**
+     * @brief Compiles and links the submitted program in the current context, the statuses
+     * are not asked, so the driver which supports KHR_parallel_shader_compile does not block
+     */
+    void compile();
+
+    /**
+     * @brief Asks the driver whether the link is finished, it does not wait
+     * (KHR_parallel_shader_compile)
+     */
+    bool isLinkCompleted();
+
+    /**
+     * @brief Takes the status of the finished link and stores the program's binary
+     * @return True if the program is linked
+     */
+    bool finish();
+
+    bool isSubmitted() const;
+
+    /** @return True if the program is linked, only the ready program is bound */
+    bool isReady() const;
+
     void setView(const Vec3& position, const Mat4& projection, const Mat4& view);
     void setTransformation(const Mat4& transformation);
     void setLight(Light* light);
+
+    /**
+     * @brief Sets the material's uniforms by its type and binds its maps,
+     * the pipe with the MaterialTable sets the material's index instead
+     */
     void setMaterial(Material* material);
     void setAlfa(float alfa);
 
 private:
+    enum class State
+    {
+        kNone,
+        kSubmitted,
+        kLinked,
+        kFailed
+    };
+
     const ShaderSources& mSources;
-    bool mIsInitialized{false};
+    State mState{State::kNone};
+    std::vector<GLuint> mShaders;
+    QElapsedTimer mTimer;
 };
 
 }
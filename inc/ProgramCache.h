@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Common.h"
+#include "Program.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace custom_scene
+{
+
+/**
+ * The ProgramCache Class
+ * @brief The disk cache of the linked programs' binaries. The binary is keyed by the hash
+ * of the program's sources and the driver's vendor, renderer and version, so the binary
+ * of another driver is never loaded. The loaded binary is validated by its size, its hash
+ * and the link status, the program is compiled from the sources when it is rejected.
+ */
+class ProgramCache
+{
+public:
+    struct Stats
+    {
+        uint hitsCount{0};
+        uint missesCount{0};
+        /** The binaries which are found but rejected by the validation */
+        uint rejectedCount{0};
+        /** The time spent for loading the binaries */
+        std::chrono::microseconds loadTime{0};
+        /** The time spent for compiling and linking the programs which are not cached */
+        std::chrono::microseconds compileTime{0};
+        /** The compilation time of the loaded programs, it is measured when they are stored */
+        std::chrono::microseconds savedTime{0};
+    };
+
+    /** @return The cache which is shared by all programs */
+    static ProgramCache& getInstance();
+
+    /**
+     * @brief Sets the cache's directory, it is the application's cache location by default
+     */
+    void setDirectory(const QString& directory);
+
+    /**
+     * @brief Disables the cache, the programs are always compiled
+     */
+    void setEnabled(bool isEnabled);
+    bool isEnabled() const;
+
+    /**
+     * @brief Links the created program from its cached binary, the context must be current
+     * @param sources - the program's sources, the files' contents are hashed
+     * @return True if the program is linked
+     */
+    bool load(Program& program, const ShaderSources& sources);
+
+    /**
+     * @brief Stores the binary of the linked program
+     * @param compileTime - the time of the program's compilation, it is reported
+     * as saved when the binary is loaded
+     */
+    void store(Program& program,
+               const ShaderSources& sources,
+               std::chrono::microseconds compileTime);
+
+    /**
+     * @brief Counts the compilation of the program which is not loaded
+     */
+    void addCompileTime(std::chrono::microseconds compileTime);
+
+    Stats getStats() const;
+
+private:
+    ProgramCache();
+
+    QString getPath(const ShaderSources& sources) const;
+
+private:
+    mutable std::mutex mMutex;
+    QString mDirectory;
+    bool mIsEnabled{true};
+    Stats mStats;
+};
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Common.h"
+
+#include <QObject>
+#include <QOpenGLContext>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class QOffscreenSurface;
+class QThread;
+
+namespace custom_scene
+{
+
+class Program;
+
+/**
+ * The ProgramCompiler Class
+ * @brief The compiler which links the programs without stalling the frames. The programs
+ * are submitted at once and polled every frame, the pipe is rendered as soon as its program
+ * is linked. The driver which supports KHR_parallel_shader_compile links them in its own
+ * threads, otherwise they are linked by the compiler's thread through the shared context.
+ */
+class ProgramCompiler : public QObject
+{
+    Q_OBJECT
+
+public:
+    ProgramCompiler(QObject* parent = nullptr);
+    ~ProgramCompiler() override;
+
+    /**
+     * @brief Checks the driver's support and starts the compiler's thread if it is needed,
+     * the view's context must be current
+     * @param shareContext - the view's context
+     */
+    void initialize(QOpenGLContext* shareContext);
+
+    /**
+     * @brief Loads the program from the cache or starts its compilation,
+     * the context of the share group must be current. The program which is already
+     * submitted is skipped, the program is linked at once if the compiler is not initialized.
+     */
+    void submit(std::shared_ptr<Program> program);
+
+    /**
+     * @brief Finishes the programs whose links are done, it does not wait.
+     * The context of the share group must be current.
+     * @return The count of the finished programs
+     */
+    std::size_t poll();
+
+    /** @return The count of the programs which are not finished yet */
+    std::size_t getPendingCount() const;
+
+    /** @return True if the driver links the programs in parallel (KHR_parallel_shader_compile) */
+    bool isParallel() const;
+
+signals:
+    /** The program is linked by the compiler's thread */
+    void compiled();
+
+private:
+    struct Pending
+    {
+        std::shared_ptr<Program> program;
+        /** The fence of the compiler's thread, it is put after the link */
+        GLsync fence;
+    };
+
+    void compile();
+
+private:
+    std::unique_ptr<QOpenGLContext> mContext;
+    std::unique_ptr<QOffscreenSurface> mSurface;
+    QThread* mThread{nullptr};
+    bool mIsInitialized{false};
+    bool mIsParallel{false};
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<std::shared_ptr<Program>> mQueue;
+    std::vector<Pending> mPending;
+    bool mIsRunning{true};
+};
+
+}
@@ -2,6 +2,8 @@
 
 #include "Common.h"
 
+#include <memory>
+
 namespace custom_scene
 {
 /**
@@ -23,6 +25,9 @@ class Projection
     /** setters */
     virtual void setRatio(float ratio) = 0;
 
+    /** @return The copy which is not changed with the original */
+    virtual std::shared_ptr<Projection> clone() const = 0;
+
     /** getters */
     float getRatio() const;
     const Mat4& get() const;
@@ -61,6 +66,7 @@ class ProjectionOrtho : public Projection
 
     /** setters */
     void setRatio(float ratio) override;
+    std::shared_ptr<Projection> clone() const override;
     void setXRange(float min, float max);
     void setYRange(float min, float max);
     void setZRange(float min, float max);
@@ -106,6 +112,7 @@ class ProjectionPerspective : public Projection
 
     /** setters */
     void setRatio(float ratio) override;
+    std::shared_ptr<Projection> clone() const override;
     void setAlfa(float alfa);
     void setNear(float nearD);
     void setFar(float farD);
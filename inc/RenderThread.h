@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Common.h"
+#include "Memory.h"
+#include "TripleBuffer.h"
+
+#include <QObject>
+#include <QOpenGLExtraFunctions>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+class QOffscreenSurface;
+class QThread;
+
+namespace custom_scene
+{
+
+class Camera;
+class Scene;
+class ScenePreparer;
+class ProgramCompiler;
+class TextureManager;
+
+/**
+ * The RenderThread Class
+ * @brief The thread which renders the scene into the frames through the context which
+ * shares the view's objects, so the GUI thread only composites the latest finished frame.
+ * The camera is handed over as the snapshot through the triple buffer, the frames are
+ * handed back the same way: neither thread waits for the other. The scene is acquired
+ * as the snapshot at the frame's start, so the scene is changed by any thread meanwhile.
+ */
+class RenderThread : public QObject, protected QOpenGLExtraFunctions
+{
+    Q_OBJECT
+
+    /** The time of the frame which is spent for adding the prepared items */
+    const std::chrono::microseconds PreparationBudget{4000};
+
+public:
+    /**
+     * The Frame Structure
+     * @brief The resolved frame, the fences order the GPU's work between the contexts
+     */
+    struct Frame
+    {
+        GLuint texture{0};
+        GLuint framebuffer{0};
+        /** The frame is rendered, it is waited for by the view */
+        GLsync renderFence{nullptr};
+        /** The frame is composited, it is waited for by the render thread */
+        GLsync compositeFence{nullptr};
+        int width{0};
+        int height{0};
+    };
+
+    /**
+     * @brief Constructor for RenderThread
+     * @param scene - the rendered scene
+     * @param preparer - the preparer whose items are committed by the render thread
+     * @param compiler - the compiler of the pipes' programs, it is polled by the render thread
+     * @param textureManager - the manager of the pipes' maps, it is updated by the render thread
+     * @param background - the color the frames are cleared with
+     * @param samplesCount - the count of samples of the frame's multisampled buffers
+     */
+    RenderThread(std::shared_ptr<Scene> scene,
+                 ScenePreparer* preparer,
+                 ProgramCompiler* compiler,
+                 std::shared_ptr<TextureManager> textureManager,
+                 const Color& background,
+                 int samplesCount,
+                 QObject* parent = nullptr);
+    ~RenderThread() override;
+
+    /**
+     * @brief Creates the thread's context and starts the thread,
+     * it is called by the GUI thread
+     * @param shareContext - the view's context
+     */
+    void start(QOpenGLContext* shareContext);
+
+    /**
+     * @brief Stops the thread and releases its objects
+     */
+    void stop();
+
+    /**
+     * @brief Publishes the camera's snapshot and requests the frame
+     */
+    void setCamera(const Camera& camera);
+
+    /**
+     * @brief Requests the frame, the requests which come during the frame are merged
+     */
+    void requestFrame();
+
+    /**
+     * @brief Takes the latest finished frame, it is called by the GUI thread
+     * @return The frame or nullptr if no frame is rendered yet
+     */
+    Frame* acquireFrame();
+
+signals:
+    /** The frame is finished, it is emitted by the render thread */
+    void frameReady();
+
+private:
+    void run();
+    void renderFrame();
+    void resizeBuffers(int width, int height);
+    void resizeFrame(Frame& frame, int width, int height);
+    void release();
+
+private:
+    std::shared_ptr<Scene> mScene;
+    ScenePreparer* mPreparer;
+    ProgramCompiler* mCompiler;
+    std::shared_ptr<TextureManager> mTextureManager;
+    Color mBackground;
+    int mSamplesCount;
+
+    std::unique_ptr<QOpenGLContext> mContext;
+    std::unique_ptr<QOffscreenSurface> mSurface;
+    QThread* mThread{nullptr};
+
+    TripleBuffer<std::shared_ptr<Camera>> mCameras;
+    TripleBuffer<Frame> mFrames;
+    std::shared_ptr<Camera> mCamera;
+
+    /** The multisampled buffers the frame is rendered to before it is resolved */
+    GLuint mFramebuffer{0};
+    GLuint mColorBuffer{0};
+    GLuint mDepthBuffer{0};
+    int mWidth{0};
+    int mHeight{0};
+
+    std::mutex mRequestMutex;
+    std::condition_variable mRequestCondition;
+    bool mIsRequested{false};
+    bool mIsRunning{false};
+    memory::HeapCheck mHeapCheck;
+};
+
+}
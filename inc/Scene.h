@@ -1,10 +1,13 @@
 #pragma once
 
 #include "Common.h"
+#include "ChangeJournal.h"
 
+#include <functional>
 #include <map>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <QObject>
 
 namespace custom_scene
@@ -13,7 +16,22 @@ namespace custom_scene
 class Item;
 class ScenePipe;
 class Light;
+class MeshRegistry;
+class SceneGraph;
 
+/**
+ * The Scene Class
+ * @brief The pipes, lights and textures of the scene. Every change is recorded to
+ * the journal, the changes made between begin() and commit() are notified once.
+ *
+ * The scene is changed by any thread: the changes are made to the staging scene under
+ * its lock and the notification publishes them. The renderer acquires the published
+ * changes at the frame's start: the items' changes are applied to the pipes by the
+ * renderer only, the lists are taken as the immutable snapshot which shares the pipes,
+ * lights and textures with the previous one, so the frame is rendered without the lock.
+ * The data of the item which is in a pipe is kept by the pipe's store, so the other
+ * threads change it by changeItem() only, the change is applied with the items' changes.
+ */
 class Scene  : public QObject
 {
     Q_OBJECT
@@ -23,6 +41,35 @@ class Scene  : public QObject
     using Textures = std::list<std::shared_ptr<Texture>>;
 
 public:
+    /** The change of the item's data, it is called by the renderer */
+    using ItemChange = std::function<void(Item&)>;
+
+    /**
+     * The Snapshot Structure
+     * @brief The published lists of the scene, it is not changed after it is published
+     */
+    struct Snapshot
+    {
+        Pipes pipes;
+        Lights lights;
+        Textures textures;
+        /** The count of the snapshots before this one, the acquired items' changes make the new one */
+        std::uint64_t version{0};
+    };
+
+    struct Stats
+    {
+        std::uint64_t snapshotsCount{0};
+        std::uint64_t publishesCount{0};
+        std::uint64_t acquiresCount{0};
+        /** The items' changes which are applied to the pipes */
+        std::uint64_t operationsCount{0};
+        /** The items' changes which are published but not acquired yet */
+        std::size_t pendingOperationsCount{0};
+        /** The times the staging scene is locked by another thread */
+        std::uint64_t contentionsCount{0};
+    };
+
     Scene(const Pipes& pipes, QObject* parent = nullptr);
 
     void addPipe(std::shared_ptr<ScenePipe> pipe, bool isNotify = true);
@@ -40,20 +87,114 @@ public:
     void removeTexture(std::shared_ptr<Texture> texture, bool isNotify = true);
     void removeTextures(bool isNotify = true);
 
+    /** The items are added to the pipe through the scene, so the change is recorded */
+    void addItem(std::shared_ptr<ScenePipe> pipe,
+                 std::shared_ptr<Item> item,
+                 bool isNotify = true);
+    void addItems(std::shared_ptr<ScenePipe> pipe,
+                  const std::vector<std::shared_ptr<Item>>& items,
+                  bool isNotify = true);
+    void removeItem(std::shared_ptr<ScenePipe> pipe,
+                    std::shared_ptr<Item> item,
+                    bool isNotify = true);
+
+    /** @brief Records the item's change, the item's mesh is uploaded again */
+    void updateItem(std::shared_ptr<ScenePipe> pipe,
+                    std::shared_ptr<Item> item,
+                    bool isNotify = true);
+
+    /**
+     * @brief Records the change of the item's transformation, visibility or layers,
+     * the change is applied to the item by acquire(). The item's mesh is changed
+     * by updateItem() after the change.
+     */
+    void changeItem(std::shared_ptr<ScenePipe> pipe,
+                    std::shared_ptr<Item> item,
+                    ItemChange change,
+                    bool isNotify = true);
+
     void clear(bool isNotify = true);
+
+    /**
+     * @brief Notifies the recorded changes, even if there are none
+     */
     void update();
 
+    /**
+     * @brief Starts the transaction, the changes are notified by the outermost commit().
+     * The transactions of all threads are counted together.
+     */
+    void begin();
+    void commit();
+
+    /**
+     * @brief Applies the published items' changes to the pipes and takes the latest
+     * snapshot, it is called by the renderer at the frame's start
+     */
+    std::shared_ptr<const Snapshot> acquire();
+
+    /** @return The latest acquired snapshot, it is read by any thread */
+    std::shared_ptr<const Snapshot> getSnapshot() const;
+
+    Stats getStats() const;
+
+    /** The staging lists, they are read by the thread which changes the scene */
     const Pipes& getPipes() const;
     const Lights& getLights() const;
     const Textures& getTextures() const;
+    std::shared_ptr<MeshRegistry> getMeshRegistry() const;
+
+    /**
+     * The hierarchy of the items' transformations, the view updates it before rendering.
+     * The graph is locked by its own calls, so it is changed by any thread.
+     */
+    std::shared_ptr<SceneGraph> getSceneGraph() const;
 
 signals:
-    void changed();
+    void changed(const custom_scene::Changes& changes);
 
 private:
+    enum class Operation
+    {
+        kAdd,
+        kRemove,
+        kUpdate,
+        kChange,
+        /** The pipe gets the scene's mesh registry, its items are interned again */
+        kAttach
+    };
+
+    struct ItemOperation
+    {
+        Operation operation;
+        std::shared_ptr<ScenePipe> pipe;
+        std::shared_ptr<Item> item;
+        ItemChange change;
+    };
+
+    using Lock = std::unique_lock<std::mutex>;
+
+    Lock lockStaging();
+    void notify(Lock& lock, bool isNotify);
+    void publish(Lock& lock);
+
+private:
+    mutable std::mutex mMutex;
     Pipes mPipes;
     Lights mLights;
     Textures mTextures;
+    std::shared_ptr<MeshRegistry> mMeshRegistry;
+    std::shared_ptr<SceneGraph> mSceneGraph;
+    ChangeJournal mJournal;
+    uint mTransactionsCount{0};
+
+    /** The items' changes which are recorded since the last notification */
+    std::vector<ItemOperation> mOperations;
+    /** The items' changes which are published for the renderer */
+    std::vector<ItemOperation> mPublishedOperations;
+    std::shared_ptr<const Snapshot> mPendingSnapshot;
+    std::shared_ptr<const Snapshot> mSnapshot;
+    Stats mStats;
 };
 
 }
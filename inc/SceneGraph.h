@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Common.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace custom_scene
+{
+
+class Item;
+
+/**
+ * The SceneGraph Class
+ * @brief The hierarchy of the transformations. Every node has the local matrix and
+ * the cached world one, the node's item gets the world matrix as its transformation.
+ * The nodes are kept in the arrays ordered by depth, so update() goes through the
+ * levels one by one and computes every level in parallel. Only the nodes whose local
+ * matrix or any ancestor's one is changed are computed, the levels above the first
+ * changed node are skipped. The structure's changes reorder the arrays on update().
+ * Every call locks the graph, so the graph is changed by any thread while the renderer
+ * updates it.
+ */
+class SceneGraph
+{
+public:
+    using Handle = uint;
+
+    static constexpr Handle InvalidHandle{std::numeric_limits<Handle>::max()};
+
+    /**
+     * @brief Adds the node
+     * @param local - the transformation relative to the parent
+     * @param parent - the parent, the node is a root without it
+     * @param item - the item which gets the node's world matrix, may be null
+     * @return The node's handle
+     */
+    Handle addNode(const Mat4& local,
+                   Handle parent = InvalidHandle,
+                   std::shared_ptr<Item> item = nullptr);
+
+    /**
+     * @brief Adds the node of the item, the item's transformation becomes the local one.
+     * The item is read by the caller, so the item which is in a pipe is added by the renderer.
+     */
+    Handle addItem(std::shared_ptr<Item> item, Handle parent = InvalidHandle);
+
+    /**
+     * @brief Removes the node with all its descendants
+     */
+    void removeNode(Handle handle);
+
+    /**
+     * @brief Moves the node with its descendants to the new parent, the local matrix
+     * is kept. The node is not moved under its own descendant.
+     */
+    void setParent(Handle handle, Handle parent);
+
+    void setLocalTransformation(Handle handle, const Mat4& local);
+
+    /**
+     * @brief Computes the world matrices of the changed nodes and sets them to the items
+     */
+    void update();
+
+    void clear();
+
+    bool isValid(Handle handle) const;
+    Handle getParent(Handle handle) const;
+    Mat4 getLocalTransformation(Handle handle) const;
+
+    /** @return The world matrix computed by the last update */
+    Mat4 getWorldTransformation(Handle handle) const;
+
+    std::size_t getNodesCount() const;
+    std::size_t getLevelsCount() const;
+
+    /** @return The count of the nodes computed by the last update */
+    std::size_t getUpdatedCount() const;
+
+private:
+    static constexpr uint InvalidIndex{std::numeric_limits<uint>::max()};
+
+    /** The calls which are made under the lock */
+    bool contains(Handle handle) const;
+    void unlink(Handle handle);
+    void reorder();
+    std::size_t updateNodes(std::size_t first, std::size_t last);
+
+private:
+    mutable std::mutex mMutex;
+
+    /** The structure, by handles */
+    std::vector<uint> mIndices;
+    std::vector<Handle> mParentHandles;
+    std::vector<Handle> mFirstChildren;
+    std::vector<Handle> mNextSiblings;
+    std::vector<Handle> mFreeHandles;
+
+    /** The nodes, by indices ordered by depth */
+    std::vector<Handle> mHandles;
+    std::vector<uint> mParents;
+    std::vector<Mat4> mLocals;
+    std::vector<Mat4> mWorlds;
+    std::vector<std::uint32_t> mStamps;
+    std::vector<std::shared_ptr<Item>> mItems;
+    std::vector<uint> mLevels;
+
+    /** The node is changed when its stamp is equal to the stamp of the next update */
+    std::uint32_t mStamp{1};
+    uint mFirstChanged{InvalidIndex};
+    std::size_t mNodesCount{0};
+    std::size_t mUpdatedCount{0};
+    bool mIsReordered{false};
+};
+
+}
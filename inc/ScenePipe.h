@@ -2,6 +2,14 @@
 
 #include "Pipe.h"
 #include "Common.h"
+#include "MeshWriter.h"
+#include "TransformBuffer.h"
+#include "MaterialTable.h"
+#include "ItemStore.h"
+
+#include <list>
+#include <memory_resource>
+#include <unordered_map>
 
 namespace custom_scene
 {
@@ -9,14 +17,16 @@ namespace custom_scene
 class Item;
 class Camera;
 class Light;
+class MeshRegistry;
+class TextureManager;
 
 class ScenePipe : public Pipe
 {
-    using Items = std::list<std::shared_ptr<Item>>;
+public:
+    using Items = ItemStore::Items;
     using Lights = std::list<std::shared_ptr<Light>>;
     using Textures = std::list<std::shared_ptr<Texture>>;
 
-public:
     ScenePipe(std::shared_ptr<Program> program,
               const std::vector<Attribute>& attributes,
               const Items &items = {});
@@ -24,17 +34,105 @@ public:
     void addItem(std::shared_ptr<Item> item);
     void addItems(const Items& items);
     void removeItem(std::shared_ptr<Item> item);
+
+    /**
+     * @brief Adds the item whose mesh is written to the staging buffer: the vertices
+     * and then the indices. The data is copied on the GPU side, the mesh which is
+     * already in the pipe is not copied. The item is drawn from the next frame.
+     */
+    void addStagedItem(std::shared_ptr<Item> item, GLuint buffer);
+
+    /**
+     * @brief Uploads the item's mesh after it is replaced
+     */
+    void updateItem(std::shared_ptr<Item> item);
     void clear();
+
+    /**
+     * @brief Uploads the meshes which are not in the pipe's buffers yet.
+     * The ranges of the removed items are reused after compaction.
+     */
     void realocate();
 
+    /**
+     * @brief Adds the item whose vertices and indices are written directly
+     * to the pipe's buffers. The item gets its range when the writer is unmapped.
+     * The item has no mesh, its data lives in the GPU memory only.
+     * @param item - the item to add
+     * @param verticesCount - the count of vertices to reserve
+     * @param indicesCount - the count of indices to reserve
+     * @return The writer to the mapped range
+     */
+    MeshWriter map(std::shared_ptr<Item> item,
+                   uint verticesCount,
+                   uint indicesCount);
+
+    /**
+     * @brief Sets the registry the items' meshes are interned with.
+     * Items with equal meshes share one range of the pipe's buffers.
+     */
+    void setMeshRegistry(std::shared_ptr<MeshRegistry> registry);
+
+    /**
+     * @brief Moves the items' transformations from the matrix uniforms to the pipe's
+     * transform buffer, only the changed transformations are written every frame.
+     * The program must read them with defaults::shaders::TransformFetch.
+     */
+    void setTransformBuffered(bool isTransformBuffered);
+    bool isTransformBuffered() const;
+
+    /**
+     * @brief Moves the items' materials from the material uniforms to the pipe's material
+     * table, the change of the material between the draws sets the material's index only.
+     * The program must read them with defaults::shaders::MaterialIndex and MaterialFetch.
+     */
+    void setMaterialBuffered(bool isMaterialBuffered);
+    bool isMaterialBuffered() const;
+
+    /**
+     * @brief Sets the manager the materials' maps are packed with, the material table
+     * writes the maps' locations, so the textured items are drawn without the texture binds
+     */
+    void setTextureManager(std::shared_ptr<TextureManager> manager);
+    std::shared_ptr<TextureManager> getTextureManager() const;
+
     virtual void render(std::shared_ptr<Camera> camera,
                         const Lights& lights,
                         const Textures& textures);
 
     const Items& getItems() const;
+    const ItemStore& getItemStore() const;
+    std::shared_ptr<MeshRegistry> getMeshRegistry() const;
+    std::size_t getAllocatedSize() const;
+
+private:
+    /** The item's draw, the packets are sorted by the items' states */
+    struct DrawPacket
+    {
+        std::uint64_t stateKey;
+        uint index;
+    };
+
+    /**
+     * @brief Culls the items of the camera's layers and builds the sorted packets,
+     * the chunks of the large pipes are built by the shared workers
+     */
+    std::pmr::vector<DrawPacket> buildPackets(const Camera& camera,
+                                              std::pmr::memory_resource* resource) const;
+
+    void internMesh(Item& item);
+    void releaseUnusedRanges(std::pmr::memory_resource* resource);
+    void compactRanges();
 
 private:
-    Items mItems;
+    ItemStore mItems;
+    std::shared_ptr<MeshRegistry> mMeshRegistry;
+    std::unordered_map<std::shared_ptr<Mesh>, Range> mMeshRanges;
+    std::unordered_map<std::shared_ptr<Item>, Range> mItemRanges;
+    std::size_t mWastedSize{0};
+    std::unique_ptr<TransformBuffer> mTransformBuffer;
+    std::unique_ptr<MaterialTable> mMaterialTable;
+    std::shared_ptr<TextureManager> mTextureManager;
 };
 
 } // custom_scene
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Common.h"
+
+#include <QObject>
+#include <QOpenGLExtraFunctions>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+class QOffscreenSurface;
+class QThread;
+
+namespace custom_scene
+{
+
+class Item;
+class Mesh;
+class MeshRegistry;
+class ScenePipe;
+
+/**
+ * The ScenePreparer Class
+ * @brief The pipeline which prepares the items out of the GUI thread. The meshes are
+ * built and interned by the jobs of the shared JobSystem, the loader thread writes them to the
+ * staging buffers through the context which shares the view's objects and puts the
+ * fence after every upload. The view commits the items whose fences are signaled
+ * while the frame's budget lasts: the staging buffer is copied to the pipe's buffers
+ * on the GPU side, so the GUI thread neither builds nor uploads the meshes.
+ * The items appear one by one, the frames are rendered meanwhile.
+ */
+class ScenePreparer : public QObject, protected QOpenGLExtraFunctions
+{
+    Q_OBJECT
+
+public:
+    using Builder = std::function<std::shared_ptr<Mesh>()>;
+
+    /**
+     * @brief Constructor for ScenePreparer
+     * @param registry - the registry the built meshes are interned with
+     */
+    ScenePreparer(std::shared_ptr<MeshRegistry> registry, QObject* parent = nullptr);
+    ~ScenePreparer() override;
+
+    /**
+     * @brief Creates the loader's context and starts the loader,
+     * the view's context must be current
+     * @param shareContext - the view's context
+     */
+    void initialize(QOpenGLContext* shareContext);
+
+    /**
+     * @brief Queues the item, it is added to the pipe when its mesh is uploaded.
+     * The item must not be changed until then.
+     * @param pipe - the pipe the item is added to
+     * @param item - the item, it gets the built mesh
+     * @param builder - the function which builds the mesh on the worker,
+     * it may return the item's own mesh
+     */
+    void prepare(std::shared_ptr<ScenePipe> pipe, std::shared_ptr<Item> item, Builder builder);
+
+    /**
+     * @brief Adds the uploaded items to their pipes, the view's context must be current
+     * @param budget - the time after which the rest of items waits for the next frame
+     * @return The count of the added items
+     */
+    std::size_t commit(std::chrono::microseconds budget);
+
+    /** @return The count of the items which are queued but not committed yet */
+    std::size_t getPendingCount() const;
+
+    /** @return True if some uploaded items are not committed yet */
+    bool hasUploaded() const;
+
+signals:
+    /** The upload is finished, it is emitted by the loader thread */
+    void uploaded();
+
+private:
+    struct Task
+    {
+        std::shared_ptr<ScenePipe> pipe;
+        std::shared_ptr<Item> item;
+        Builder builder;
+    };
+
+    struct Upload
+    {
+        std::shared_ptr<ScenePipe> pipe;
+        std::shared_ptr<Item> item;
+        GLuint buffer;
+        GLsync fence;
+    };
+
+    void build(Task task);
+    void load();
+
+private:
+    std::shared_ptr<MeshRegistry> mRegistry;
+    std::unique_ptr<QOpenGLContext> mContext;
+    std::unique_ptr<QOffscreenSurface> mSurface;
+    QThread* mLoader{nullptr};
+
+    mutable std::mutex mMutex;
+    std::condition_variable mBuiltCondition;
+    std::condition_variable mIdleCondition;
+    /** The count of the build jobs which are not finished */
+    std::size_t mBuildsCount{0};
+    std::deque<Task> mBuilt;
+    std::deque<Upload> mUploads;
+    std::atomic<std::size_t> mPendingCount{0};
+    bool mIsRunning{true};
+};
+
+}
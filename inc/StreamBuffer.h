@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ContextGuard.h"
+
+#include <QOpenGLExtraFunctions>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace custom_scene
+{
+
+/**
+ * The StreamBuffer Class
+ * @brief The GPU buffer which is written by the CPU in place. When the context supports
+ * GL_ARB_buffer_storage the buffer is persistently and coherently mapped, so the writes
+ * go straight to the GPU memory and nothing is uploaded. Otherwise the writes go to the
+ * CPU copy and flush() uploads only the blocks which are written since the last flush.
+ * All calls except write() and getData() need the current context. The buffer is released
+ * in the context which creates it, the buffer of the destroyed context is empty.
+ */
+class StreamBuffer : protected QOpenGLExtraFunctions
+{
+public:
+    StreamBuffer() = default;
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    /**
+     * @brief Creates the buffer or changes its size, the data which fits is kept
+     * @param size - the size in bytes
+     */
+    void resize(std::size_t size);
+
+    /**
+     * @brief Copies the data to the buffer and marks the range as dirty. The mapped buffer
+     * is written in place, so the range must not be read by the GPU's pending draws,
+     * the owner fences the regions it writes (see TransformBuffer and TrackPipe).
+     */
+    void write(std::size_t offset, const void* data, std::size_t size);
+
+    /**
+     * @brief Marks the range which is written through getData() as dirty
+     */
+    void markDirty(std::size_t offset, std::size_t size);
+
+    /**
+     * @brief Uploads the dirty blocks, does nothing for the mapped buffer
+     */
+    void flush();
+
+    std::byte* getData() const;
+    GLuint getId() const;
+    std::size_t getSize() const;
+    bool isPersistent() const;
+
+private:
+    ContextGuard::Release take();
+
+private:
+    GLuint mBuffer{0};
+    std::size_t mSize{0};
+    std::byte* mData{nullptr};
+    std::vector<std::byte> mCopy;
+    std::vector<std::uint64_t> mDirtyBlocks;
+    bool mIsInitialized{false};
+    bool mIsPersistent{false};
+    ContextGuard mContextGuard;
+};
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "ScenePipe.h"
+#include "Figures.h"
+#include "AsyncLoader.h"
+
+#include <functional>
+
+namespace custom_scene
+{
+
+struct Material;
+
+/**
+ * The TerrainPipe Class
+ * @brief The pipe renders a large heightmap by chunks of the quadtree. All chunks
+ * share one grid patch which is displaced by the height tile in the vertex shader.
+ * The chunk's level is selected by the distance to the camera, the vertices are
+ * morphed to the coarser level near the border of the level's range, so there
+ * are no cracks and no popping. Tiles of the heightmap pyramid are read from disk
+ * by the background thread and uploaded to the textures by the rendering thread.
+ * The pipe works with the defaults::shaders::Terrain program.
+ */
+class TerrainPipe : public ScenePipe
+{
+public:
+    /**
+     * @brief Reads the tile of the level, returns (tileSize + 1)^2 heights
+     * or an empty vector if there is no such tile. The heights may be followed by
+     * the minimal and maximal heights of the tile's area, otherwise they are found
+     * among the heights. Called on the loader thread.
+     */
+    using TileLoader = std::function<std::vector<float>(uint level, uint x, uint y)>;
+
+    struct Parameters
+    {
+        Vec2 origin;
+        float size;
+        uint levels;
+        uint patchResolution;
+        uint tileSize;
+        float heightScale;
+        float lodDistance;
+        uint maxResidentTiles;
+        uint maxUploadsPerFrame;
+        TileLoader loader;
+    };
+
+    struct Statistics
+    {
+        std::size_t chunksCount;
+        std::size_t residentTilesCount;
+        std::size_t pendingTilesCount;
+    };
+
+    TerrainPipe(std::shared_ptr<Program> program,
+                const Parameters& parameters,
+                std::shared_ptr<Material> material);
+
+    void render(std::shared_ptr<Camera> camera,
+                const Lights& lights,
+                const Textures& textures) override;
+
+    Statistics getStatistics() const;
+
+    /**
+     * @brief Creates the loader of the tiles written by writeTiles
+     * @param directory - the root directory of the tiles' pyramid
+     * @param tileSize - the count of cells in the tile's side
+     */
+    static TileLoader createFileLoader(const QString& directory, uint tileSize);
+
+    /**
+     * @brief Writes the pyramid of tiles as <directory>/<level>/<x>_<y>.raw files.
+     * The level 0 is one tile for the whole heightfield, every next level has
+     * twice more tiles by each side. Tiles are raw float32 heights, neighbour
+     * tiles share the border samples. The heights are followed by the minimal and
+     * maximal source heights of the tile's area, so the coarse tile's box covers
+     * the peaks between its samples.
+     * @param heightfield - the source heights, the cell size is not used,
+     * the heights are written multiplied by the height scale
+     * @param directory - the root directory of the tiles' pyramid
+     * @param tileSize - the count of cells in the tile's side
+     * @param levels - the count of levels in the pyramid
+     * @return False if some file could not be written
+     */
+    static bool writeTiles(const figures::Heightfield& heightfield,
+                           const QString& directory,
+                           uint tileSize,
+                           uint levels);
+
+private:
+    struct Tile
+    {
+        std::shared_ptr<Texture> texture;
+        float minHeight;
+        float maxHeight;
+        std::size_t lastUsedFrame;
+    };
+
+    struct Chunk
+    {
+        Tile* tile;
+        Vec2 origin;
+        float size;
+        float morphEnd;
+    };
+
+    void selectChunks(uint level,
+                      uint x,
+                      uint y,
+                      const Vec3& position,
+                      const Mat4& transformation,
+                      std::pmr::vector<Chunk>& chunks);
+    Tile* getTile(uint level, uint x, uint y);
+    void uploadTiles();
+    void evictTiles();
+    std::vector<float> loadTile(std::uint64_t key) const;
+
+private:
+    Parameters mParameters;
+    std::shared_ptr<Item> mPatch;
+    std::unordered_map<std::uint64_t, Tile> mTiles;
+    std::size_t mFrame{0};
+    std::size_t mChunksCount{0};
+    AsyncLoader<std::uint64_t, std::vector<float>> mLoader;
+};
+
+}
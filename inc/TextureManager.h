@@ -0,0 +1,160 @@
+#pragma once
+
+#include "Common.h"
+#include "ContextGuard.h"
+
+#include <QOpenGLExtraFunctions>
+#include <QVector4D>
+#include <list>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace custom_scene
+{
+
+class Program;
+
+/**
+ * The TextureManager Class
+ * @brief The pages of the materials' maps. The textures of one format are copied to one
+ * GL_TEXTURE_2D_ARRAY whose layers are the square pages, the texture takes the page's
+ * aligned power of two cell, so the pages are split like the buddy allocator's blocks.
+ * The texture is surrounded by the gutter of its replicated edges and the cell is aligned
+ * to its size. The sampling is clamped to the levels whose gutter is at least half
+ * of the texel wide, so the filtered texels never mix the neighbours.
+ * The shader reads the texture by the array, layer and rectangle of its location which
+ * the MaterialTable writes to the material's entry, so the textured items are drawn
+ * without the texture binds. The copies are made on the GPU by the framebuffer blits,
+ * the texture's content is copied once when it is packed.
+ * The texture which is larger than the page or whose format is not renderable is not
+ * packed, its material binds it as before.
+ */
+class TextureManager : protected QOpenGLExtraFunctions
+{
+public:
+    using Textures = std::list<std::shared_ptr<Texture>>;
+
+    /** The maximal count of the arrays, that is of the packed formats */
+    static constexpr int MaxArraysCount{4};
+
+    /** The texture unit of the first array */
+    static constexpr GLint FirstUnit{12};
+
+    static constexpr int DefaultPageSize{2048};
+
+    /** The texels of the replicated edges around the texture */
+    static constexpr int GutterSize{8};
+
+    /**
+     * The Location Structure
+     * @brief The place of the packed texture
+     */
+    struct Location
+    {
+        /** The array's number, -1 if the texture is not packed */
+        int array{-1};
+        int layer{0};
+        /** The texture's offset and scale in the page's coordinates */
+        QVector4D rect;
+        /** The last level whose gutter covers the filter, the sampling is clamped to it */
+        float maxLod{0.0f};
+
+        bool isValid() const;
+    };
+
+    struct Stats
+    {
+        std::size_t arraysCount{0};
+        std::size_t layersCount{0};
+        std::size_t packedCount{0};
+        /** The textures which are too large or have the formats which are not packed */
+        std::size_t rejectedCount{0};
+        /** The area of the pages which is taken by the cells */
+        std::size_t usedTexels{0};
+    };
+
+    /**
+     * @param pageSize - the size of the arrays' layers, the power of two
+     */
+    explicit TextureManager(int pageSize = DefaultPageSize);
+    ~TextureManager();
+
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    /**
+     * @brief Packs the texture if it is not packed yet, the context must be current
+     * @return The texture's location, it is not valid if the texture is not packed
+     */
+    Location add(const std::shared_ptr<Texture>& texture);
+
+    /**
+     * @brief Packs the scene's textures, frees the cells of the released textures
+     * and generates the mip levels of the changed arrays, it is called before the frame's draws
+     */
+    void update(const Textures& textures);
+
+    /**
+     * @brief Binds the arrays to their units and sets them to the program
+     */
+    void bind(Program& program);
+
+    Location getLocation(const Texture* texture) const;
+
+    Stats getStats() const;
+
+private:
+    /** The page's square cell */
+    struct Cell
+    {
+        int layer;
+        int x;
+        int y;
+
+        bool operator<(const Cell& other) const;
+    };
+
+    /**
+     * The Array Structure
+     * @brief The pages of one format, the free cells are kept by their levels,
+     * the level 0 is the whole page
+     */
+    struct Array
+    {
+        GLenum format{0};
+        GLuint texture{0};
+        int layersCount{0};
+        std::vector<std::set<Cell>> freeCells;
+        bool isChanged{false};
+    };
+
+    struct Entry
+    {
+        std::weak_ptr<Texture> texture;
+        Location location;
+        int level{0};
+        Cell cell{0, 0, 0};
+    };
+
+    int getArray(GLenum format);
+    bool allocate(Array& array, int level, Cell& cell);
+    void release(Array& array, int level, Cell cell);
+    void grow(Array& array);
+    void copy(const Texture& texture, const Array& array, const Cell& cell, int cellSize);
+    void generateMipmaps();
+
+    /** Takes the arrays, the textures are packed again by the next update */
+    ContextGuard::Release take();
+
+private:
+    int mPageSize;
+    int mLevelsCount;
+    std::vector<Array> mArrays;
+    std::unordered_map<const Texture*, Entry> mEntries;
+    bool mIsInitialized{false};
+    ContextGuard mContextGuard;
+};
+
+}
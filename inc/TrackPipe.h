@@ -0,0 +1,136 @@
+#pragma once
+
+#include "LinePipe.h"
+#include "StreamBuffer.h"
+
+#include <array>
+
+namespace custom_scene
+{
+
+/**
+ * The TrackPipe Class
+ * @brief The pipe renders append-only polylines, e.g. the live tracks of vehicles.
+ * Every track owns the ring of points in one stream buffer, an append writes only
+ * the new point and the track's header, nothing is re-uploaded. When the ring is full
+ * the oldest point is dropped or, with the decimation, every second point of the
+ * older half of the history is dropped, so the track keeps its whole time span with
+ * the lower density of the old points. The tracks are drawn like the polylines of
+ * the LinePipe: all visible tracks are drawn by one multi draw call.
+ * The appends and decimations go to the CPU copy, the buffers are split into three
+ * regions like the TransformBuffer's ones: the frame writes the changed points and
+ * headers to the next region after the GPU has finished the frame which read it,
+ * so the persistently mapped buffers are never written under the GPU's draws.
+ * The pipe works with the defaults::shaders::Track program.
+ */
+class TrackPipe : public ScenePipe
+{
+public:
+    struct Parameters
+    {
+        uint pointsCapacity;
+        bool isDecimated;
+        float miterLimit;
+    };
+
+    struct Track
+    {
+        float width;
+        Color color;
+        LinePipe::Join join;
+        LinePipe::Cap cap;
+    };
+
+    using Handle = uint;
+
+    /**
+     * @brief Constructor for TrackPipe
+     * @param program - the track program
+     * @param parameters - the count of points kept by each track, at least 4,
+     * the mode of dropping the old points and the miter limit of the joins
+     */
+    TrackPipe(std::shared_ptr<Program> program, const Parameters& parameters);
+    ~TrackPipe() override;
+
+    Handle addTrack(const Track& track);
+    void removeTrack(Handle handle);
+    void setTrack(Handle handle, const Track& track);
+    void setTrackVisible(Handle handle, bool isVisible);
+
+    void append(Handle handle, const Vec3& point);
+    void append(Handle handle, const Vec3* points, std::size_t count);
+
+    void render(std::shared_ptr<Camera> camera,
+                const Lights& lights,
+                const Textures& textures) override;
+
+    std::size_t getTracksCount() const;
+    std::size_t getPointsCount(Handle handle) const;
+
+private:
+    static constexpr uint RegionsCount{3};
+
+    /** The track's header in the tracks' buffer */
+    struct Header
+    {
+        std::uint32_t tail;
+        std::uint32_t count;
+        std::uint32_t padding[2];
+        float width;
+        std::uint32_t style;
+        std::uint32_t color;
+        std::uint32_t reserved;
+    };
+
+    struct TrackState
+    {
+        uint slot;
+        Header header;
+        bool isVisible;
+    };
+
+    using MultiDrawArrays = void (QOPENGLF_APIENTRYP)(GLenum mode,
+                                                      const GLint* first,
+                                                      const GLsizei* count,
+                                                      GLsizei drawCount);
+
+    using DirtyBits = std::array<std::vector<std::uint64_t>, RegionsCount>;
+
+    void writePoint(uint slot, uint index, const Point3f& point);
+    void writeHeader(const TrackState& track);
+    void decimate(TrackState& track);
+    void reserveSlots(uint slotsCount);
+    void upload();
+
+    /** Writes the points and headers which are changed since the region was written last */
+    void writeRegion(uint region);
+    void wait(uint region);
+
+    /** Takes the textures, the buffers are written again by the next frame */
+    ContextGuard::Release takeTextures();
+
+private:
+    Parameters mParameters;
+    std::unordered_map<Handle, TrackState> mTracks;
+    std::vector<uint> mFreeSlots;
+    std::vector<Point3f> mPoints;
+    std::vector<Header> mHeaders;
+    DirtyBits mDirtyPoints;
+    DirtyBits mDirtyHeaders;
+    uint mSlotsCount{0};
+    uint mSlotsCapacity{0};
+    /** The slots of one region in the buffers */
+    uint mRegionSlots{0};
+    uint mRegion{0};
+    std::array<GLsync, RegionsCount> mFences{};
+    Handle mNextHandle{0};
+    StreamBuffer mPointsBuffer;
+    StreamBuffer mHeadersBuffer;
+    GLuint mPointsTexture{0};
+    GLuint mHeadersTexture{0};
+    MultiDrawArrays mMultiDrawArrays{nullptr};
+    bool mIsResized{true};
+    ContextGuard mContextGuard;
+};
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "StreamBuffer.h"
+
+#include <array>
+
+namespace custom_scene
+{
+
+class ItemStore;
+class Program;
+
+/**
+ * The TransformBuffer Class
+ * @brief The buffer texture of the model and normal matrices of the pipe's items,
+ * the item's shader reads them by the item's index instead of the matrix uniforms.
+ * The buffer is split into three regions which are written in turn, the region is
+ * written only when the GPU has finished the frame which read it the last time,
+ * so the persistently mapped buffer is written without the stalls. Every region
+ * remembers the transformation versions of its items, only the changed items are
+ * written, and the normal matrix is computed once per change.
+ * The shaders read the buffer with defaults::shaders::TransformFetch.
+ */
+class TransformBuffer : protected QOpenGLExtraFunctions
+{
+public:
+    static constexpr uint RegionsCount{3};
+
+    /** The texture unit the buffer is bound to */
+    static constexpr GLint TextureUnit{7};
+
+    /** The location of the item's index, the attribute has no array, its current value is set */
+    static constexpr GLuint IndexLocation{4};
+
+    TransformBuffer() = default;
+    ~TransformBuffer();
+
+    TransformBuffer(const TransformBuffer&) = delete;
+    TransformBuffer& operator=(const TransformBuffer&) = delete;
+
+    /**
+     * @brief Writes the changed transformations to the next region,
+     * waits when the GPU still reads the region
+     * @param items - the items, their indices in the store are the indices in the buffer
+     */
+    void update(const ItemStore& items);
+
+    /**
+     * @brief Binds the buffer texture and sets the current region to the program
+     */
+    void bind(Program& program);
+
+    /**
+     * @brief Sets the index of the item which is drawn next
+     */
+    void setIndex(uint index);
+
+    /**
+     * @brief Marks the end of the draws which read the current region,
+     * must be called after the last draw of the frame
+     */
+    void fence();
+
+    uint getCapacity() const;
+
+    /** @return The count of the items written by the last update */
+    std::size_t getWrittenCount() const;
+
+private:
+    void reserve(std::size_t itemsCount);
+    void wait(uint region);
+
+    /** Takes the texture and the fences, the regions are written again by the next update */
+    ContextGuard::Release take();
+
+private:
+    StreamBuffer mBuffer;
+    GLuint mTexture{0};
+    uint mCapacity{0};
+    uint mRegion{0};
+    std::size_t mWrittenCount{0};
+    std::array<std::vector<std::uint64_t>, RegionsCount> mVersions;
+    std::array<GLsync, RegionsCount> mFences{};
+    bool mIsInitialized{false};
+    ContextGuard mContextGuard;
+};
+
+}
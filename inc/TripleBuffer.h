@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace custom_scene
+{
+
+/**
+ * The TripleBuffer Class
+ * @brief The lock-free handover of the values from one writer thread to one reader
+ * thread. The writer fills the back value and publishes it, the reader takes the
+ * latest published value as its front one. The sides exchange the values through
+ * the middle one by the atomic exchange, so neither side waits for the other and
+ * the values which are not read in time are overwritten by the newer ones.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /** @return The value which the writer fills */
+    T& getBack()
+    {
+        return mValues[mBack];
+    }
+
+    /**
+     * @brief Publishes the back value, the writer gets the next one to fill
+     */
+    void publish()
+    {
+        auto middle = mMiddle.exchange(static_cast<std::uint8_t>(mBack | DirtyBit),
+                                       std::memory_order_acq_rel);
+        mBack = middle & IndexMask;
+    }
+
+    /**
+     * @brief Takes the latest published value if there is a new one
+     * @return True if the front value is changed
+     */
+    bool update()
+    {
+        if ((mMiddle.load(std::memory_order_acquire) & DirtyBit) == 0)
+        {
+            return false;
+        }
+
+        auto middle = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+        mFront = middle & IndexMask;
+
+        return true;
+    }
+
+    /** @return The value which the reader uses */
+    T& getFront()
+    {
+        return mValues[mFront];
+    }
+
+    /** @return All values, e.g. to release their resources when neither side works */
+    std::array<T, 3>& getValues()
+    {
+        return mValues;
+    }
+
+private:
+    static constexpr std::uint8_t IndexMask{0x3};
+    static constexpr std::uint8_t DirtyBit{0x4};
+
+    std::array<T, 3> mValues{};
+    std::uint8_t mBack{0};
+    std::atomic<std::uint8_t> mMiddle{1};
+    std::uint8_t mFront{2};
+};
+
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "Common.h"
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
 
 namespace custom_scene
 {
@@ -12,6 +17,9 @@ extern Point3f toPoint3(const Vec3& vec);
 
 extern Vec3 toVec3(const Color& color);
 
+/** Packs the color to RGBA8, the red is in the lowest byte */
+extern std::uint32_t toRGBA8(const Color& color);
+
 /**
  * @brief Projects the screen's point to the OXY plane
  * @param screen_x - the screen's point x coordinate
@@ -29,14 +37,16 @@ extern Vec3 toWorldXYCoordinates(const Point2i& point,
  * @brief Projects the screen's points to the OXY plane
  * @param screen_points - the container with screen's points
  * @param world_z - the z coordinate of the OXY plane
+ * @param resource - the memory resource the result is allocated from
  * @return Point's in  world coordinates
  */
-extern std::vector<Point3f> toWorldXYCoordinates(
+extern std::pmr::vector<Point3f> toWorldXYCoordinates(
         const std::vector<Point2i>& screenPoints,
         std::pair<int, int> viewPortSize,
         const Mat4& view,
         const Mat4& projection,
-        float worldZ = 0.0f);
+        float worldZ = 0.0f,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 /**
  * @brief Projects the screen's point to the camera plane
@@ -55,14 +65,16 @@ extern Vec3 toWorldCoordinates(const Point2i& screenPoint,
  * @brief Projects the screen's point to the camera plane
  * @param screen_points - the container with screen's points
  * @param distance - the relative value of camera plane (0 coresponds to near plane, 1 coresponds to far plane)
+ * @param resource - the memory resource the result is allocated from
  * @return Points in world coordinates
  */
-extern std::vector<Point3f> toWorldCoordinates(
+extern std::pmr::vector<Point3f> toWorldCoordinates(
         const std::vector<Point2i>& screenPoints,
         std::pair<int, int> viewPortSize,
         const Mat4& view,
         const Mat4& projection,
-        float distance);
+        float distance,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 /**
  * @brief Projects the world's point to the screen
@@ -74,5 +86,43 @@ extern Vec2 toScreenCoordinates(const Vec3& worldPoint,
 
 Vec3 calculateNormal(const Point3f& v1, const Point3f& v2, const Point3f& v3);
 
+/**
+ * @brief Checks if the axis aligned box intersects the view frustum
+ * @param transformation - the projection * view matrix
+ * @param min - the box's minimal corner in world coordinates
+ * @param max - the box's maximal corner in world coordinates
+ * @return False if the box is entirely outside of one of the frustum planes
+ */
+extern bool isBoxVisible(const Mat4& transformation, const Vec3& min, const Vec3& max);
+
+/**
+ * @brief Calculates 64 bit hash of the data (the XXH64 algorithm)
+ * @param data - the pointer to the data
+ * @param size - the data size in bytes
+ * @param seed - the initial value of the hash
+ * @return The hash value
+ */
+extern std::uint64_t hash(const void* data, std::size_t size, std::uint64_t seed = 0);
+
+/**
+ * @brief Returns the count of workers of the shared JobSystem, it is used by parallelFor by default
+ */
+extern uint getWorkersCount();
+
+/**
+ * @brief Calls the function for every index in [0, count) on several threads.
+ * Workers take the indices one by one, so the items could have a different cost.
+ * The calling thread is the worker 0, the function returns when all items are done.
+ * The items are done by the workers of the shared JobSystem.
+ * @param count - the count of items
+ * @param function - the function which takes the item's index and the worker's number
+ * @param workersCount - the count of workers, 0 means getWorkersCount()
+ */
+template<typename Function>
+void parallelFor(std::size_t count, const Function& function, uint workersCount = 0)
+{
+    JobSystem::getInstance().parallelFor(count, function, workersCount);
+}
+
 }
 }
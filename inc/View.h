@@ -1,17 +1,24 @@
 #pragma once
 
 #include "Common.h"
+#include "Memory.h"
 
 #include <QOpenGLWidget>
 #include <QOpenGLBuffer>
 #include <QOpenGLFunctions>
 #include <QOpenGLVertexArrayObject>
+#include <chrono>
 
 namespace custom_scene
 {
 
 class Scene;
 class Camera;
+class ScenePreparer;
+class RenderThread;
+class Program;
+class ProgramCompiler;
+class TextureManager;
 
 /**
  * The GLSceneView Class
@@ -23,6 +30,9 @@ class View : public QOpenGLWidget, public QOpenGLFunctions
 
     const Color DefaultBackgroundColor{0, 0, 0};
 
+    /** The time of the frame which is spent for adding the prepared items */
+    const std::chrono::microseconds PreparationBudget{4000};
+
  public:
     View(QWidget* parent = nullptr);
     ~View() override;
@@ -31,6 +41,28 @@ class View : public QOpenGLWidget, public QOpenGLFunctions
     void setScene(std::shared_ptr<Scene> scene);
     void setCamera(std::shared_ptr<Camera> camera);    
 
+    /**
+     * @brief Shows the items of the layers, the switch does not visit the items
+     * @param layerMask - the bitmask of the layers
+     */
+    void setLayerMask(std::uint32_t layerMask);
+
+    /**
+     * @brief The preparer of the scene's items, it is created by setScene()
+     */
+    ScenePreparer* getScenePreparer() const;
+
+    /**
+     * @brief Renders the frames by the dedicated thread, the view only composites them.
+     * It is set before the view is shown.
+     */
+    void setThreadedRendering(bool isThreaded);
+
+    /**
+     * @brief The render thread, it is started by initializeGL() in the threaded mode
+     */
+    RenderThread* getRenderThread() const;
+
 protected:
     void initializeGL() override;
     void resizeGL(int w, int h) override;
@@ -45,7 +77,13 @@ private:
     void clear();
     void cleanup();
     void updateCursorShape();
+
+    /**
+     * @brief Requests the frame which acquires the scene's published changes
+     */
     void updateScene();
+    void publishCamera();
+    void composite();
 
 private:
     int mCurX{0};
@@ -55,6 +93,14 @@ private:
     Color mBackgroundColor{DefaultBackgroundColor};
     std::shared_ptr<Camera> mCamera;
     std::shared_ptr<Scene> mScene;
+    std::unique_ptr<ScenePreparer> mPreparer;
+    std::unique_ptr<ProgramCompiler> mCompiler;
+    std::shared_ptr<TextureManager> mTextureManager;
+    std::unique_ptr<RenderThread> mRenderThread;
+    std::unique_ptr<Program> mCompositor;
+    QOpenGLVertexArrayObject mCompositorArray;
+    bool mIsThreaded{false};
+    memory::HeapCheck mHeapCheck;
 };
 
 }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ScenePipe.h"
+#include "BrickPyramid.h"
+#include "ContextGuard.h"
+
+namespace custom_scene
+{
+
+/**
+ * The VolumePipe Class
+ * @brief The pipe renders the volume directly by ray marching. Only the bricks whose
+ * values are visible with the transfer function are uploaded, they are packed to
+ * one 3D texture, the page table maps the volume's bricks to the atlas. Rays skip
+ * the empty bricks and stop when they are opaque or hit the geometry drawn before
+ * the volume, so the pipe must be added after the pipes with opaque items.
+ * When the visible bricks do not fit the atlas or its byte budget, the bricks are joined 2x2x2 and
+ * sampled with the doubled step until they fit, so the volume is coarser but whole.
+ * While the camera is dragged the rays are marched with the larger step.
+ * The pipe works with the defaults::shaders::Volume program.
+ */
+class VolumePipe : public ScenePipe
+{
+public:
+    struct Parameters
+    {
+        float minValue;
+        float maxValue;
+        std::vector<Color> transferFunction;
+        uint brickSize;
+        float stepSize;
+        float interactiveStepSize;
+        /** The bytes of the atlas' samples, the bricks are coarsened until they fit */
+        std::size_t maxAtlasBytes{256u << 20};
+    };
+
+    struct Stats
+    {
+        /** The bricks of the finest level which have visible values */
+        std::size_t visibleBricksCount{0};
+        std::size_t uploadedBricksCount{0};
+        /** The levels the bricks are coarsened by to fit the atlas, 0 is the full resolution */
+        uint lod{0};
+        /** The visible bricks which are not uploaded because the coarsest level does not fit */
+        std::size_t droppedBricksCount{0};
+    };
+
+    /**
+     * @brief Constructor for VolumePipe
+     * @param program - the volume program
+     * @param volume - the volume, its values must outlive the pipe
+     * @param parameters - the transfer function which maps [minValue, maxValue]
+     * to colors and opacities, the size of the bricks in cells and the steps of rays in cells
+     */
+    VolumePipe(std::shared_ptr<Program> program,
+               const figures::Volume& volume,
+               const Parameters& parameters);
+    ~VolumePipe() override;
+
+    /**
+     * @brief Changes the transfer function. The pyramid is reused,
+     * the atlas is rebuilt with the bricks which become visible.
+     */
+    void setTransferFunction(float minValue,
+                             float maxValue,
+                             const std::vector<Color>& transferFunction);
+
+    void render(std::shared_ptr<Camera> camera,
+                const Lights& lights,
+                const Textures& textures) override;
+
+    std::size_t getUploadedBricksCount() const;
+    Stats getStats() const;
+
+private:
+    void uploadBricks();
+    void uploadTransferFunction();
+    void copySceneDepth(int width, int height);
+
+    /** Takes the depth framebuffer, it is created again by the next frame */
+    ContextGuard::Release takeFramebuffer();
+
+private:
+    figures::Volume mVolume;
+    Parameters mParameters;
+    BrickPyramid mPyramid;
+    std::shared_ptr<Item> mBox;
+    std::unique_ptr<Texture> mAtlas;
+    std::unique_ptr<Texture> mPageTable;
+    std::unique_ptr<Texture> mTransferFunction;
+    std::unique_ptr<Texture> mSceneDepth;
+    GLuint mDepthFramebuffer{0};
+    std::pair<int, int> mDepthSize{0, 0};
+    Vec3 mAtlasSize;
+    Stats mStats;
+    bool mIsUploaded{false};
+    ContextGuard mContextGuard;
+};
+
+}
@@ -0,0 +1,208 @@
+#include "BrickPyramid.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace custom_scene
+{
+
+BrickPyramid::BrickPyramid(const figures::Volume& volume, uint brickSize) :
+    mCellsCount{volume.width > 0 ? volume.width - 1 : 0,
+                volume.height > 0 ? volume.height - 1 : 0,
+                volume.depth > 0 ? volume.depth - 1 : 0},
+    mBrickSize(std::max(1u, brickSize))
+{
+    if (mCellsCount[0] == 0 || mCellsCount[1] == 0 || mCellsCount[2] == 0)
+    {
+        return;
+    }
+
+    Level bricks;
+    for (uint axis = 0; axis < 3; axis++)
+    {
+        bricks.size[axis] = (mCellsCount[axis] + mBrickSize - 1) / mBrickSize;
+    }
+    bricks.ranges.resize(bricks.size[0] * bricks.size[1] * bricks.size[2]);
+
+    // the brick includes the samples of its far faces, so the neighbour
+    // bricks overlap by one sample and every cell is inside one brick
+    utils::parallelFor(bricks.ranges.size(), [&](std::size_t index, uint)
+    {
+        Brick brick{static_cast<uint>(index % bricks.size[0]),
+                    static_cast<uint>(index / bricks.size[0] % bricks.size[1]),
+                    static_cast<uint>(index / bricks.size[0] / bricks.size[1])};
+        auto [first, last] = getCells(brick);
+
+        Range range{std::numeric_limits<float>::max(),
+                    std::numeric_limits<float>::lowest()};
+
+        for (auto z = first[2]; z <= last[2]; z++)
+        {
+            for (auto y = first[1]; y <= last[1]; y++)
+            {
+                auto row = volume.values + (static_cast<std::size_t>(z) * volume.height + y) *
+                        volume.width;
+                auto [min, max] = std::minmax_element(row + first[0], row + last[0] + 1);
+
+                range.min = std::min(range.min, *min);
+                range.max = std::max(range.max, *max);
+            }
+        }
+
+        bricks.ranges[index] = range;
+    });
+
+    mLevels.push_back(std::move(bricks));
+
+    while (mLevels.back().ranges.size() > 1)
+    {
+        const auto& children = mLevels.back();
+        Level parents;
+
+        for (uint axis = 0; axis < 3; axis++)
+        {
+            parents.size[axis] = (children.size[axis] + 1) / 2;
+        }
+        parents.ranges.reserve(parents.size[0] * parents.size[1] * parents.size[2]);
+
+        for (uint z = 0; z < parents.size[2]; z++)
+        {
+            for (uint y = 0; y < parents.size[1]; y++)
+            {
+                for (uint x = 0; x < parents.size[0]; x++)
+                {
+                    Range range{std::numeric_limits<float>::max(),
+                                std::numeric_limits<float>::lowest()};
+
+                    for (auto childZ = 2 * z; childZ < std::min(2 * z + 2, children.size[2]); childZ++)
+                    {
+                        for (auto childY = 2 * y; childY < std::min(2 * y + 2, children.size[1]); childY++)
+                        {
+                            for (auto childX = 2 * x; childX < std::min(2 * x + 2, children.size[0]); childX++)
+                            {
+                                const auto& child = children.at(childX, childY, childZ);
+                                range.min = std::min(range.min, child.min);
+                                range.max = std::max(range.max, child.max);
+                            }
+                        }
+                    }
+
+                    parents.ranges.push_back(range);
+                }
+            }
+        }
+
+        mLevels.push_back(std::move(parents));
+    }
+}
+
+std::pmr::vector<BrickPyramid::Brick> BrickPyramid::findBricks(
+        float value,
+        std::pmr::memory_resource* resource) const
+{
+    std::pmr::vector<Brick> bricks(resource);
+
+    if (!mLevels.empty())
+    {
+        findBricks(static_cast<uint>(mLevels.size() - 1),
+                   {0, 0, 0},
+                   [value](const Range& range)
+                   {
+                       return range.min < value && range.max >= value;
+                   },
+                   bricks);
+    }
+
+    return bricks;
+}
+
+std::pmr::vector<BrickPyramid::Brick> BrickPyramid::findBricks(
+        float min,
+        float max,
+        std::pmr::memory_resource* resource) const
+{
+    std::pmr::vector<Brick> bricks(resource);
+
+    if (!mLevels.empty())
+    {
+        findBricks(static_cast<uint>(mLevels.size() - 1),
+                   {0, 0, 0},
+                   [min, max](const Range& range)
+                   {
+                       return range.max >= min && range.min <= max;
+                   },
+                   bricks);
+    }
+
+    return bricks;
+}
+
+template<typename Predicate>
+void BrickPyramid::findBricks(uint level,
+                              const Brick& brick,
+                              const Predicate& predicate,
+                              std::pmr::vector<Brick>& bricks) const
+{
+    const auto& bricksLevel = mLevels[level];
+
+    if (brick[0] >= bricksLevel.size[0] ||
+        brick[1] >= bricksLevel.size[1] ||
+        brick[2] >= bricksLevel.size[2] ||
+        !predicate(bricksLevel.at(brick[0], brick[1], brick[2])))
+    {
+        return;
+    }
+
+    if (level == 0)
+    {
+        bricks.push_back(brick);
+        return;
+    }
+
+    for (uint child = 0; child < 8; child++)
+    {
+        findBricks(level - 1,
+                   {2 * brick[0] + (child & 1),
+                    2 * brick[1] + ((child >> 1) & 1),
+                    2 * brick[2] + (child >> 2)},
+                   predicate,
+                   bricks);
+    }
+}
+
+const BrickPyramid::Range& BrickPyramid::getRange(const Brick& brick) const
+{
+    return mLevels.front().at(brick[0], brick[1], brick[2]);
+}
+
+const BrickPyramid::Brick& BrickPyramid::getBricksCount() const
+{
+    static const Brick empty{0, 0, 0};
+    return mLevels.empty() ? empty : mLevels.front().size;
+}
+
+uint BrickPyramid::getBrickSize() const
+{
+    return mBrickSize;
+}
+
+std::array<BrickPyramid::Brick, 2> BrickPyramid::getCells(const Brick& brick) const
+{
+    std::array<Brick, 2> cells;
+
+    for (uint axis = 0; axis < 3; axis++)
+    {
+        cells[0][axis] = brick[axis] * mBrickSize;
+        cells[1][axis] = std::min(cells[0][axis] + mBrickSize, mCellsCount[axis]);
+    }
+
+    return cells;
+}
+
+const BrickPyramid::Range& BrickPyramid::Level::at(uint x, uint y, uint z) const
+{
+    return ranges[(static_cast<std::size_t>(z) * size[1] + y) * size[0] + x];
+}
+
+}
@@ -157,15 +157,17 @@ Vec3 Camera::toWorldXYCoordinates(const Point2i& point, float worldZ)
                                        worldZ);
 }
 
-std::vector<Point3f> Camera::toWorldXYCoordinates(
+std::pmr::vector<Point3f> Camera::toWorldXYCoordinates(
         const std::vector<Point2i>& screenPoints,
-        float worldZ)
+        float worldZ,
+        std::pmr::memory_resource* resource)
 {
     return utils::toWorldXYCoordinates(screenPoints,
                                        mViewPortSize,
                                        mViewMatrix,
                                        mCurrentProjection->get(),
-                                       worldZ);
+                                       worldZ,
+                                       resource);
 }
 
 Vec3 Camera::toWorldCoordinates(const Point2i& screenPoint, float distance)
@@ -177,15 +179,17 @@ Vec3 Camera::toWorldCoordinates(const Point2i& screenPoint, float distance)
                                      distance);
 }
 
-std::vector<Point3f> Camera::toWorldCoordinates(
+std::pmr::vector<Point3f> Camera::toWorldCoordinates(
         const std::vector<Point2i>& screenPoints,
-        float distance)
+        float distance,
+        std::pmr::memory_resource* resource)
 {
     return utils::toWorldCoordinates(screenPoints,
                                      mViewPortSize,
                                      mViewMatrix,
                                      mCurrentProjection->get(),
-                                     distance);
+                                     distance,
+                                     resource);
 }
 
 void Camera::update(bool use_angles, bool update_look)
@@ -387,4 +391,30 @@ const std::pair<int, int> &Camera::getViewPortSize() const
     return mViewPortSize;
 }
 
+float Camera::getProjectionKoef(float distance) const
+{
+    return mCurrentProjection->getProjectionKoef(distance, mViewPortSize.first);
+}
+
+std::shared_ptr<Camera> Camera::getSnapshot() const
+{
+    auto snapshot = std::make_shared<Camera>(*this);
+    snapshot->mProjections = {mCurrentProjection->clone()};
+    snapshot->mCurrentProjection = snapshot->mProjections.front();
+    snapshot->mCurrentProjectionIndex = 0;
+    snapshot->mManipulator = nullptr;
+
+    return snapshot;
+}
+
+void Camera::setLayerMask(std::uint32_t layerMask)
+{
+    mLayerMask = layerMask;
+}
+
+std::uint32_t Camera::getLayerMask() const
+{
+    return mLayerMask;
+}
+
 }
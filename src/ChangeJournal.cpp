@@ -0,0 +1,148 @@
+#include "ChangeJournal.h"
+
+namespace custom_scene
+{
+
+bool Changes::isEmpty() const
+{
+    return pipes.isEmpty() &&
+           items.isEmpty() &&
+           lights.isEmpty() &&
+           textures.isEmpty();
+}
+
+void ChangeJournal::addPipe(std::shared_ptr<ScenePipe> pipe)
+{
+    record(mPipes, std::move(pipe), Change::kAdded);
+}
+
+void ChangeJournal::removePipe(std::shared_ptr<ScenePipe> pipe)
+{
+    mChangedPipes.erase(pipe.get());
+    record(mPipes, std::move(pipe), Change::kRemoved);
+}
+
+void ChangeJournal::addItem(std::shared_ptr<ScenePipe> pipe, std::shared_ptr<Item> item)
+{
+    mChangedPipes.try_emplace(pipe.get(), pipe);
+    record(mItems, std::move(item), Change::kAdded);
+}
+
+void ChangeJournal::removeItem(std::shared_ptr<ScenePipe> pipe, std::shared_ptr<Item> item)
+{
+    mChangedPipes.try_emplace(pipe.get(), pipe);
+    record(mItems, std::move(item), Change::kRemoved);
+}
+
+void ChangeJournal::modifyItem(std::shared_ptr<ScenePipe> pipe, std::shared_ptr<Item> item)
+{
+    mChangedPipes.try_emplace(pipe.get(), pipe);
+    record(mItems, std::move(item), Change::kModified);
+}
+
+void ChangeJournal::addLight(std::shared_ptr<Light> light)
+{
+    record(mLights, std::move(light), Change::kAdded);
+}
+
+void ChangeJournal::removeLight(std::shared_ptr<Light> light)
+{
+    record(mLights, std::move(light), Change::kRemoved);
+}
+
+void ChangeJournal::addTexture(std::shared_ptr<Texture> texture)
+{
+    record(mTextures, std::move(texture), Change::kAdded);
+}
+
+void ChangeJournal::removeTexture(std::shared_ptr<Texture> texture)
+{
+    record(mTextures, std::move(texture), Change::kRemoved);
+}
+
+bool ChangeJournal::isEmpty() const
+{
+    return mPipes.empty() &&
+           mItems.empty() &&
+           mLights.empty() &&
+           mTextures.empty();
+}
+
+Changes ChangeJournal::take()
+{
+    Changes changes;
+
+    take(mPipes, changes.pipes);
+    take(mItems, changes.items);
+    take(mLights, changes.lights);
+    take(mTextures, changes.textures);
+
+    changes.changedPipes.reserve(mChangedPipes.size());
+    for (auto& [key, pipe] : mChangedPipes)
+    {
+        changes.changedPipes.push_back(std::move(pipe));
+    }
+    mChangedPipes.clear();
+
+    return changes;
+}
+
+template<typename T>
+void ChangeJournal::record(Records<T>& records, std::shared_ptr<T> object, Change change)
+{
+    auto key = object.get();
+    auto [record, isInserted] = records.try_emplace(key, Record<T>{std::move(object), change});
+
+    if (isInserted)
+    {
+        return;
+    }
+
+    auto& previous = record->second.change;
+
+    switch (previous)
+    {
+        case Change::kAdded:
+            if (change == Change::kRemoved)
+            {
+                records.erase(record);
+            }
+            break;
+        case Change::kRemoved:
+            if (change == Change::kAdded)
+            {
+                previous = Change::kModified;
+            }
+            break;
+        case Change::kModified:
+            if (change == Change::kRemoved)
+            {
+                previous = Change::kRemoved;
+            }
+            break;
+    }
+}
+
+template<typename T>
+void ChangeJournal::take(Records<T>& records, Changes::Delta<T>& delta)
+{
+    for (auto& [key, record] : records)
+    {
+        switch (record.change)
+        {
+            case Change::kAdded:
+                delta.added.push_back(std::move(record.object));
+                break;
+            case Change::kRemoved:
+                delta.removed.push_back(std::move(record.object));
+                break;
+            case Change::kModified:
+                delta.modified.push_back(std::move(record.object));
+                break;
+        }
+    }
+
+    records.clear();
+}
+
+}
@@ -0,0 +1,210 @@
+#include "ContextGuard.h"
+
+#include <QOpenGLContext>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace custom_scene
+{
+
+struct ContextGuard::State
+{
+    QOpenGLContext* context{nullptr};
+    std::mutex mutex;
+    std::unordered_map<ContextGuard*, Take> owners;
+    /** The releases of the owners which are destroyed out of the context */
+    std::vector<Release> releases;
+    std::atomic<bool> isDestroyed{false};
+};
+
+/** The states of the contexts which have attached owners */
+struct ContextGuard::Registry
+{
+    std::mutex mutex;
+    std::unordered_map<QOpenGLContext*, std::shared_ptr<State>> states;
+};
+
+ContextGuard::~ContextGuard()
+{
+    release();
+}
+
+void ContextGuard::attach(Take take)
+{
+    auto context = QOpenGLContext::currentContext();
+
+    if (!context)
+    {
+        return;
+    }
+
+    if (mState && mState->context == context && !mState->isDestroyed)
+    {
+        return;
+    }
+
+    release();
+
+    mState = getState(context);
+
+    std::lock_guard lock(mState->mutex);
+    mState->owners[this] = std::move(take);
+}
+
+void ContextGuard::release()
+{
+    if (!mState)
+    {
+        return;
+    }
+
+    auto state = std::move(mState);
+    std::unique_lock lock(state->mutex);
+
+    // the objects of the destroyed context are already released
+    auto owner = state->owners.find(this);
+    if (owner == state->owners.end())
+    {
+        return;
+    }
+
+    auto release = owner->second();
+    state->owners.erase(owner);
+
+    if (QOpenGLContext::currentContext() != state->context)
+    {
+        state->releases.push_back(std::move(release));
+        return;
+    }
+
+    lock.unlock();
+    release(*state->context->extraFunctions());
+}
+
+bool ContextGuard::isAttached() const
+{
+    return mState && !mState->isDestroyed;
+}
+
+void ContextGuard::collect()
+{
+    auto context = QOpenGLContext::currentContext();
+    std::shared_ptr<State> state;
+
+    {
+        auto& registry = getRegistry();
+        std::lock_guard lock(registry.mutex);
+        auto found = registry.states.find(context);
+
+        if (found == registry.states.end())
+        {
+            return;
+        }
+
+        state = found->second;
+    }
+
+    std::vector<Release> releases;
+
+    {
+        std::lock_guard lock(state->mutex);
+        releases.swap(state->releases);
+    }
+
+    for (const auto& release : releases)
+    {
+        release(*context->extraFunctions());
+    }
+}
+
+void ContextGuard::releaseAll()
+{
+    std::shared_ptr<State> state;
+
+    {
+        auto& registry = getRegistry();
+        std::lock_guard lock(registry.mutex);
+        auto found = registry.states.find(QOpenGLContext::currentContext());
+
+        if (found == registry.states.end())
+        {
+            return;
+        }
+
+        state = found->second;
+    }
+
+    destroy(*state);
+}
+
+ContextGuard::Registry& ContextGuard::getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+std::shared_ptr<ContextGuard::State> ContextGuard::getState(QOpenGLContext* context)
+{
+    auto& registry = getRegistry();
+    std::lock_guard lock(registry.mutex);
+
+    auto& state = registry.states[context];
+
+    if (!state)
+    {
+        state = std::make_shared<State>();
+        state->context = context;
+
+        // the context which is destroyed without releaseAll() drops its owners,
+        // their objects are deleted only if the context is still current
+        QObject::connect(context, &QOpenGLContext::aboutToBeDestroyed, context, [state]()
+        {
+            destroy(*state);
+        }, Qt::DirectConnection);
+    }
+
+    return state;
+}
+
+void ContextGuard::destroy(State& state)
+{
+    {
+        auto& registry = getRegistry();
+        std::lock_guard lock(registry.mutex);
+        auto found = registry.states.find(state.context);
+
+        if (found != registry.states.end() && found->second.get() == &state)
+        {
+            registry.states.erase(found);
+        }
+    }
+
+    // the owners which are destroyed meanwhile wait for their objects to be released
+    std::lock_guard lock(state.mutex);
+
+    if (state.isDestroyed)
+    {
+        return;
+    }
+
+    state.isDestroyed = true;
+
+    for (auto& [owner, take] : state.owners)
+    {
+        state.releases.push_back(take());
+    }
+    state.owners.clear();
+
+    if (QOpenGLContext::currentContext() == state.context)
+    {
+        for (const auto& release : state.releases)
+        {
+            release(*state.context->extraFunctions());
+        }
+    }
+    state.releases.clear();
+}
+
+}
@@ -8,6 +8,665 @@ namespace colors{
 
 
 
+}
+
+namespace attributes
+{
+
+const std::vector<Pipe::Attribute> Vertex = {
+    {3, 11, 0},
+    {3, 11, 3},
+    {3, 11, 6},
+    {2, 11, 9}
+};
+
+}
+
+namespace shaders
+{
+
+const ShaderSources Terrain = {
+    {QOpenGLShader::Vertex, R"(
+        #version 330 core
+        layout (location = 3) in vec2 aTexture;
+
+        uniform mat4 projection;
+        uniform mat4 view;
+        uniform vec3 viewPos;
+        uniform sampler2D heightMap;
+        uniform vec2 chunkOrigin;
+        uniform float chunkSize;
+        uniform float gridResolution;
+        uniform vec2 tileTransform;
+        uniform vec2 morphRange;
+        uniform float heightScale;
+
+        out vec3 FragPos;
+        out vec3 Normal;
+        out vec2 TexCoords;
+
+        float sampleHeight(vec2 gridPos)
+        {
+            vec2 uv = gridPos * tileTransform.x + tileTransform.y;
+            return texture(heightMap, uv).r * heightScale;
+        }
+
+        void main()
+        {
+            vec2 gridPos = aTexture;
+            vec2 worldPos = chunkOrigin + gridPos * chunkSize;
+            float cameraDistance = length(vec3(worldPos, sampleHeight(gridPos)) - viewPos);
+            float morph = clamp((cameraDistance - morphRange.x) /
+                                (morphRange.y - morphRange.x), 0.0, 1.0);
+
+            vec2 fracPart = fract(gridPos * gridResolution * 0.5) * 2.0 / gridResolution;
+            gridPos -= fracPart * morph;
+            worldPos = chunkOrigin + gridPos * chunkSize;
+
+            float texel = 1.0 / gridResolution;
+            float dx = sampleHeight(gridPos + vec2(texel, 0.0)) -
+                       sampleHeight(gridPos - vec2(texel, 0.0));
+            float dy = sampleHeight(gridPos + vec2(0.0, texel)) -
+                       sampleHeight(gridPos - vec2(0.0, texel));
+
+            FragPos = vec3(worldPos, sampleHeight(gridPos));
+            Normal = normalize(vec3(-dx, -dy, 2.0 * texel * chunkSize));
+            TexCoords = gridPos;
+            gl_Position = projection * view * vec4(FragPos, 1.0);
+        }
+    )"},
+    {QOpenGLShader::Fragment, R"(
+        #version 330 core
+        struct Material
+        {
+            vec3 ambient;
+            vec3 diffuse;
+            vec3 specular;
+            float shininess;
+        };
+
+        struct Light
+        {
+            vec3 direction;
+            vec3 ambient;
+            vec3 diffuse;
+            vec3 specular;
+        };
+
+        uniform Material material;
+        uniform Light light;
+        uniform vec3 viewPos;
+        uniform float alfa;
+
+        in vec3 FragPos;
+        in vec3 Normal;
+        in vec2 TexCoords;
+
+        out vec4 FragColor;
+
+        void main()
+        {
+            vec3 normal = normalize(Normal);
+            vec3 lightDir = normalize(-light.direction);
+            vec3 viewDir = normalize(viewPos - FragPos);
+            vec3 reflectDir = reflect(-lightDir, normal);
+
+            float diff = max(dot(normal, lightDir), 0.0);
+            float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+
+            vec3 color = light.ambient * material.ambient +
+                         light.diffuse * diff * material.diffuse +
+                         light.specular * spec * material.specular;
+
+            FragColor = vec4(color, alfa);
+        }
+    )"}
+};
+
+const ShaderSources Volume = {
+    {QOpenGLShader::Vertex, R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+
+        uniform mat4 projection;
+        uniform mat4 view;
+        uniform mat4 model;
+
+        out vec3 TexturePos;
+
+        void main()
+        {
+            TexturePos = aPos;
+            gl_Position = projection * view * model * vec4(aPos, 1.0);
+        }
+    )"},
+    {QOpenGLShader::Fragment, R"(
+        #version 330 core
+        uniform sampler3D atlas;
+        uniform sampler3D pageTable;
+        uniform sampler2D transferFunction;
+        uniform sampler2D sceneDepth;
+
+        uniform mat4 inverseTransformation;
+        uniform vec3 cameraPos;
+        uniform vec3 volumeSize;
+        uniform vec3 atlasSize;
+        uniform float brickSize;
+        // the cells between the atlas' texels, the bricks of the coarser levels are sampled sparser
+        uniform float cellStep;
+        uniform vec2 valueRange;
+        uniform vec2 viewportSize;
+        uniform float stepSize;
+        uniform float alfa;
+
+        in vec3 TexturePos;
+
+        out vec4 FragColor;
+
+        const int MaxSteps = 4096;
+        const float OpaqueAlfa = 0.99;
+
+        void main()
+        {
+            // the ray is marched in the cells' space
+            vec3 origin = cameraPos * volumeSize;
+            vec3 direction = normalize(TexturePos * volumeSize - origin);
+            vec3 inverseDirection = 1.0 / direction;
+
+            vec3 t0 = -origin * inverseDirection;
+            vec3 t1 = (volumeSize - origin) * inverseDirection;
+            float tNear = max(max(max(min(t0.x, t1.x), min(t0.y, t1.y)), min(t0.z, t1.z)), 0.0);
+            float tFar = min(min(max(t0.x, t1.x), max(t0.y, t1.y)), max(t0.z, t1.z));
+
+            // the ray stops at the opaque geometry drawn before the volume
+            vec2 screenPos = gl_FragCoord.xy / viewportSize;
+            vec4 scenePos = inverseTransformation *
+                    vec4(vec3(screenPos, texture(sceneDepth, screenPos).r) * 2.0 - 1.0, 1.0);
+            tFar = min(tFar, dot(scenePos.xyz / scenePos.w * volumeSize - origin, direction));
+
+            vec4 color = vec4(0.0);
+            float t = tNear;
+            float pageSize = brickSize * cellStep;
+
+            for (int i = 0; i < MaxSteps && t < tFar && color.a < OpaqueAlfa; i++)
+            {
+                vec3 position = origin + t * direction;
+                vec3 brick = floor(clamp(position, vec3(0.0), volumeSize - 0.001) / pageSize);
+                vec4 page = texelFetch(pageTable, ivec3(brick), 0);
+
+                if (page.a == 0.0)
+                {
+                    // the empty brick is skipped up to its exit point
+                    vec3 exit = (brick + step(0.0, direction)) * pageSize;
+                    vec3 tExit = (exit - origin) * inverseDirection;
+                    t = max(min(min(tExit.x, tExit.y), tExit.z), t) + 0.01;
+                    continue;
+                }
+
+                vec3 texel = round(page.xyz * 255.0) * (brickSize + 1.0) +
+                        (position - brick * pageSize) / cellStep + 0.5;
+                float value = texture(atlas, texel / atlasSize).r;
+                vec4 voxel = texture(transferFunction,
+                                      vec2((value - valueRange.x) / (valueRange.y - valueRange.x), 0.5));
+
+                // the opacity is corrected for the step's length
+                voxel.a = 1.0 - pow(1.0 - voxel.a, stepSize);
+                color.rgb += (1.0 - color.a) * voxel.a * voxel.rgb;
+                color.a += (1.0 - color.a) * voxel.a;
+
+                t += stepSize;
+            }
+
+            if (color.a <= 0.0)
+            {
+                discard;
+            }
+
+            FragColor = vec4(color.rgb / color.a, color.a * alfa);
+        }
+    )"}
+};
+
+const ShaderSources PointCloud = {
+    {QOpenGLShader::Vertex, R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 2) in vec4 aColor;
+
+        uniform mat4 projection;
+        uniform mat4 view;
+        uniform mat4 model;
+        uniform float pointSize;
+
+        out vec4 PointColor;
+
+        void main()
+        {
+            PointColor = aColor;
+            gl_Position = projection * view * model * vec4(aPos, 1.0);
+            gl_PointSize = pointSize;
+        }
+    )"},
+    {QOpenGLShader::Fragment, R"(
+        #version 330 core
+        in vec4 PointColor;
+
+        uniform float alfa;
+
+        out vec4 FragColor;
+
+        void main()
+        {
+            vec2 offset = gl_PointCoord * 2.0 - 1.0;
+            if (dot(offset, offset) > 1.0)
+            {
+                discard;
+            }
+
+            FragColor = vec4(PointColor.rgb, PointColor.a * alfa);
+        }
+    )"}
+};
+
+namespace
+{
+
+/** The expansion of the segment to the screen-aligned quad, the corner is 0..3 of the strip */
+const QString SegmentExpansion = R"(
+        uniform mat4 projection;
+        uniform mat4 view;
+        uniform mat4 model;
+        uniform vec2 viewportSize;
+        uniform float miterLimit;
+
+        noperspective out vec2 LinePos;
+        noperspective out float LineLength;
+        noperspective out float HalfWidth;
+        flat out uint Style;
+        out vec4 LineColor;
+
+        const uint HasPrevious = 1u;
+        const uint HasNext = 2u;
+        const uint JoinRound = 1u;
+        const uint CapSquare = 1u;
+        const uint CapRound = 2u;
+        const float MinW = 1e-4;
+
+        vec2 toScreen(vec4 position)
+        {
+            return position.xy / position.w * viewportSize * 0.5;
+        }
+
+        void expandSegment(vec3 previousPoint,
+                           vec3 startPoint,
+                           vec3 endPoint,
+                           vec3 nextPoint,
+                           float width,
+                           vec4 color,
+                           uint segmentStyle,
+                           int corner)
+        {
+            mat4 transformation = projection * view * model;
+            vec4 start = transformation * vec4(startPoint, 1.0);
+            vec4 end = transformation * vec4(endPoint, 1.0);
+            uint style = segmentStyle;
+
+            // the segment is clipped by the plane in front of the camera
+            if (start.w < MinW && end.w < MinW)
+            {
+                gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+                return;
+            }
+            if (start.w < MinW)
+            {
+                start = mix(start, end, (MinW - start.w) / (end.w - start.w));
+                style &= ~HasPrevious;
+            }
+            if (end.w < MinW)
+            {
+                end = mix(end, start, (MinW - end.w) / (start.w - end.w));
+                style &= ~HasNext;
+            }
+
+            vec2 startPos = toScreen(start);
+            vec2 endPos = toScreen(end);
+            float segmentLength = length(endPos - startPos);
+            vec2 direction = segmentLength > 1e-4 ? (endPos - startPos) / segmentLength
+                                                  : vec2(1.0, 0.0);
+            vec2 normal = vec2(-direction.y, direction.x);
+            float halfWidth = width * 0.5;
+
+            bool isEnd = corner >= 2;
+            float side = (corner & 1) == 0 ? -1.0 : 1.0;
+            bool hasNeighbour = (style & (isEnd ? HasNext : HasPrevious)) != 0u;
+            uint join = (style >> 2) & 3u;
+            uint cap = (style >> 4) & 3u;
+
+            vec2 offset = normal * side * halfWidth;
+
+            if (hasNeighbour && join != JoinRound)
+            {
+                vec4 neighbour = transformation * vec4(isEnd ? nextPoint : previousPoint, 1.0);
+                vec2 neighbourDirection = isEnd ? toScreen(neighbour) - endPos
+                                                : startPos - toScreen(neighbour);
+                vec2 tangent = direction + normalize(neighbourDirection);
+
+                if (neighbour.w >= MinW && length(neighbourDirection) > 1e-4 &&
+                    length(tangent) > 1e-4)
+                {
+                    tangent = normalize(tangent);
+                    vec2 miter = vec2(-tangent.y, tangent.x);
+                    float miterLength = halfWidth / max(dot(miter, normal), 1.0 / miterLimit);
+                    offset = miter * side * miterLength;
+                }
+            }
+            else if (hasNeighbour || cap != 0u)
+            {
+                offset += direction * (isEnd ? halfWidth : -halfWidth);
+            }
+
+            vec4 position = isEnd ? end : start;
+            position.xy += offset / (viewportSize * 0.5) * position.w;
+
+            LinePos = vec2(dot(offset, direction) + (isEnd ? segmentLength : 0.0),
+                           dot(offset, normal));
+            LineLength = segmentLength;
+            HalfWidth = halfWidth;
+            Style = style;
+            LineColor = color;
+            gl_Position = position;
+        }
+    )";
+
+}
+
+const ShaderSources Line = {
+    {QOpenGLShader::Vertex, QString(R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPrevious;
+        layout (location = 1) in vec3 aStart;
+        layout (location = 2) in vec3 aEnd;
+        layout (location = 3) in vec3 aNext;
+        layout (location = 4) in float aWidth;
+        layout (location = 5) in vec4 aColor;
+        layout (location = 6) in uint aStyle;
+    )") + SegmentExpansion + R"(
+        void main()
+        {
+            expandSegment(aPrevious, aStart, aEnd, aNext, aWidth, aColor, aStyle, gl_VertexID);
+        }
+    )"},
+    {QOpenGLShader::Fragment, R"(
+        #version 330 core
+        noperspective in vec2 LinePos;
+        noperspective in float LineLength;
+        noperspective in float HalfWidth;
+        flat in uint Style;
+        in vec4 LineColor;
+
+        uniform float alfa;
+
+        out vec4 FragColor;
+
+        const uint HasPrevious = 1u;
+        const uint HasNext = 2u;
+        const uint JoinRound = 1u;
+        const uint CapRound = 2u;
+
+        bool isRound(uint neighbourBit)
+        {
+            return (Style & neighbourBit) != 0u ? ((Style >> 2) & 3u) == JoinRound
+                                                : ((Style >> 4) & 3u) == CapRound;
+        }
+
+        void main()
+        {
+            // the round ends are cut from the extended quad by the distance to the end
+            if ((LinePos.x < 0.0 && isRound(HasPrevious) &&
+                 length(LinePos) > HalfWidth) ||
+                (LinePos.x > LineLength && isRound(HasNext) &&
+                 length(LinePos - vec2(LineLength, 0.0)) > HalfWidth))
+            {
+                discard;
+            }
+
+            FragColor = vec4(LineColor.rgb, LineColor.a * alfa);
+        }
+    )"}
+};
+
+const QString TransformFetch = R"(
+        layout (location = 4) in uint aItemIndex;
+
+        uniform samplerBuffer transforms;
+        uniform int transformsOffset;
+
+        mat4 getModel()
+        {
+            int base = (transformsOffset + int(aItemIndex)) * 7;
+            return mat4(texelFetch(transforms, base),
+                        texelFetch(transforms, base + 1),
+                        texelFetch(transforms, base + 2),
+                        texelFetch(transforms, base + 3));
+        }
+
+        mat3 getNormal()
+        {
+            int base = (transformsOffset + int(aItemIndex)) * 7 + 4;
+            return mat3(texelFetch(transforms, base).xyz,
+                        texelFetch(transforms, base + 1).xyz,
+                        texelFetch(transforms, base + 2).xyz);
+        }
+)";
+
+const QString MaterialIndex = R"(
+        layout (location = 5) in uint aMaterialIndex;
+
+        flat out uint MaterialIndex;
+)";
+
+const QString MaterialFetch = R"(
+        flat in uint MaterialIndex;
+
+        uniform samplerBuffer materials;
+        uniform sampler2D diffuseMap;
+        uniform sampler2D specularMap;
+        uniform sampler2D normalMap;
+        uniform sampler2DArray textureArray0;
+        uniform sampler2DArray textureArray1;
+        uniform sampler2DArray textureArray2;
+        uniform sampler2DArray textureArray3;
+        uniform float texturePageSize;
+
+        const int DiffuseMap = 1;
+        const int SpecularMap = 2;
+        const int NormalMap = 4;
+
+        const int DiffuseSlot = 3;
+        const int SpecularSlot = 5;
+        const int NormalSlot = 7;
+
+        vec4 sampleArray(int array, vec3 coords, float lod)
+        {
+            if (array == 0)
+            {
+                return textureLod(textureArray0, coords, lod);
+            }
+            if (array == 1)
+            {
+                return textureLod(textureArray1, coords, lod);
+            }
+            if (array == 2)
+            {
+                return textureLod(textureArray2, coords, lod);
+            }
+            return textureLod(textureArray3, coords, lod);
+        }
+
+        // the packed map is read from its cell of the manager's page, otherwise from its unit
+        vec4 sampleMap(sampler2D map, int slot, vec2 texCoords)
+        {
+            int base = int(MaterialIndex) * 11 + slot;
+            vec4 rect = texelFetch(materials, base);
+            vec4 location = texelFetch(materials, base + 1);
+
+            vec2 dx = dFdx(texCoords) * rect.zw * texturePageSize;
+            vec2 dy = dFdy(texCoords) * rect.zw * texturePageSize;
+
+            if (location.y < 0.0)
+            {
+                return texture(map, texCoords);
+            }
+
+            // the level is clamped to the cell's texel, the coordinates repeat in the cell
+            float lod = clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0, location.z);
+            vec2 coords = rect.xy + fract(texCoords) * rect.zw;
+
+            return sampleArray(int(location.y), vec3(coords, location.x), lod);
+        }
+
+        struct Material
+        {
+            vec3 ambient;
+            vec3 diffuse;
+            vec3 specular;
+            float shininess;
+            int type;
+            int maps;
+        };
+
+        Material getMaterial(vec2 texCoords)
+        {
+            int base = int(MaterialIndex) * 11;
+            vec4 ambient = texelFetch(materials, base);
+            vec4 diffuse = texelFetch(materials, base + 1);
+            vec4 specular = texelFetch(materials, base + 2);
+
+            Material material = Material(ambient.rgb,
+                                         diffuse.rgb,
+                                         specular.rgb,
+                                         ambient.a,
+                                         int(diffuse.a),
+                                         int(specular.a));
+
+            if ((material.maps & DiffuseMap) != 0)
+            {
+                vec3 color = sampleMap(diffuseMap, DiffuseSlot, texCoords).rgb;
+                material.ambient *= color;
+                material.diffuse *= color;
+            }
+            if ((material.maps & SpecularMap) != 0)
+            {
+                material.specular *= sampleMap(specularMap, SpecularSlot, texCoords).rgb;
+            }
+
+            return material;
+        }
+
+        vec3 getMaterialNormal(Material material, vec3 normal, vec3 position, vec2 texCoords)
+        {
+            if ((material.maps & NormalMap) == 0)
+            {
+                return normal;
+            }
+
+            // the meshes have no tangents, the tangent frame is built from the derivatives
+            vec3 dp1 = dFdx(position);
+            vec3 dp2 = dFdy(position);
+            vec2 duv1 = dFdx(texCoords);
+            vec2 duv2 = dFdy(texCoords);
+            vec3 dp2perp = cross(dp2, normal);
+            vec3 dp1perp = cross(normal, dp1);
+            vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+            vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+            float scale = inversesqrt(max(max(dot(tangent, tangent), dot(bitangent, bitangent)), 1e-12));
+
+            vec3 mapped = sampleMap(normalMap, NormalSlot, texCoords).xyz * 2.0 - 1.0;
+            return normalize(mat3(tangent * scale, bitangent * scale, normal) * mapped);
+        }
+)";
+
+const ShaderSources Composite = {
+    {QOpenGLShader::Vertex, R"(
+        #version 330 core
+        out vec2 TexCoords;
+
+        void main()
+        {
+            TexCoords = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+            gl_Position = vec4(TexCoords * 2.0 - 1.0, 0.0, 1.0);
+        }
+    )"},
+    {QOpenGLShader::Fragment, R"(
+        #version 330 core
+        in vec2 TexCoords;
+
+        uniform sampler2D frame;
+
+        out vec4 FragColor;
+
+        void main()
+        {
+            FragColor = texture(frame, TexCoords);
+        }
+    )"}
+};
+
+const ShaderSources Track = {
+    {QOpenGLShader::Vertex, QString(R"(
+        #version 330 core
+        uniform samplerBuffer points;
+        uniform usamplerBuffer headers;
+        uniform int pointsCapacity;
+        // the offsets of the frame's region in the buffers
+        uniform int pointsOffset;
+        uniform int headersOffset;
+    )") + SegmentExpansion + R"(
+        const int Corners[6] = int[6](0, 1, 2, 2, 1, 3);
+
+        vec3 getPoint(int base, int index)
+        {
+            return texelFetch(points, base + index % pointsCapacity).xyz;
+        }
+
+        void main()
+        {
+            int segment = gl_VertexID / 6;
+            int track = segment / pointsCapacity;
+            int index = segment % pointsCapacity;
+            int base = pointsOffset + track * pointsCapacity;
+
+            // the header is (tail, count) and (width, style, color)
+            uvec4 ring = texelFetch(headers, headersOffset + 2 * track);
+            uvec4 appearance = texelFetch(headers, headersOffset + 2 * track + 1);
+            int order = (index - int(ring.x) + pointsCapacity) % pointsCapacity;
+
+            uint style = appearance.y;
+            if (order > 0)
+            {
+                style |= HasPrevious;
+            }
+            if (order + 2 < int(ring.y))
+            {
+                style |= HasNext;
+            }
+
+            vec4 color = vec4(uvec4(appearance.z, appearance.z >> 8,
+                                    appearance.z >> 16, appearance.z >> 24) & 255u) / 255.0;
+
+            expandSegment(getPoint(base, index + pointsCapacity - 1),
+                          getPoint(base, index),
+                          getPoint(base, index + 1),
+                          getPoint(base, index + 2),
+                          uintBitsToFloat(appearance.x),
+                          color,
+                          style,
+                          Corners[gl_VertexID % 6]);
+        }
+    )"},
+    {QOpenGLShader::Fragment, Line.at(QOpenGLShader::Fragment)}
+};
+
 }
 }
 }
@@ -1,85 +1,855 @@
 #include "Generator.h"
 #include "Utils.h"
+#include "Memory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
 
 namespace custom_scene
 {
 
 using namespace utils;
 
-Geometry Generator::generate(const figures::Cube& figure)
+namespace
 {
-    Geometry geometry;
 
-    auto s = figure.size;
+/** The count of the heightfield's vertices from which its rows are written in parallel */
+constexpr std::size_t ParallelVerticesCount{1 << 16};
 
-    std::vector<Point3f> points = {
-        {-s, -s, -s}, {-s, s, -s}, {s, s, -s}, {s, -s, -s},
-        {-s, -s, s}, {-s, s, s}, {s, s, s}, {s, -s, s}
-    };
+using Circle = std::vector<Point2f>;
+
+/**
+ * @brief Returns the shared table of cosines and sines of the circle divided by segments.
+ * The table has segments + 1 entries, the last one repeats the first one.
+ */
+std::shared_ptr<const Circle> getCircle(uint segments)
+{
+    thread_local std::unordered_map<uint, std::shared_ptr<const Circle>> cache;
 
-    geometry.points = {
-        points,
+    auto& circle = cache[segments];
+    if (circle)
+    {
+        return circle;
+    }
+
+    static std::mutex mutex;
+    static std::unordered_map<uint, std::shared_ptr<const Circle>> circles;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto& sharedCircle = circles[segments];
+    if (!sharedCircle)
+    {
+        auto table = std::make_shared<Circle>(segments + 1);
+
+        for (uint i = 0; i < segments; i++)
         {
-            0, 1, 2, 0, 2, 3, // top
-            5, 4, 7, 5, 7, 6, // bottom
-            5, 1, 0, 5, 0, 4, // left
-            7, 3, 2, 7, 2, 6, // right
-            4, 0, 3, 4, 3, 7, // front
-            1, 6, 6, 1, 6, 2  // back
+            auto angle = 2.0 * M_PI * i / segments;
+            (*table)[i] = {static_cast<float>(std::cos(angle)),
+                           static_cast<float>(std::sin(angle))};
         }
-    };
+        (*table)[segments] = (*table)[0];
+
+        sharedCircle = table;
+    }
+
+    circle = sharedCircle;
+    return circle;
+}
+
+Point3f normalize(float x, float y, float z)
+{
+    auto length = std::sqrt(x * x + y * y + z * z);
 
-    geometry.normals = {
+    return length > 0.0f
+            ? Point3f{x / length, y / length, z / length}
+            : Point3f{0.0f, 0.0f, 1.0f};
+}
+
+/**
+ * @brief Writes indices of the regular grid of (columns + 1) x (rows + 1) vertices
+ */
+uint* writeGridIndices(uint* indices, uint baseVertex, uint columns, uint rows)
+{
+    for (uint row = 0; row < rows; row++)
+    {
+        for (uint column = 0; column < columns; column++)
         {
-            toPoint3(calculateNormal(points[0], points[1], points[2])), // top
-            toPoint3(calculateNormal(points[5], points[4], points[7])), // bottom
-            toPoint3(calculateNormal(points[5], points[1], points[0])), // left
-            toPoint3(calculateNormal(points[7], points[3], points[2])), // right
-            toPoint3(calculateNormal(points[4], points[0], points[3])), // front
-            toPoint3(calculateNormal(points[1], points[6], points[6])), // back
-        },
+            uint a = baseVertex + row * (columns + 1) + column;
+            uint b = a + columns + 1;
+
+            *indices++ = a;
+            *indices++ = a + 1;
+            *indices++ = b + 1;
+            *indices++ = a;
+            *indices++ = b + 1;
+            *indices++ = b;
+        }
+    }
+
+    return indices;
+}
+
+/**
+ * @brief Writes the disk which closes the figure at the height z
+ */
+void writeDisk(const Circle& circle,
+               float radius,
+               float z,
+               bool isUp,
+               uint baseVertex,
+               Vertex* vertices,
+               uint* indices)
+{
+    uint slices = circle.size() - 1;
+    Point3f normal{0.0f, 0.0f, isUp ? 1.0f : -1.0f};
+
+    *vertices++ = {{0.0f, 0.0f, z}, normal, {0.0f, 0.0f, 0.0f}, {0.5f, 0.5f}};
+
+    for (const auto& [cosAngle, sinAngle] : circle)
+    {
+        *vertices++ = {{radius * cosAngle, radius * sinAngle, z},
+                       normal,
+                       {0.0f, 0.0f, 0.0f},
+                       {0.5f + 0.5f * cosAngle, 0.5f + 0.5f * sinAngle}};
+    }
+
+    for (uint slice = 0; slice < slices; slice++)
+    {
+        *indices++ = baseVertex;
+        *indices++ = baseVertex + 1 + (isUp ? slice : slice + 1);
+        *indices++ = baseVertex + 1 + (isUp ? slice + 1 : slice);
+    }
+}
+
+/**
+ * The marching cubes' tables. The cube's corner bits are its x, y and z offsets,
+ * the cube's edge 4 * axis + k goes from the k-th corner which has the axis' bit
+ * cleared along the axis. The corner is inside if its value is not below the iso value.
+ */
+struct CubeCase
+{
+    uint8_t indicesCount;
+    std::array<uint8_t, 30> edges;
+};
+
+/** The faces' corners are counterclockwise when looking from outside of the cube */
+constexpr uint8_t CubeFaces[6][4] = {{0, 4, 6, 2},
+                                     {1, 3, 7, 5},
+                                     {0, 1, 5, 4},
+                                     {2, 6, 7, 3},
+                                     {0, 2, 3, 1},
+                                     {4, 5, 7, 6}};
+
+uint getCubeEdge(uint corner, uint axis)
+{
+    return axis * 4 + (((corner >> (axis + 1)) << axis) | (corner & ((1u << axis) - 1)));
+}
+
+uint getEdgeCorner(uint edge)
+{
+    auto axis = edge / 4;
+    auto k = edge % 4;
+
+    return ((k >> axis) << (axis + 1)) | (k & ((1u << axis) - 1));
+}
+
+/**
+ * @brief Returns the mask of the two cube's faces the edge lies on,
+ * the face's bit is 2 * axis + the face's offset by the axis
+ */
+uint getEdgeFaces(uint edge)
+{
+    auto axis = edge / 4;
+    auto corner = getEdgeCorner(edge);
+    uint faces{0};
+
+    for (uint other = 0; other < 3; other++)
+    {
+        if (other != axis)
         {
-            0, 1, 2, 3, 4, 5, 6, 7
+            faces |= 1u << (2 * other + ((corner >> other) & 1u));
         }
-    };
+    }
+
+    return faces;
+}
+
+/**
+ * @brief Returns the triangles of the 256 cube's cases. The table is built by
+ * tracing the surface's contour over the cube's faces: on every face the contour
+ * goes from the edge where it enters the inside corners to the edge where it leaves
+ * them, so the inside corners of the ambiguous face are always separated. The face's
+ * decision depends on the face only, so the neighbour cubes agree and the surface is
+ * closed. The contours are triangulated as fans, the triangles are counterclockwise
+ * when looking from outside.
+ */
+const std::array<CubeCase, 256>& getCubeCases()
+{
+    static const auto cases = []()
+    {
+        std::array<CubeCase, 256> cases{};
+
+        for (uint config = 0; config < 256; config++)
+        {
+            auto isInside = [config](uint corner) { return (config >> corner) & 1u; };
+
+            std::array<int, 12> next;
+            next.fill(-1);
+
+            for (const auto& face : CubeFaces)
+            {
+                std::array<std::pair<uint, bool>, 4> crossings;
+                uint crossingsCount{0};
+
+                for (uint i = 0; i < 4; i++)
+                {
+                    uint from = face[i];
+                    uint to = face[(i + 1) % 4];
+
+                    if (isInside(from) != isInside(to))
+                    {
+                        auto axis = static_cast<uint>(std::log2(from ^ to));
+                        crossings[crossingsCount++] = {getCubeEdge(std::min(from, to), axis),
+                                                       isInside(to)};
+                    }
+                }
+
+                for (uint i = 0; i < crossingsCount; i++)
+                {
+                    if (crossings[i].second)
+                    {
+                        next[crossings[i].first] = crossings[(i + 1) % crossingsCount].first;
+                    }
+                }
+            }
 
-    geometry.textures = {
+            auto& cubeCase = cases[config];
+
+            for (uint start = 0; start < 12; start++)
+            {
+                std::array<uint8_t, 12> contour;
+                uint length{0};
+
+                for (auto edge = static_cast<int>(start); next[edge] >= 0;)
+                {
+                    contour[length++] = edge;
+                    edge = std::exchange(next[edge], -1);
+                }
+
+                // the fan's diagonals must not lie on the cube's faces, otherwise
+                // the neighbour cube could make the same diagonal
+                uint first{0};
+                for (uint rotation = 0; rotation < length; rotation++)
+                {
+                    auto isValid = true;
+                    for (uint i = 2; i + 1 < length; i++)
+                    {
+                        isValid = isValid &&
+                                (getEdgeFaces(contour[rotation]) &
+                                 getEdgeFaces(contour[(rotation + i) % length])) == 0;
+                    }
+
+                    if (isValid)
+                    {
+                        first = rotation;
+                        break;
+                    }
+                }
+
+                for (uint i = 1; i + 1 < length; i++)
+                {
+                    cubeCase.edges[cubeCase.indicesCount++] = contour[first];
+                    cubeCase.edges[cubeCase.indicesCount++] = contour[(first + i) % length];
+                    cubeCase.edges[cubeCase.indicesCount++] = contour[(first + i + 1) % length];
+                }
+            }
+        }
+
+        return cases;
+    }();
+
+    return cases;
+}
+
+/**
+ * The vertices made by one worker. The vertices inside the brick are welded
+ * by the brick's edge cache, the vertices on the bricks' faces keep the
+ * volume's edge, they are welded when the workers' results are merged.
+ */
+struct IsosurfacePart
+{
+    static constexpr std::uint64_t InnerEdge{std::numeric_limits<std::uint64_t>::max()};
+
+    std::vector<Vertex> vertices;
+    std::vector<uint> indices;
+    std::vector<std::uint64_t> edges;
+    std::vector<uint> cache;
+    std::vector<uint> stamps;
+    uint stamp{0};
+};
+
+class IsosurfaceExtractor
+{
+public:
+    IsosurfaceExtractor(const figures::Volume& volume, float isoValue, uint brickSize) :
+        mVolume(volume),
+        mIsoValue(isoValue),
+        mBrickSize(brickSize),
+        mCenter{(volume.width - 1) / 2.0f,
+                (volume.height - 1) / 2.0f,
+                (volume.depth - 1) / 2.0f}
+    {
+    }
+
+    void extract(const std::array<BrickPyramid::Brick, 2>& cells, IsosurfacePart& part) const
+    {
+        const auto& cases = getCubeCases();
+        auto [first, last] = cells;
+        auto cacheSide = mBrickSize + 1;
+
+        if (part.cache.empty())
         {
-            {0, 0}, {0, 1}, {1, 1}, {1, 0}
-        },
+            part.cache.resize(cacheSide * cacheSide * cacheSide * 3);
+            part.stamps.resize(part.cache.size(), 0);
+        }
+        part.stamp++;
+
+        for (auto z = first[2]; z < last[2]; z++)
         {
-            0, 1, 2, 0, 2, 3, // top
-            0, 1, 2, 0, 2, 3, // bottom
-            0, 1, 2, 0, 2, 3, // left
-            0, 1, 2, 0, 2, 3, // right
-            0, 1, 2, 0, 2, 3, // front
-            0, 1, 2, 0, 2, 3  // back
+            for (auto y = first[1]; y < last[1]; y++)
+            {
+                for (auto x = first[0]; x < last[0]; x++)
+                {
+                    uint config{0};
+                    for (uint corner = 0; corner < 8; corner++)
+                    {
+                        if (getValue(x + (corner & 1), y + ((corner >> 1) & 1), z + (corner >> 2)) >=
+                            mIsoValue)
+                        {
+                            config |= 1u << corner;
+                        }
+                    }
+
+                    const auto& cubeCase = cases[config];
+
+                    for (uint i = 0; i < cubeCase.indicesCount; i++)
+                    {
+                        auto edge = cubeCase.edges[i];
+                        auto corner = getEdgeCorner(edge);
+                        std::array<uint, 3> point{x + (corner & 1),
+                                                  y + ((corner >> 1) & 1),
+                                                  z + (corner >> 2)};
+                        auto axis = edge / 4;
+
+                        auto cacheIndex = (((point[2] - first[2]) * cacheSide +
+                                            point[1] - first[1]) * cacheSide +
+                                           point[0] - first[0]) * 3 + axis;
+
+                        if (part.stamps[cacheIndex] != part.stamp)
+                        {
+                            part.stamps[cacheIndex] = part.stamp;
+                            part.cache[cacheIndex] = static_cast<uint>(part.vertices.size());
+                            addVertex(point, axis, part);
+                        }
+
+                        part.indices.push_back(part.cache[cacheIndex]);
+                    }
+                }
+            }
         }
+    }
+
+private:
+    float getValue(uint x, uint y, uint z) const
+    {
+        return mVolume.values[(static_cast<std::size_t>(z) * mVolume.height + y) *
+                mVolume.width + x];
+    }
+
+    Point3f getGradient(const std::array<uint, 3>& point) const
+    {
+        const std::array<uint, 3> size{mVolume.width, mVolume.height, mVolume.depth};
+        Point3f gradient;
+
+        for (uint axis = 0; axis < 3; axis++)
+        {
+            auto prev = point;
+            auto next = point;
+            prev[axis] = point[axis] > 0 ? point[axis] - 1 : point[axis];
+            next[axis] = point[axis] + 1 < size[axis] ? point[axis] + 1 : point[axis];
+
+            gradient[axis] = (getValue(next[0], next[1], next[2]) -
+                              getValue(prev[0], prev[1], prev[2])) /
+                    std::max(1u, next[axis] - prev[axis]);
+        }
+
+        return gradient;
+    }
+
+    void addVertex(const std::array<uint, 3>& point, uint axis, IsosurfacePart& part) const
+    {
+        auto other = point;
+        other[axis]++;
+
+        auto from = getValue(point[0], point[1], point[2]);
+        auto to = getValue(other[0], other[1], other[2]);
+        auto t = (mIsoValue - from) / (to - from);
+
+        auto fromGradient = getGradient(point);
+        auto toGradient = getGradient(other);
+
+        Vertex vertex{};
+        for (uint i = 0; i < 3; i++)
+        {
+            vertex.position[i] = (point[i] + (i == axis ? t : 0.0f) - mCenter[i]) *
+                    mVolume.cellSize;
+        }
+
+        // the normal points to the lower values, i.e. outside of the surface
+        vertex.normal = normalize(-(fromGradient[0] + t * (toGradient[0] - fromGradient[0])),
+                                  -(fromGradient[1] + t * (toGradient[1] - fromGradient[1])),
+                                  -(fromGradient[2] + t * (toGradient[2] - fromGradient[2])));
+
+        auto isOnBrickFace = false;
+        for (uint i = 0; i < 3; i++)
+        {
+            isOnBrickFace = isOnBrickFace || (i != axis && point[i] % mBrickSize == 0);
+        }
+
+        part.vertices.push_back(vertex);
+        part.edges.push_back(isOnBrickFace
+                             ? ((static_cast<std::uint64_t>(point[2]) * mVolume.height +
+                                 point[1]) * mVolume.width + point[0]) * 3 + axis
+                             : IsosurfacePart::InnerEdge);
+    }
+
+private:
+    const figures::Volume& mVolume;
+    float mIsoValue;
+    uint mBrickSize;
+    Point3f mCenter;
+};
+
+}
+
+Geometry Generator::generate(const figures::Cube& figure,
+                              std::pmr::memory_resource* resource)
+{
+    Geometry geometry(resource);
+
+    auto s = figure.size;
+
+    auto& points = geometry.points.data;
+
+    points = {
+        {-s, -s, -s}, {-s, s, -s}, {s, s, -s}, {s, -s, -s},
+        {-s, -s, s}, {-s, s, s}, {s, s, s}, {s, -s, s}
+    };
+
+    geometry.points.indices = {
+        0, 1, 2, 0, 2, 3, // top
+        5, 4, 7, 5, 7, 6, // bottom
+        5, 1, 0, 5, 0, 4, // left
+        7, 3, 2, 7, 2, 6, // right
+        4, 0, 3, 4, 3, 7, // front
+        1, 6, 6, 1, 6, 2  // back
+    };
+
+    geometry.normals.data = {
+        toPoint3(calculateNormal(points[0], points[1], points[2])), // top
+        toPoint3(calculateNormal(points[5], points[4], points[7])), // bottom
+        toPoint3(calculateNormal(points[5], points[1], points[0])), // left
+        toPoint3(calculateNormal(points[7], points[3], points[2])), // right
+        toPoint3(calculateNormal(points[4], points[0], points[3])), // front
+        toPoint3(calculateNormal(points[1], points[6], points[6])), // back
+    };
+
+    geometry.normals.indices = {
+        0, 1, 2, 3, 4, 5, 6, 7
+    };
+
+    geometry.textures.data = {
+        {0, 0}, {0, 1}, {1, 1}, {1, 0}
+    };
+
+    geometry.textures.indices = {
+        0, 1, 2, 0, 2, 3, // top
+        0, 1, 2, 0, 2, 3, // bottom
+        0, 1, 2, 0, 2, 3, // left
+        0, 1, 2, 0, 2, 3, // right
+        0, 1, 2, 0, 2, 3, // front
+        0, 1, 2, 0, 2, 3  // back
     };
 
     return geometry;
 }
 
-Geometry Generator::generate(const figures::Quad& figure)
+Geometry Generator::generate(const figures::Quad& figure,
+                              std::pmr::memory_resource* resource)
 {
-    Geometry geometry;
+    Geometry geometry(resource);
 
-    geometry.points = {
-        {figure.p1, figure.p2, figure.p3, figure.p4},
-        {0, 1, 2, 0, 2, 3}
+    geometry.points.data = {figure.p1, figure.p2, figure.p3, figure.p4};
+    geometry.points.indices = {0, 1, 2, 0, 2, 3};
+
+    geometry.normals.data = {
+        toPoint3(calculateNormal(figure.p1, figure.p2, figure.p3))
     };
+    geometry.normals.indices = {0, 0, 0, 0, 0, 0};
+
+    geometry.textures.data = {{0, 0}, {0, 1}, {1, 1}, {1, 0}};
+    geometry.textures.indices = {0, 1, 2, 0, 2, 3};
+
+    return geometry;
+}
+
+Generator::Size Generator::getSize(const figures::Sphere& figure)
+{
+    return {(figure.slices + 1) * (figure.stacks + 1),
+            figure.slices * figure.stacks * 6};
+}
+
+Generator::Size Generator::getSize(const figures::Cylinder& figure)
+{
+    return {2 * (figure.slices + 1) + 2 * (figure.slices + 2),
+            figure.slices * 12};
+}
+
+Generator::Size Generator::getSize(const figures::Cone& figure)
+{
+    return {2 * (figure.slices + 1) + figure.slices + 2,
+            figure.slices * 6};
+}
+
+Generator::Size Generator::getSize(const figures::Torus& figure)
+{
+    return {(figure.slices + 1) * (figure.rings + 1),
+            figure.slices * figure.rings * 6};
+}
+
+Generator::Size Generator::getSize(const figures::Grid& figure)
+{
+    return {(figure.columns + 1) * (figure.rows + 1),
+            figure.columns * figure.rows * 6};
+}
+
+Generator::Size Generator::getSize(const figures::Heightfield& figure)
+{
+    if (figure.columns < 2 || figure.rows < 2)
+    {
+        return {0, 0};
+    }
+
+    return {figure.columns * figure.rows,
+            (figure.columns - 1) * (figure.rows - 1) * 6};
+}
+
+void Generator::generate(const figures::Sphere& figure,
+                         Vertex* vertices,
+                         uint* indices)
+{
+    const auto& slices = *getCircle(figure.slices);
+    const auto& stacks = *getCircle(figure.stacks * 2);
+
+    for (uint stack = 0; stack <= figure.stacks; stack++)
+    {
+        // the stack angle goes from -pi/2 to pi/2
+        auto cosPhi = stacks[stack][1];
+        auto sinPhi = -stacks[stack][0];
+
+        for (uint slice = 0; slice <= figure.slices; slice++)
+        {
+            const auto& [cosTheta, sinTheta] = slices[slice];
+            Point3f normal{cosPhi * cosTheta, cosPhi * sinTheta, sinPhi};
+
+            *vertices++ = {{figure.radius * normal[0],
+                            figure.radius * normal[1],
+                            figure.radius * normal[2]},
+                           normal,
+                           {0.0f, 0.0f, 0.0f},
+                           {static_cast<float>(slice) / figure.slices,
+                            static_cast<float>(stack) / figure.stacks}};
+        }
+    }
+
+    writeGridIndices(indices, 0, figure.slices, figure.stacks);
+}
+
+void Generator::generate(const figures::Cylinder& figure,
+                         Vertex* vertices,
+                         uint* indices)
+{
+    const auto& circle = *getCircle(figure.slices);
+    auto halfHeight = figure.height / 2.0f;
+
+    for (uint level = 0; level <= 1; level++)
+    {
+        auto z = level ? halfHeight : -halfHeight;
+
+        for (uint slice = 0; slice <= figure.slices; slice++)
+        {
+            const auto& [cosAngle, sinAngle] = circle[slice];
+
+            *vertices++ = {{figure.radius * cosAngle,
+                            figure.radius * sinAngle,
+                            z},
+                           {cosAngle, sinAngle, 0.0f},
+                           {0.0f, 0.0f, 0.0f},
+                           {static_cast<float>(slice) / figure.slices,
+                            static_cast<float>(level)}};
+        }
+    }
+
+    indices = writeGridIndices(indices, 0, figure.slices, 1);
+
+    uint baseVertex = 2 * (figure.slices + 1);
+    writeDisk(circle, figure.radius, -halfHeight, false,
+              baseVertex, vertices, indices);
+
+    vertices += figure.slices + 2;
+    indices += figure.slices * 3;
+    baseVertex += figure.slices + 2;
+    writeDisk(circle, figure.radius, halfHeight, true,
+              baseVertex, vertices, indices);
+}
+
+void Generator::generate(const figures::Cone& figure,
+                         Vertex* vertices,
+                         uint* indices)
+{
+    const auto& circle = *getCircle(figure.slices);
+    auto halfHeight = figure.height / 2.0f;
+    uint apexVertex = figure.slices + 1;
+
+    // the side's normal is perpendicular to the slant
+    for (uint slice = 0; slice <= figure.slices; slice++)
+    {
+        const auto& [cosAngle, sinAngle] = circle[slice];
+
+        vertices[slice] = {{figure.radius * cosAngle,
+                            figure.radius * sinAngle,
+                            -halfHeight},
+                           normalize(figure.height * cosAngle,
+                                     figure.height * sinAngle,
+                                     figure.radius),
+                           {0.0f, 0.0f, 0.0f},
+                           {static_cast<float>(slice) / figure.slices, 0.0f}};
 
-    geometry.normals = {
-        {toPoint3(calculateNormal(figure.p1, figure.p2, figure.p3))},
-        { 0, 0, 0, 0, 0, 0}
+        vertices[apexVertex + slice] = {{0.0f, 0.0f, halfHeight},
+                                        vertices[slice].normal,
+                                        {0.0f, 0.0f, 0.0f},
+                                        {static_cast<float>(slice) / figure.slices,
+                                         1.0f}};
+    }
+
+    for (uint slice = 0; slice < figure.slices; slice++)
+    {
+        *indices++ = slice;
+        *indices++ = slice + 1;
+        *indices++ = apexVertex + slice;
+    }
+
+    uint baseVertex = 2 * (figure.slices + 1);
+    writeDisk(circle, figure.radius, -halfHeight, false,
+              baseVertex, vertices + baseVertex, indices);
+}
+
+void Generator::generate(const figures::Torus& figure,
+                         Vertex* vertices,
+                         uint* indices)
+{
+    const auto& slices = *getCircle(figure.slices);
+    const auto& rings = *getCircle(figure.rings);
+
+    for (uint ring = 0; ring <= figure.rings; ring++)
+    {
+        const auto& [cosPhi, sinPhi] = rings[ring];
+        auto distance = figure.majorRadius + figure.minorRadius * cosPhi;
+
+        for (uint slice = 0; slice <= figure.slices; slice++)
+        {
+            const auto& [cosTheta, sinTheta] = slices[slice];
+
+            *vertices++ = {{distance * cosTheta,
+                            distance * sinTheta,
+                            figure.minorRadius * sinPhi},
+                           {cosPhi * cosTheta, cosPhi * sinTheta, sinPhi},
+                           {0.0f, 0.0f, 0.0f},
+                           {static_cast<float>(slice) / figure.slices,
+                            static_cast<float>(ring) / figure.rings}};
+        }
+    }
+
+    writeGridIndices(indices, 0, figure.slices, figure.rings);
+}
+
+void Generator::generate(const figures::Grid& figure,
+                         Vertex* vertices,
+                         uint* indices)
+{
+    auto stepX = figure.width / figure.columns;
+    auto stepY = figure.height / figure.rows;
+    auto startX = -figure.width / 2.0f;
+    auto startY = -figure.height / 2.0f;
+
+    for (uint row = 0; row <= figure.rows; row++)
+    {
+        for (uint column = 0; column <= figure.columns; column++)
+        {
+            *vertices++ = {{startX + column * stepX, startY + row * stepY, 0.0f},
+                           {0.0f, 0.0f, 1.0f},
+                           {0.0f, 0.0f, 0.0f},
+                           {static_cast<float>(column) / figure.columns,
+                            static_cast<float>(row) / figure.rows}};
+        }
+    }
+
+    writeGridIndices(indices, 0, figure.columns, figure.rows);
+}
+
+void Generator::generate(const figures::Heightfield& figure,
+                         Vertex* vertices,
+                         uint* indices)
+{
+    if (figure.columns < 2 || figure.rows < 2)
+    {
+        return;
+    }
+
+    auto startX = -figure.cellSize * (figure.columns - 1) / 2.0f;
+    auto startY = -figure.cellSize * (figure.rows - 1) / 2.0f;
+
+    auto height = [&figure](uint column, uint row)
+    {
+        return figure.heights[row * figure.columns + column] * figure.heightScale;
     };
 
-    geometry.textures = {
-        {{0, 0}, {0, 1}, {1, 1}, {1, 0}},
-        {0, 1, 2, 0, 2, 3}
+    auto writeRow = [&](std::size_t index, uint)
+    {
+        auto row = static_cast<uint>(index);
+        auto prevRow = row > 0 ? row - 1 : row;
+        auto nextRow = row + 1 < figure.rows ? row + 1 : row;
+        auto rowVertices = vertices + std::size_t(row) * figure.columns;
+
+        for (uint column = 0; column < figure.columns; column++)
+        {
+            auto prevColumn = column > 0 ? column - 1 : column;
+            auto nextColumn = column + 1 < figure.columns ? column + 1 : column;
+
+            // central differences
+            auto dx = (height(nextColumn, row) - height(prevColumn, row)) /
+                    ((nextColumn - prevColumn) * figure.cellSize);
+            auto dy = (height(column, nextRow) - height(column, prevRow)) /
+                    ((nextRow - prevRow) * figure.cellSize);
+
+            rowVertices[column] = {{startX + column * figure.cellSize,
+                                    startY + row * figure.cellSize,
+                                    height(column, row)},
+                                   normalize(-dx, -dy, 1.0f),
+                                   {0.0f, 0.0f, 0.0f},
+                                   {static_cast<float>(column) / (figure.columns - 1),
+                                    static_cast<float>(row) / (figure.rows - 1)}};
+        }
     };
 
-    return geometry;
+    // the rows of the large heightfields are written by the shared workers
+    if (std::size_t(figure.rows) * figure.columns >= ParallelVerticesCount)
+    {
+        parallelFor(figure.rows, writeRow);
+    }
+    else
+    {
+        for (uint row = 0; row < figure.rows; row++)
+        {
+            writeRow(row, 0);
+        }
+    }
+
+    writeGridIndices(indices, 0, figure.columns - 1, figure.rows - 1);
+}
+
+Mesh Generator::generateMesh(const figures::Volume& volume,
+                             float isoValue,
+                             const BrickPyramid& pyramid,
+                             std::pmr::memory_resource* resource)
+{
+    memory::ArenaScope scope(memory::getTransientArena());
+
+    auto bricks = pyramid.findBricks(isoValue, scope.getResource());
+    std::vector<IsosurfacePart> parts(getWorkersCount());
+    IsosurfaceExtractor extractor(volume, isoValue, pyramid.getBrickSize());
+
+    parallelFor(bricks.size(), [&](std::size_t index, uint worker)
+    {
+        extractor.extract(pyramid.getCells(bricks[index]), parts[worker]);
+    });
+
+    std::size_t verticesCount{0};
+    std::size_t indicesCount{0};
+    std::size_t faceVerticesCount{0};
+
+    for (const auto& part : parts)
+    {
+        verticesCount += part.vertices.size();
+        indicesCount += part.indices.size();
+        faceVerticesCount += std::count_if(part.edges.begin(),
+                                           part.edges.end(),
+                                           [](std::uint64_t edge)
+                                           {
+                                               return edge != IsosurfacePart::InnerEdge;
+                                           });
+    }
+
+    Mesh mesh(resource);
+    mesh.reserve(verticesCount, indicesCount);
+
+    auto& vertices = mesh.getVertices();
+    auto& indices = mesh.getIndices();
+
+    std::pmr::unordered_map<std::uint64_t, uint> faceVertices(scope.getResource());
+    faceVertices.reserve(faceVerticesCount);
+    std::pmr::vector<uint> remap(scope.getResource());
+
+    for (const auto& part : parts)
+    {
+        remap.resize(part.vertices.size());
+
+        for (std::size_t i = 0; i < part.vertices.size(); i++)
+        {
+            if (part.edges[i] != IsosurfacePart::InnerEdge)
+            {
+                auto [vertex, isInserted] = faceVertices.try_emplace(
+                            part.edges[i], static_cast<uint>(vertices.size()));
+
+                if (!isInserted)
+                {
+                    remap[i] = vertex->second;
+                    continue;
+                }
+            }
+
+            remap[i] = static_cast<uint>(vertices.size());
+            vertices.push_back(part.vertices[i]);
+        }
+
+        for (auto index : part.indices)
+        {
+            indices.push_back(remap[index]);
+        }
+    }
+
+    return mesh;
+}
+
+Mesh Generator::generateMesh(const figures::Volume& volume,
+                             float isoValue,
+                             std::pmr::memory_resource* resource)
+{
+    return generateMesh(volume, isoValue, BrickPyramid(volume), resource);
 }
 
 }
@@ -1,25 +1,74 @@
 #include "Geometry.h"
 #include "Utils.h"
 
+#include <stdexcept>
+
 namespace custom_scene
 {
 
+namespace
+{
+
+/** The count of polygons whose normals are calculated by one job */
+constexpr std::size_t NormalsChunkSize{4096};
+
+}
+
+Geometry::Geometry(std::pmr::memory_resource* resource) :
+    points(resource),
+    normals(resource),
+    colors(resource),
+    textures(resource)
+{
+}
+
 void Geometry::calculateNormals()
 {
-    auto poligonsCount = points.indices.size() / 3;
-    for (uint poligon = 0; poligon < poligonsCount; poligon++)
+    std::size_t poligonsCount = points.indices.size() / 3;
+
+    // the indices are checked by the calling thread, so the jobs do not throw
+    for (std::size_t i = 0; i < poligonsCount * 3; i++)
+    {
+        if (points.indices[i] >= points.data.size())
+        {
+            throw std::out_of_range("Geometry::calculateNormals the point's index is out of range");
+        }
+    }
+
+    auto dataOffset = normals.data.size();
+    auto indicesOffset = normals.indices.size();
+    normals.data.resize(dataOffset + poligonsCount);
+    normals.indices.resize(indicesOffset + poligonsCount * 3);
+
+    auto calculateChunk = [&](std::size_t chunk, uint)
     {
-        uint p = poligon * 3;
-        auto& p1 =  points.data.at(points.indices.at(p));
-        auto& p2 =  points.data.at(points.indices.at(p + 1));
-        auto& p3 =  points.data.at(points.indices.at(p + 2));
+        auto end = std::min(poligonsCount, (chunk + 1) * NormalsChunkSize);
+
+        for (auto poligon = chunk * NormalsChunkSize; poligon < end; poligon++)
+        {
+            auto p = poligon * 3;
+            const auto& p1 = points.data[points.indices[p]];
+            const auto& p2 = points.data[points.indices[p + 1]];
+            const auto& p3 = points.data[points.indices[p + 2]];
+
+            const auto& normal = utils::calculateNormal(p1, p2, p3);
+
+            normals.data[dataOffset + poligon] = utils::toPoint3(normal);
+            normals.indices[indicesOffset + p] = static_cast<uint>(poligon);
+            normals.indices[indicesOffset + p + 1] = static_cast<uint>(poligon);
+            normals.indices[indicesOffset + p + 2] = static_cast<uint>(poligon);
+        }
+    };
 
-        const auto& normal = utils::calculateNormal(p1, p2, p3);
+    auto chunksCount = (poligonsCount + NormalsChunkSize - 1) / NormalsChunkSize;
 
-        normals.data.push_back(utils::toPoint3(normal));
-        normals.indices.push_back(poligon);
-        normals.indices.push_back(poligon);
-        normals.indices.push_back(poligon);
+    if (chunksCount > 1)
+    {
+        utils::parallelFor(chunksCount, calculateChunk);
+    }
+    else if (chunksCount == 1)
+    {
+        calculateChunk(0, 0);
     }
 }
 
@@ -33,11 +82,21 @@ Geometry& Geometry::operator+=(const Geometry& rhv)
     return *this;
 }
 
+template<typename T>
+Geometry::Attribute<T>::Attribute(std::pmr::memory_resource* resource) :
+    data(resource),
+    indices(resource)
+{
+}
+
 template<typename T>
 Geometry::Attribute<T>& Geometry::Attribute<T>::operator+=(
         const Geometry::Attribute<T>& rhv)
 {
-    auto indexCount = indices.size();
+    auto indexCount = data.size();
+
+    data.reserve(data.size() + rhv.data.size());
+    indices.reserve(indices.size() + rhv.indices.size());
 
     std::copy(rhv.data.begin(),
               rhv.data.end(),
@@ -52,4 +111,7 @@ Geometry::Attribute<T>& Geometry::Attribute<T>::operator+=(
     return *this;
 }
 
+template struct Geometry::Attribute<Point3f>;
+template struct Geometry::Attribute<Point2f>;
+
 }
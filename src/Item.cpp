@@ -1,80 +1,196 @@
 #include "Item.h"
+#include "ItemStore.h"
 #include "Pipe.h"
 
+#include <algorithm>
+#include <atomic>
+
 namespace custom_scene
 {
 
+namespace
+{
+
+std::uint64_t getNextTransformationVersion()
+{
+    static std::atomic<std::uint64_t> version{0};
+    return ++version;
+}
+
+Item::Bounds getMeshBounds(const Mesh* mesh)
+{
+    if (!mesh || mesh->getVertices().empty())
+    {
+        return {};
+    }
+
+    auto min = mesh->getVertices().front().position;
+    auto max = min;
+
+    for (const auto& vertex : mesh->getVertices())
+    {
+        for (std::size_t i = 0; i < 3; i++)
+        {
+            min[i] = std::min(min[i], vertex.position[i]);
+            max[i] = std::max(max[i], vertex.position[i]);
+        }
+    }
+
+    return {Vec3(min[0], min[1], min[2]), Vec3(max[0], max[1], max[2])};
+}
+
+}
+
 Item::Item(const std::shared_ptr<Mesh> mesh,
            std::shared_ptr<RenderParameters> renderParameters,
            std::shared_ptr<Material> material,
            std::shared_ptr<Texture> texture) :
-    mMesh(mesh),
-    mRenderParameters(renderParameters),
-    mMaterial(material),
-    mTexture(texture)
+    mData(std::make_unique<Data>(Data{{mesh, renderParameters, material, texture},
+                                      Mat4(),
+                                      getNextTransformationVersion(),
+                                      {0, 0, 0},
+                                      getMeshBounds(mesh.get()),
+                                      1,
+                                      true}))
 {
-    mTransformation.isIdentity();
 }
 
 void Item::setMesh(const std::shared_ptr<Mesh> mesh)
 {
-    mMesh = mesh;
+    auto bounds = getMeshBounds(mesh.get());
+
+    if (mStore)
+    {
+        mStore->mResources[getIndex()].mesh = mesh;
+        mStore->mBounds[getIndex()] = bounds;
+    }
+    else
+    {
+        mData->resources.mesh = mesh;
+        mData->bounds = bounds;
+    }
+}
+
+void Item::updateIndices(uint startIndex, uint baseVertex)
+{
+    updateIndices(startIndex, getMesh()->getElementsCount(), baseVertex);
 }
 
-void Item::updateIndices(uint startIndex)
+void Item::updateIndices(uint startIndex, uint elementsCount, uint baseVertex)
 {
-    mElementsStartIndex = startIndex;
-    mElementsCount = mMesh->getElementsCount();
+    auto& range = mStore ? mStore->mDrawRanges[getIndex()] : mData->range;
+    range = {startIndex, elementsCount, baseVertex};
 }
 
 uint Item::getElementsStartIndex() const
 {
-    return mElementsStartIndex;
+    return mStore ? mStore->mDrawRanges[getIndex()].startIndex : mData->range.startIndex;
 }
 
 Material* Item::getMaterial() const
 {
-    return mMaterial.get();
+    return mStore ? mStore->mResources[getIndex()].material.get() : mData->resources.material.get();
 }
 
 Texture* Item::getTexture() const
 {
-    return mTexture.get();
+    return mStore ? mStore->mResources[getIndex()].texture.get() : mData->resources.texture.get();
+}
+
+ItemStore* Item::getStore() const
+{
+    return mStore;
 }
 
 uint Item::getElementsCount() const
 {
-    return mElementsCount;
+    return mStore ? mStore->mDrawRanges[getIndex()].elementsCount : mData->range.elementsCount;
+}
+
+uint Item::getBaseVertex() const
+{
+    return mStore ? mStore->mDrawRanges[getIndex()].baseVertex : mData->range.baseVertex;
 }
 
 Item::RenderParameters* Item::getRenderParameters() const
 {
-    return mRenderParameters.get();
+    return mStore
+            ? mStore->mResources[getIndex()].renderParameters.get()
+            : mData->resources.renderParameters.get();
 }
 
 const Mat4& Item::getTransformation() const
 {
-    return mTransformation;
+    return mStore ? mStore->mTransformations[getIndex()] : mData->transformation;
 }
 
 const std::shared_ptr<Mesh> Item::getMesh() const
 {
-    return mMesh;
+    return mStore ? mStore->mResources[getIndex()].mesh : mData->resources.mesh;
+}
+
+const Item::Bounds& Item::getBounds() const
+{
+    return mStore ? mStore->mBounds[getIndex()] : mData->bounds;
 }
 
 bool Item::isVisible() const
 {
-    return mIsVisible;
+    return mStore ? (mStore->mFlags[getIndex()] & ItemStore::VisibleFlag) != 0 : mData->isVisible;
 }
 
 void Item::setIsVisible(bool isVisible)
 {
-    mIsVisible = isVisible;
+    if (mStore)
+    {
+        mStore->setDrawState(getIndex(), isVisible, mStore->mLayers[getIndex()]);
+    }
+    else
+    {
+        mData->isVisible = isVisible;
+    }
+}
+
+void Item::setLayers(std::uint32_t layers)
+{
+    if (mStore)
+    {
+        mStore->setDrawState(getIndex(), isVisible(), layers);
+    }
+    else
+    {
+        mData->layers = layers;
+    }
+}
+
+std::uint32_t Item::getLayers() const
+{
+    return mStore ? mStore->mLayers[getIndex()] : mData->layers;
 }
 
 void Item::setTransformation(const Mat4& transformation)
 {
-    mTransformation = transformation;
+    if (mStore)
+    {
+        auto index = getIndex();
+        mStore->mTransformations[index] = transformation;
+        mStore->mTransformationVersions[index] = getNextTransformationVersion();
+    }
+    else
+    {
+        mData->transformation = transformation;
+        mData->transformationVersion = getNextTransformationVersion();
+    }
+}
+
+std::uint64_t Item::getTransformationVersion() const
+{
+    return mStore ? mStore->mTransformationVersions[getIndex()] : mData->transformationVersion;
+}
+
+uint Item::getIndex() const
+{
+    return mStore->mIndices[mSlot];
 }
 
 }
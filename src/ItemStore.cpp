@@ -0,0 +1,332 @@
+#include "ItemStore.h"
+#include "Utils.h"
+
+namespace custom_scene
+{
+
+namespace
+{
+
+ItemStore::Handle makeHandle(uint slot, uint generation)
+{
+    return static_cast<ItemStore::Handle>(generation) << 32 | slot;
+}
+
+uint getSlot(ItemStore::Handle handle)
+{
+    return static_cast<uint>(handle & 0xffffffff);
+}
+
+uint getGeneration(ItemStore::Handle handle)
+{
+    return static_cast<uint>(handle >> 32);
+}
+
+template<typename T>
+void moveLast(std::vector<T>& array, std::size_t index)
+{
+    if (index + 1 != array.size())
+    {
+        array[index] = std::move(array.back());
+    }
+    array.pop_back();
+}
+
+}
+
+ItemStore::~ItemStore()
+{
+    clear();
+}
+
+ItemStore::Handle ItemStore::add(std::shared_ptr<Item> item)
+{
+    if (item->mStore == this)
+    {
+        return getHandle(*item);
+    }
+
+    if (item->mStore)
+    {
+        item->mStore->remove(*item);
+    }
+
+    uint slot;
+
+    if (!mFreeSlots.empty())
+    {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint>(mIndices.size());
+        mIndices.push_back(InvalidIndex);
+        mGenerations.push_back(0);
+    }
+
+    auto& data = *item->mData;
+
+    mIndices[slot] = static_cast<uint>(mSlots.size());
+    mSlots.push_back(slot);
+    mTransformations.push_back(data.transformation);
+    mTransformationVersions.push_back(data.transformationVersion);
+    mDrawRanges.push_back(data.range);
+    mBounds.push_back(data.bounds);
+    mStateKeys.push_back(getStateKey(data.resources));
+    mFlags.push_back(data.isVisible ? VisibleFlag : 0);
+    mLayers.push_back(data.layers);
+    mDrawPositions.push_back(InvalidIndex);
+    mResources.push_back(std::move(data.resources));
+
+    if (data.isVisible)
+    {
+        insertDrawable(mIndices[slot]);
+    }
+
+    item->mData.reset();
+    item->mStore = this;
+    item->mSlot = slot;
+    mItems.push_back(std::move(item));
+
+    mAddsCount++;
+
+    return makeHandle(slot, mGenerations[slot]);
+}
+
+void ItemStore::remove(Handle handle)
+{
+    if (!isValid(handle))
+    {
+        return;
+    }
+
+    auto slot = getSlot(handle);
+    auto index = mIndices[slot];
+    auto item = mItems[index];
+
+    item->mData = std::make_unique<Item::Data>(Item::Data{std::move(mResources[index]),
+                                                          mTransformations[index],
+                                                          mTransformationVersions[index],
+                                                          mDrawRanges[index],
+                                                          mBounds[index],
+                                                          mLayers[index],
+                                                          (mFlags[index] & VisibleFlag) != 0});
+    item->mStore = nullptr;
+
+    if (mDrawPositions[index] != InvalidIndex)
+    {
+        eraseDrawable(index);
+    }
+
+    // the last item takes the place of the removed one
+    auto last = static_cast<uint>(mSlots.size() - 1);
+    if (last != index && mDrawPositions[last] != InvalidIndex)
+    {
+        getDrawList(mLayers[last]).indices[mDrawPositions[last]] = index;
+    }
+
+    mIndices[mSlots.back()] = index;
+    moveLast(mSlots, index);
+    moveLast(mTransformations, index);
+    moveLast(mTransformationVersions, index);
+    moveLast(mDrawRanges, index);
+    moveLast(mBounds, index);
+    moveLast(mStateKeys, index);
+    moveLast(mFlags, index);
+    moveLast(mLayers, index);
+    moveLast(mDrawPositions, index);
+    moveLast(mResources, index);
+    moveLast(mItems, index);
+
+    mIndices[slot] = InvalidIndex;
+    mGenerations[slot]++;
+    mFreeSlots.push_back(slot);
+
+    mRemovesCount++;
+}
+
+void ItemStore::remove(const Item& item)
+{
+    if (item.mStore == this)
+    {
+        remove(getHandle(item));
+    }
+}
+
+void ItemStore::clear()
+{
+    while (!mSlots.empty())
+    {
+        auto slot = mSlots.back();
+        remove(makeHandle(slot, mGenerations[slot]));
+    }
+}
+
+bool ItemStore::isValid(Handle handle) const
+{
+    auto slot = getSlot(handle);
+    return slot < mIndices.size() &&
+           mIndices[slot] != InvalidIndex &&
+           mGenerations[slot] == getGeneration(handle);
+}
+
+ItemStore::Handle ItemStore::getHandle(const Item& item) const
+{
+    return item.mStore == this
+            ? makeHandle(item.mSlot, mGenerations[item.mSlot])
+            : InvalidHandle;
+}
+
+uint ItemStore::getIndex(Handle handle) const
+{
+    return isValid(handle) ? mIndices[getSlot(handle)] : InvalidIndex;
+}
+
+std::size_t ItemStore::getSize() const
+{
+    return mSlots.size();
+}
+
+bool ItemStore::isEmpty() const
+{
+    return mSlots.empty();
+}
+
+const ItemStore::Items& ItemStore::getItems() const
+{
+    return mItems;
+}
+
+const std::vector<Mat4>& ItemStore::getTransformations() const
+{
+    return mTransformations;
+}
+
+const std::vector<std::uint64_t>& ItemStore::getTransformationVersions() const
+{
+    return mTransformationVersions;
+}
+
+const std::vector<Item::DrawRange>& ItemStore::getDrawRanges() const
+{
+    return mDrawRanges;
+}
+
+const std::vector<Item::Bounds>& ItemStore::getBounds() const
+{
+    return mBounds;
+}
+
+const std::vector<std::uint64_t>& ItemStore::getStateKeys() const
+{
+    return mStateKeys;
+}
+
+const std::vector<std::uint8_t>& ItemStore::getFlags() const
+{
+    return mFlags;
+}
+
+const std::vector<std::uint32_t>& ItemStore::getLayers() const
+{
+    return mLayers;
+}
+
+const std::vector<Item::Resources>& ItemStore::getResources() const
+{
+    return mResources;
+}
+
+const std::vector<ItemStore::DrawList>& ItemStore::getDrawLists() const
+{
+    return mDrawLists;
+}
+
+ItemStore::Stats ItemStore::getStats() const
+{
+    constexpr std::size_t HotItemSize = sizeof(uint) +
+            sizeof(Mat4) +
+            sizeof(std::uint64_t) +
+            sizeof(Item::DrawRange) +
+            sizeof(Item::Bounds) +
+            sizeof(std::uint64_t) +
+            sizeof(std::uint8_t) +
+            sizeof(std::uint32_t) +
+            sizeof(uint) * 2;
+    constexpr std::size_t ColdItemSize = sizeof(Item::Resources) +
+            sizeof(std::shared_ptr<Item>);
+
+    return {mSlots.size(),
+            mDrawLists.size(),
+            mIndices.size(),
+            mFreeSlots.size(),
+            mSlots.size() * HotItemSize,
+            mSlots.size() * ColdItemSize,
+            mAddsCount,
+            mRemovesCount};
+}
+
+void ItemStore::setDrawState(uint index, bool isVisible, std::uint32_t layers)
+{
+    auto wasVisible = (mFlags[index] & VisibleFlag) != 0;
+
+    if (wasVisible == isVisible && mLayers[index] == layers)
+    {
+        return;
+    }
+
+    if (mDrawPositions[index] != InvalidIndex)
+    {
+        eraseDrawable(index);
+    }
+
+    mFlags[index] = isVisible ? mFlags[index] | VisibleFlag : mFlags[index] & ~VisibleFlag;
+    mLayers[index] = layers;
+
+    if (isVisible)
+    {
+        insertDrawable(index);
+    }
+}
+
+void ItemStore::insertDrawable(uint index)
+{
+    auto& drawList = getDrawList(mLayers[index]);
+    mDrawPositions[index] = static_cast<uint>(drawList.indices.size());
+    drawList.indices.push_back(index);
+}
+
+void ItemStore::eraseDrawable(uint index)
+{
+    auto& indices = getDrawList(mLayers[index]).indices;
+    auto position = mDrawPositions[index];
+
+    indices[position] = indices.back();
+    mDrawPositions[indices.back()] = position;
+    indices.pop_back();
+    mDrawPositions[index] = InvalidIndex;
+}
+
+ItemStore::DrawList& ItemStore::getDrawList(std::uint32_t layers)
+{
+    auto [drawList, isInserted] = mDrawListIndices.try_emplace(layers,
+                                                               static_cast<uint>(mDrawLists.size()));
+    if (isInserted)
+    {
+        mDrawLists.push_back({layers, {}});
+    }
+
+    return mDrawLists[drawList->second];
+}
+
+std::uint64_t ItemStore::getStateKey(const Item::Resources& resources)
+{
+    const void* state[] = {resources.renderParameters.get(),
+                           resources.material.get(),
+                           resources.texture.get()};
+
+    return utils::hash(state, sizeof(state));
+}
+
+}
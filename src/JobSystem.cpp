@@ -0,0 +1,433 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+namespace custom_scene
+{
+
+struct JobSystem::Job
+{
+    Function function;
+    /** The dependencies which are not done yet and the scheduling itself */
+    std::atomic<std::size_t> dependenciesCount{1};
+    std::mutex mutex;
+    std::vector<Handle> continuations;
+    std::atomic<bool> isDone{false};
+};
+
+namespace
+{
+
+/** The worker's number, it is -1 for the threads which are not workers */
+thread_local int tWorker{-1};
+
+std::atomic<bool> isStarted{false};
+
+JobSystem::Parameters& getConfiguration()
+{
+    static JobSystem::Parameters parameters;
+    return parameters;
+}
+
+}
+
+/**
+ * The state of parallelFor which is shared with its workers,
+ * the workers which start after all indices are taken do not call the function.
+ * The state is reused when all its jobs are finished.
+ */
+struct JobSystem::ParallelFor
+{
+    std::atomic<std::size_t> next{0};
+    std::atomic<uint> activeCount{0};
+    /** The scheduled jobs which are not finished */
+    std::atomic<uint> pendingCount{0};
+    std::size_t count{0};
+    const void* function{nullptr};
+    IndexFunction invoke{nullptr};
+
+    void work(uint worker)
+    {
+        activeCount++;
+
+        for (auto index = next++; index < count; index = next++)
+        {
+            invoke(function, index, worker);
+        }
+
+        activeCount--;
+    }
+};
+
+bool JobSystem::configure(const Parameters& parameters)
+{
+    if (isStarted)
+    {
+        return false;
+    }
+
+    getConfiguration() = parameters;
+    return true;
+}
+
+JobSystem& JobSystem::getInstance()
+{
+    static JobSystem instance(getConfiguration());
+    return instance;
+}
+
+JobSystem::JobSystem(const Parameters& parameters)
+{
+    isStarted = true;
+
+    auto hardwareCount = std::max(1u, std::thread::hardware_concurrency());
+    auto workersCount = parameters.workersCount > 0 ? parameters.workersCount : hardwareCount;
+
+    for (uint queue = 0; queue <= workersCount; queue++)
+    {
+        mQueues.push_back(std::make_unique<Queue>());
+    }
+
+    for (uint worker = 0; worker < workersCount; worker++)
+    {
+        mWorkers.emplace_back(&JobSystem::run, this, worker);
+
+#ifdef __linux__
+        if (parameters.isAffinity)
+        {
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            CPU_SET(worker % hardwareCount, &cores);
+            pthread_setaffinity_np(mWorkers.back().native_handle(), sizeof(cpu_set_t), &cores);
+        }
+#endif
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock(mMutex);
+        mIsRunning = false;
+    }
+
+    mCondition.notify_all();
+
+    for (auto& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+JobSystem::Handle JobSystem::schedule(Function function, const std::vector<Handle>& dependencies)
+{
+    auto job = std::make_shared<Job>();
+    job->function = std::move(function);
+    job->dependenciesCount = dependencies.size() + 1;
+
+    mScheduledCount++;
+    mWaitingCount++;
+
+    for (const auto& dependency : dependencies)
+    {
+        if (dependency)
+        {
+            std::unique_lock lock(dependency->mutex);
+
+            if (!dependency->isDone)
+            {
+                dependency->continuations.push_back(job);
+                continue;
+            }
+        }
+
+        release(job);
+    }
+
+    release(job);
+
+    return job;
+}
+
+void JobSystem::wait(const Handle& job)
+{
+    while (!isDone(job))
+    {
+        if (auto other = pop())
+        {
+            execute(other);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobSystem::isDone(const Handle& job)
+{
+    return !job || job->isDone;
+}
+
+void JobSystem::parallelFor(std::size_t count,
+                            const void* function,
+                            IndexFunction invoke,
+                            uint workersCount)
+{
+    if (workersCount == 0)
+    {
+        workersCount = getWorkersCount();
+    }
+    workersCount = static_cast<uint>(std::min<std::size_t>(workersCount, count));
+
+    if (workersCount == 0)
+    {
+        return;
+    }
+
+    mParallelForsCount++;
+
+    auto& state = acquireParallelFor();
+    state.next = 0;
+    state.count = count;
+    state.function = function;
+    state.invoke = invoke;
+    state.pendingCount = workersCount - 1;
+
+    for (uint worker = 1; worker < workersCount; worker++)
+    {
+        // the function keeps the pointer and the number only, so it is not allocated
+        auto job = acquireJob();
+        job->function = [state = &state, worker]()
+        {
+            state->work(worker);
+            state->pendingCount--;
+        };
+
+        mScheduledCount++;
+        push(std::move(job));
+    }
+
+    state.work(0);
+
+    // all indices are taken, only the workers which call the function are waited for
+    while (state.activeCount > 0)
+    {
+        std::this_thread::yield();
+    }
+}
+
+JobSystem::ParallelFor& JobSystem::acquireParallelFor()
+{
+    std::lock_guard lock(mPoolMutex);
+
+    for (auto& state : mParallelFors)
+    {
+        // the state of the finished parallelFor is reserved by the new one under the lock
+        uint pendingCount{0};
+        if (state->activeCount == 0 && state->pendingCount.compare_exchange_strong(pendingCount, 1))
+        {
+            return *state;
+        }
+    }
+
+    mParallelFors.push_back(std::make_unique<ParallelFor>());
+    mParallelFors.back()->pendingCount = 1;
+
+    return *mParallelFors.back();
+}
+
+JobSystem::Handle JobSystem::acquireJob()
+{
+    std::lock_guard lock(mPoolMutex);
+
+    for (const auto& job : mJobs)
+    {
+        if (job.use_count() == 1 && job->isDone)
+        {
+            job->isDone = false;
+            job->dependenciesCount = 0;
+            return job;
+        }
+    }
+
+    mJobs.push_back(std::make_shared<Job>());
+    mJobs.back()->dependenciesCount = 0;
+
+    return mJobs.back();
+}
+
+uint JobSystem::getWorkersCount() const
+{
+    return static_cast<uint>(mWorkers.size());
+}
+
+JobSystem::Stats JobSystem::getStats() const
+{
+    Stats stats;
+    stats.workersCount = getWorkersCount();
+    stats.scheduledCount = mScheduledCount;
+    stats.executedCount = mExecutedCount;
+    stats.stolenCount = mStolenCount;
+    stats.waitingCount = mWaitingCount;
+    stats.queuedCount = mQueuedCount;
+    stats.parallelForsCount = mParallelForsCount;
+
+    return stats;
+}
+
+void JobSystem::run(uint worker)
+{
+    tWorker = static_cast<int>(worker);
+
+    while (true)
+    {
+        if (auto job = pop())
+        {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock lock(mMutex);
+        mCondition.wait(lock, [this]() { return !mIsRunning || mQueuedCount > 0; });
+
+        if (!mIsRunning)
+        {
+            return;
+        }
+    }
+}
+
+void JobSystem::release(const Handle& job)
+{
+    if (--job->dependenciesCount == 0)
+    {
+        mWaitingCount--;
+        push(job);
+    }
+}
+
+void JobSystem::push(Handle job)
+{
+    auto& queue = tWorker >= 0 ? *mQueues[tWorker] : *mQueues.back();
+
+    {
+        std::lock_guard lock(queue.mutex);
+        queue.pushBack(std::move(job));
+    }
+
+    mQueuedCount++;
+
+    // the worker which checks the count under the lock does not miss the notification
+    {
+        std::lock_guard lock(mMutex);
+    }
+    mCondition.notify_one();
+}
+
+JobSystem::Handle JobSystem::pop()
+{
+    if (mQueuedCount == 0)
+    {
+        return nullptr;
+    }
+
+    auto sharedQueue = mQueues.size() - 1;
+    auto own = tWorker >= 0 ? static_cast<std::size_t>(tWorker) : sharedQueue;
+
+    // the own newest job is hot in the cache
+    {
+        auto& queue = *mQueues[own];
+        std::lock_guard lock(queue.mutex);
+
+        if (queue.count > 0)
+        {
+            mQueuedCount--;
+            return queue.popBack();
+        }
+    }
+
+    for (std::size_t i = 1; i < mQueues.size(); i++)
+    {
+        auto victim = (own + i) % mQueues.size();
+        auto& queue = *mQueues[victim];
+        std::lock_guard lock(queue.mutex);
+
+        if (queue.count > 0)
+        {
+            auto job = queue.popFront();
+            mQueuedCount--;
+
+            if (victim != sharedQueue)
+            {
+                mStolenCount++;
+            }
+
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+void JobSystem::execute(const Handle& job)
+{
+    job->function();
+    job->function = nullptr;
+
+    std::vector<Handle> continuations;
+
+    {
+        std::lock_guard lock(job->mutex);
+        job->isDone = true;
+        continuations.swap(job->continuations);
+    }
+
+    mExecutedCount++;
+
+    for (const auto& continuation : continuations)
+    {
+        release(continuation);
+    }
+}
+
+void JobSystem::Queue::pushBack(Handle job)
+{
+    if (count == jobs.size())
+    {
+        // the ring is unrolled to the start of the grown one
+        std::vector<Handle> grown(std::max<std::size_t>(16, jobs.size() * 2));
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            grown[i] = std::move(jobs[(first + i) % jobs.size()]);
+        }
+
+        jobs.swap(grown);
+        first = 0;
+    }
+
+    jobs[(first + count) % jobs.size()] = std::move(job);
+    count++;
+}
+
+JobSystem::Handle JobSystem::Queue::popBack()
+{
+    count--;
+    return std::move(jobs[(first + count) % jobs.size()]);
+}
+
+JobSystem::Handle JobSystem::Queue::popFront()
+{
+    auto job = std::move(jobs[first]);
+    first = (first + 1) % jobs.size();
+    count--;
+
+    return job;
+}
+
+}
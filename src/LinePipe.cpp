@@ -0,0 +1,363 @@
+#include "LinePipe.h"
+#include "Camera.h"
+#include "Program.h"
+#include "Memory.h"
+#include "Utils.h"
+#include "Defaults.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+/** The bits of the segment's style, they must match the line program */
+constexpr std::uint32_t HasPrevious{1};
+constexpr std::uint32_t HasNext{2};
+constexpr uint JoinShift{2};
+constexpr uint CapShift{4};
+
+}
+
+LinePipe::LinePipe(std::shared_ptr<Program> program, float miterLimit) :
+    ScenePipe(program, defaults::attributes::Vertex),
+    mMiterLimit(miterLimit)
+{
+}
+
+LinePipe::~LinePipe()
+{
+    mContextGuard.release();
+}
+
+LinePipe::Handle LinePipe::addPolyline(const Polyline& polyline)
+{
+    auto handle = mNextHandle++;
+    const auto& points = polyline.points;
+    auto pointsCount = points.size();
+
+    if (pointsCount < 2)
+    {
+        mPolylines[handle] = {mSegments.size(), 0};
+        return handle;
+    }
+
+    auto isClosed = polyline.isClosed && pointsCount > 2;
+    auto count = isClosed ? pointsCount : pointsCount - 1;
+    auto style = getStyle(polyline.join, polyline.cap);
+
+    mPolylines[handle] = {mSegments.size(), count};
+    mSegments.reserve(mSegments.size() + count);
+
+    for (std::size_t index = 0; index < count; index++)
+    {
+        auto hasPrevious = isClosed || index > 0;
+        auto hasNext = isClosed || index + 1 < count;
+
+        const auto& previous = points[(index + pointsCount - 1) % pointsCount];
+        const auto& start = points[index];
+        const auto& end = points[(index + 1) % pointsCount];
+        const auto& next = points[(index + 2) % pointsCount];
+
+        auto width = polyline.widths.empty()
+                ? 1.0f
+                : polyline.widths[std::min(index, polyline.widths.size() - 1)];
+        auto color = polyline.colors.empty()
+                ? Color(Qt::white)
+                : polyline.colors[std::min(index, polyline.colors.size() - 1)];
+
+        mSegments.push_back({utils::toPoint3(hasPrevious ? previous : start),
+                             utils::toPoint3(start),
+                             utils::toPoint3(end),
+                             utils::toPoint3(hasNext ? next : end),
+                             width,
+                             utils::toRGBA8(color),
+                             style |
+                             (hasPrevious ? HasPrevious : 0) |
+                             (hasNext ? HasNext : 0)});
+    }
+
+    mIsUploaded = false;
+
+    return handle;
+}
+
+LinePipe::Handle LinePipe::addPolyline(std::shared_ptr<const MultiresolutionPolyline> polyline,
+                                       float width,
+                                       const Color& color,
+                                       Join join,
+                                       Cap cap)
+{
+    auto handle = mNextHandle++;
+    mSimplifiedPolylines[handle] = {polyline, width, utils::toRGBA8(color), getStyle(join, cap)};
+
+    return handle;
+}
+
+void LinePipe::removePolyline(Handle handle)
+{
+    mSimplifiedPolylines.erase(handle);
+
+    auto polyline = mPolylines.find(handle);
+
+    if (polyline == mPolylines.end())
+    {
+        return;
+    }
+
+    auto [first, count] = polyline->second;
+    mSegments.erase(mSegments.begin() + first, mSegments.begin() + first + count);
+    mPolylines.erase(polyline);
+
+    for (auto& [otherHandle, span] : mPolylines)
+    {
+        if (span.first > first)
+        {
+            span.first -= count;
+        }
+    }
+
+    mIsUploaded = false;
+}
+
+void LinePipe::clearPolylines()
+{
+    mSegments.clear();
+    mPolylines.clear();
+    mSimplifiedPolylines.clear();
+    mIsUploaded = false;
+}
+
+void LinePipe::render(std::shared_ptr<Camera> camera,
+                      const Lights&,
+                      const Textures&)
+{
+    if (!mIsInitialized)
+    {
+        return;
+    }
+
+    if (!mIsUploaded)
+    {
+        upload();
+        mIsUploaded = true;
+    }
+
+    uploadSimplified(*camera);
+
+    if (mSegments.empty() && mSimplifiedSegmentsCount == 0)
+    {
+        return;
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    bind();
+    mProgram->setView(camera->getPosition(),
+                      camera->getProjection(),
+                      camera->getView());
+    mProgram->setTransformation(Mat4());
+    mProgram->setAlfa(1.0f);
+    mProgram->setUniformValue("viewportSize", Vec2(viewport[2], viewport[3]));
+    mProgram->setUniformValue("miterLimit", mMiterLimit);
+
+    // the quads' winding depends on the segments' directions
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+
+    for (auto [vertexArray, count] : {std::make_pair(mVertexArray, mSegments.size()),
+                                      std::make_pair(mSimplifiedVertexArray,
+                                                     mSimplifiedSegmentsCount)})
+    {
+        if (count > 0)
+        {
+            glBindVertexArray(vertexArray);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+        }
+    }
+    glBindVertexArray(0);
+
+    release();
+}
+
+void LinePipe::setPixelTolerance(float tolerance)
+{
+    mPixelTolerance = tolerance;
+}
+
+std::size_t LinePipe::getSegmentsCount() const
+{
+    return mSegments.size() + mSimplifiedSegmentsCount;
+}
+
+std::uint32_t LinePipe::getStyle(Join join, Cap cap)
+{
+    return (static_cast<std::uint32_t>(join) << JoinShift) |
+           (static_cast<std::uint32_t>(cap) << CapShift);
+}
+
+void LinePipe::createVertexArray(GLuint& vertexArray, GLuint& buffer)
+{
+    mContextGuard.attach([this]() { return takeArrays(); });
+
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &buffer);
+
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    GLuint location{0};
+    for (auto offset : {offsetof(Segment, previous),
+                        offsetof(Segment, start),
+                        offsetof(Segment, end),
+                        offsetof(Segment, next)})
+    {
+        glVertexAttribPointer(location,
+                              3,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              sizeof(Segment),
+                              reinterpret_cast<void*>(offset));
+        location++;
+    }
+
+    glVertexAttribPointer(4,
+                          1,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(Segment),
+                          reinterpret_cast<void*>(offsetof(Segment, width)));
+    glVertexAttribPointer(5,
+                          4,
+                          GL_UNSIGNED_BYTE,
+                          GL_TRUE,
+                          sizeof(Segment),
+                          reinterpret_cast<void*>(offsetof(Segment, color)));
+    glVertexAttribIPointer(6,
+                           1,
+                           GL_UNSIGNED_INT,
+                           sizeof(Segment),
+                           reinterpret_cast<void*>(offsetof(Segment, style)));
+
+    for (GLuint attribute = 0; attribute < 7; attribute++)
+    {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+ContextGuard::Release LinePipe::takeArrays()
+{
+    std::vector<GLuint> vertexArrays;
+    std::vector<GLuint> buffers;
+
+    for (auto [vertexArray, buffer] : {std::make_pair(&mVertexArray, &mBuffer),
+                                       std::make_pair(&mSimplifiedVertexArray, &mSimplifiedBuffer)})
+    {
+        if (*vertexArray != 0)
+        {
+            vertexArrays.push_back(*vertexArray);
+            buffers.push_back(*buffer);
+        }
+
+        *vertexArray = 0;
+        *buffer = 0;
+    }
+
+    mBufferCapacity = 0;
+    mSimplifiedCapacity = 0;
+    mSimplifiedSegmentsCount = 0;
+    mIsUploaded = false;
+
+    return [vertexArrays, buffers](QOpenGLExtraFunctions& functions)
+    {
+        functions.glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+        functions.glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+    };
+}
+
+void LinePipe::upload()
+{
+    if (mVertexArray == 0)
+    {
+        createVertexArray(mVertexArray, mBuffer);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+
+    // the storage grows by doubling, so adding polylines one by one is not quadratic
+    auto size = mSegments.size() * sizeof(Segment);
+
+    if (size > mBufferCapacity)
+    {
+        mBufferCapacity = std::max(size, 2 * mBufferCapacity);
+        glBufferData(GL_ARRAY_BUFFER, mBufferCapacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    if (size > 0)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, mSegments.data());
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void LinePipe::uploadSimplified(const Camera& camera)
+{
+    mSimplifiedSegmentsCount = 0;
+
+    if (mSimplifiedPolylines.empty())
+    {
+        return;
+    }
+
+    auto resource = memory::getFrameArena().getResource();
+    std::pmr::vector<Segment> segments(resource);
+
+    for (const auto& [handle, simplified] : mSimplifiedPolylines)
+    {
+        auto points = simplified.polyline->select(camera, mPixelTolerance, resource);
+
+        for (std::size_t index = 0; index + 1 < points.size(); index++)
+        {
+            auto hasPrevious = index > 0;
+            auto hasNext = index + 2 < points.size();
+
+            segments.push_back({points[hasPrevious ? index - 1 : index],
+                                points[index],
+                                points[index + 1],
+                                points[hasNext ? index + 2 : index + 1],
+                                simplified.width,
+                                simplified.color,
+                                simplified.style |
+                                (hasPrevious ? HasPrevious : 0) |
+                                (hasNext ? HasNext : 0)});
+        }
+    }
+
+    if (mSimplifiedVertexArray == 0)
+    {
+        createVertexArray(mSimplifiedVertexArray, mSimplifiedBuffer);
+    }
+
+    // the storage is orphaned every frame, so the previous frame is not waited for
+    auto size = segments.size() * sizeof(Segment);
+    mSimplifiedCapacity = std::max(size, mSimplifiedCapacity);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mSimplifiedBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mSimplifiedCapacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, segments.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    mSimplifiedSegmentsCount = segments.size();
+}
+
+}
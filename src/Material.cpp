@@ -0,0 +1,63 @@
+#include "Material.h"
+
+namespace custom_scene
+{
+
+namespace
+{
+
+void bindMap(const std::shared_ptr<Texture>& texture, GLint unit)
+{
+    if (texture)
+    {
+        texture->bind(static_cast<uint>(unit));
+    }
+}
+
+}
+
+Material::Material(Type type) :
+    type(type)
+{
+}
+
+void Material::bindMaps() const
+{
+    switch (type)
+    {
+        case Type::kTextured:
+        {
+            const auto& textured = static_cast<const TexturedMaterial&>(*this);
+            bindMap(textured.diffuse, DiffuseUnit);
+            bindMap(textured.specular, SpecularUnit);
+            break;
+        }
+        case Type::kBumped:
+        {
+            const auto& bumped = static_cast<const BumpedMaterial&>(*this);
+            bindMap(bumped.diffuse, DiffuseUnit);
+            bindMap(bumped.normal, NormalUnit);
+            bindMap(bumped.displacement, DisplacementUnit);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+StandartMaterial::StandartMaterial() :
+    Material(Type::kStandart)
+{
+}
+
+TexturedMaterial::TexturedMaterial() :
+    Material(Type::kTextured)
+{
+}
+
+BumpedMaterial::BumpedMaterial() :
+    Material(Type::kBumped)
+{
+}
+
+}
@@ -0,0 +1,331 @@
+#include "MaterialTable.h"
+#include "Material.h"
+#include "Program.h"
+#include "TextureManager.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+/**
+ * The ambient color and shininess, the diffuse color and type, the specular color and maps,
+ * then the locations of the diffuse, specular, normal and displacement maps in the texture
+ * manager's arrays: the rectangle, then the layer, array and maximal level
+ */
+constexpr std::size_t TexelsPerMaterial{11};
+constexpr std::size_t FirstMapTexel{3};
+constexpr std::size_t FloatsPerMaterial{TexelsPerMaterial * 4};
+constexpr std::size_t MaterialSize{FloatsPerMaterial * sizeof(float)};
+
+constexpr uint MinCapacity{64};
+
+void packColors(float* record, const Vec3& ambient, const Vec3& diffuse, const Vec3& specular)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        record[i] = ambient[i];
+        record[4 + i] = diffuse[i];
+        record[8 + i] = specular[i];
+    }
+}
+
+enum MapSlot
+{
+    kDiffuseSlot,
+    kSpecularSlot,
+    kNormalSlot,
+    kDisplacementSlot
+};
+
+/** @return True if the map is packed by the manager or there is no map */
+bool packMap(float* record,
+             MapSlot slot,
+             const std::shared_ptr<Texture>& texture,
+             TextureManager* manager)
+{
+    auto location = texture && manager ? manager->add(texture) : TextureManager::Location();
+    auto data = record + (FirstMapTexel + 2 * slot) * 4;
+
+    data[0] = location.rect.x();
+    data[1] = location.rect.y();
+    data[2] = location.rect.z();
+    data[3] = location.rect.w();
+    data[4] = static_cast<float>(location.layer);
+    data[5] = static_cast<float>(location.array);
+    data[6] = location.maxLod;
+    data[7] = 0.0f;
+
+    return !texture || location.isValid();
+}
+
+/**
+ * The maps' colors are multiplied by the white colors of the entry
+ * @return True if the material's maps are bound, that is some of them is not packed
+ */
+bool pack(const Material& material, float* record, TextureManager* manager)
+{
+    const Vec3 white(1.0f, 1.0f, 1.0f);
+    uint maps{0};
+    bool isPacked{true};
+
+    std::fill_n(record + FirstMapTexel * 4, (TexelsPerMaterial - FirstMapTexel) * 4, 0.0f);
+
+    switch (material.type)
+    {
+        case Material::Type::kStandart:
+        {
+            const auto& standart = static_cast<const StandartMaterial&>(material);
+            packColors(record, standart.ambient, standart.diffuse, standart.specular);
+            break;
+        }
+        case Material::Type::kTextured:
+        {
+            const auto& textured = static_cast<const TexturedMaterial&>(material);
+            packColors(record, white, white, white);
+            maps |= textured.diffuse ? MaterialTable::DiffuseMap : 0;
+            maps |= textured.specular ? MaterialTable::SpecularMap : 0;
+            isPacked &= packMap(record, kDiffuseSlot, textured.diffuse, manager);
+            isPacked &= packMap(record, kSpecularSlot, textured.specular, manager);
+            break;
+        }
+        case Material::Type::kBumped:
+        {
+            const auto& bumped = static_cast<const BumpedMaterial&>(material);
+            packColors(record, white, white, white);
+            maps |= bumped.diffuse ? MaterialTable::DiffuseMap : 0;
+            maps |= bumped.normal ? MaterialTable::NormalMap : 0;
+            maps |= bumped.displacement ? MaterialTable::DisplacementMap : 0;
+            isPacked &= packMap(record, kDiffuseSlot, bumped.diffuse, manager);
+            isPacked &= packMap(record, kNormalSlot, bumped.normal, manager);
+            isPacked &= packMap(record, kDisplacementSlot, bumped.displacement, manager);
+            break;
+        }
+    }
+
+    record[3] = material.shininess;
+    record[7] = static_cast<float>(material.type);
+    record[11] = static_cast<float>(maps);
+
+    return !isPacked;
+}
+
+}
+
+MaterialTable::~MaterialTable()
+{
+    mContextGuard.release();
+}
+
+uint MaterialTable::add(const std::shared_ptr<Material>& material)
+{
+    return insert(material, true);
+}
+
+uint MaterialTable::insert(const std::shared_ptr<Material>& material, bool isPacking)
+{
+    initialize();
+
+    auto [position, isInserted] = mIndices.try_emplace(material.get(), InvalidIndex);
+    auto& index = position->second;
+
+    // the released material's address is taken by the new one before the update
+    if (!isInserted && !mMaterials[index].expired())
+    {
+        return index;
+    }
+
+    if (isInserted)
+    {
+        if (!mFreeIndices.empty())
+        {
+            index = mFreeIndices.back();
+            mFreeIndices.pop_back();
+        }
+        else
+        {
+            index = static_cast<uint>(mMaterials.size());
+            mMaterials.emplace_back();
+            mKeys.push_back(nullptr);
+            mIsBinding.push_back(false);
+            reserve(mMaterials.size());
+        }
+    }
+
+    mMaterials[index] = material;
+    mKeys[index] = material.get();
+    write(index, *material, isPacking);
+
+    return index;
+}
+
+void MaterialTable::update()
+{
+    initialize();
+
+    mWrittenCount = 0;
+
+    for (uint index = 0; index < mMaterials.size(); index++)
+    {
+        if (!mKeys[index])
+        {
+            continue;
+        }
+
+        if (auto material = mMaterials[index].lock())
+        {
+            write(index, *material, true);
+            continue;
+        }
+
+        mIndices.erase(mKeys[index]);
+        mKeys[index] = nullptr;
+        mFreeIndices.push_back(index);
+    }
+}
+
+void MaterialTable::bind(Program& program)
+{
+    initialize();
+
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    program.setUniformValue("materials", TextureUnit);
+    program.setUniformValue("diffuseMap", Material::DiffuseUnit);
+    program.setUniformValue("specularMap", Material::SpecularUnit);
+    program.setUniformValue("normalMap", Material::NormalUnit);
+    program.setUniformValue("displacementMap", Material::DisplacementUnit);
+
+    if (mTextureManager)
+    {
+        mTextureManager->bind(program);
+    }
+}
+
+void MaterialTable::setMaterial(const std::shared_ptr<Material>& material)
+{
+    // the packing could grow the bound arrays, so the draws do not pack the maps
+    auto index = getIndex(material.get());
+
+    if (index == InvalidIndex || mMaterials[index].expired())
+    {
+        index = insert(material, false);
+    }
+
+    glVertexAttribI4ui(IndexLocation, index, 0, 0, 0);
+
+    // the packed maps are read from the manager's arrays
+    if (mIsBinding[index])
+    {
+        material->bindMaps();
+    }
+}
+
+void MaterialTable::setTextureManager(std::shared_ptr<TextureManager> manager)
+{
+    mTextureManager = std::move(manager);
+}
+
+std::shared_ptr<TextureManager> MaterialTable::getTextureManager() const
+{
+    return mTextureManager;
+}
+
+uint MaterialTable::getIndex(const Material* material) const
+{
+    auto index = mIndices.find(material);
+    return index != mIndices.end() ? index->second : InvalidIndex;
+}
+
+std::size_t MaterialTable::getSize() const
+{
+    return mIndices.size();
+}
+
+std::size_t MaterialTable::getWrittenCount() const
+{
+    return mWrittenCount;
+}
+
+void MaterialTable::initialize()
+{
+    if (mIsInitialized)
+    {
+        return;
+    }
+
+    initializeOpenGLFunctions();
+    glGenBuffers(1, &mBuffer);
+    glGenTextures(1, &mTexture);
+    mIsInitialized = true;
+
+    mContextGuard.attach([this]() { return take(); });
+
+    // the table of the destroyed context is allocated again
+    reserve(mMaterials.size());
+}
+
+void MaterialTable::reserve(std::size_t materialsCount)
+{
+    if (materialsCount <= mCapacity)
+    {
+        return;
+    }
+
+    mCapacity = std::max({static_cast<uint>(materialsCount), 2 * mCapacity, MinCapacity});
+    mRecords.resize(mCapacity * FloatsPerMaterial, 0.0f);
+
+    // the draws which are issued already read the previous storage
+    glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, mCapacity * MaterialSize, mRecords.data(), GL_DYNAMIC_DRAW);
+
+    glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void MaterialTable::write(uint index, const Material& material, bool isPacking)
+{
+    float record[FloatsPerMaterial];
+    mIsBinding[index] = pack(material, record, isPacking ? mTextureManager.get() : nullptr);
+
+    auto copy = mRecords.data() + index * FloatsPerMaterial;
+
+    if (std::memcmp(copy, record, MaterialSize) == 0)
+    {
+        return;
+    }
+
+    std::memcpy(copy, record, MaterialSize);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, index * MaterialSize, MaterialSize, record);
+
+    mWrittenCount++;
+}
+
+ContextGuard::Release MaterialTable::take()
+{
+    auto buffer = mBuffer;
+    auto texture = mTexture;
+
+    mBuffer = 0;
+    mTexture = 0;
+    mCapacity = 0;
+    mRecords.clear();
+    mIsInitialized = false;
+
+    return [buffer, texture](QOpenGLExtraFunctions& functions)
+    {
+        functions.glDeleteTextures(1, &texture);
+        functions.glDeleteBuffers(1, &buffer);
+    };
+}
+
+}
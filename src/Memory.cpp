@@ -0,0 +1,211 @@
+#include "Memory.h"
+
+#ifdef SHOW_DEBUG
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace
+{
+
+/** The count of the calling thread's operator new calls */
+thread_local std::size_t tNewCount{0};
+
+}
+
+#ifdef SHOW_DEBUG
+
+// the replaced operators count the allocations, the array and nothrow forms call them
+void* operator new(std::size_t size)
+{
+    tNewCount++;
+
+    if (auto pointer = std::malloc(size > 0 ? size : 1))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+#endif
+
+namespace custom_scene
+{
+
+namespace memory
+{
+
+CountingResource::CountingResource(std::pmr::memory_resource* upstream) :
+    mUpstream(upstream)
+{
+}
+
+CountingResource::Statistics CountingResource::getStatistics() const
+{
+    return {mAllocations.load(std::memory_order_relaxed),
+            mDeallocations.load(std::memory_order_relaxed),
+            mBytesAllocated.load(std::memory_order_relaxed),
+            mBytesInUse.load(std::memory_order_relaxed)};
+}
+
+void CountingResource::resetStatistics()
+{
+    mAllocations = 0;
+    mDeallocations = 0;
+    mBytesAllocated = 0;
+}
+
+void* CountingResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    auto pointer = mUpstream->allocate(bytes, alignment);
+
+    mAllocations.fetch_add(1, std::memory_order_relaxed);
+    mBytesAllocated.fetch_add(bytes, std::memory_order_relaxed);
+    mBytesInUse.fetch_add(bytes, std::memory_order_relaxed);
+
+    return pointer;
+}
+
+void CountingResource::do_deallocate(void* pointer,
+                                     std::size_t bytes,
+                                     std::size_t alignment)
+{
+    mUpstream->deallocate(pointer, bytes, alignment);
+
+    mDeallocations.fetch_add(1, std::memory_order_relaxed);
+    mBytesInUse.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool CountingResource::do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+Arena::Arena(std::size_t initialSize, std::pmr::memory_resource* upstream) :
+    mUpstream(upstream ? upstream : getHeapResource()),
+    mSpill(mUpstream),
+    mCapacity(initialSize)
+{
+    mBuffer = mUpstream->allocate(mCapacity, alignof(std::max_align_t));
+    mResource.emplace(mBuffer, mCapacity, &mSpill);
+}
+
+Arena::~Arena()
+{
+    mResource.reset();
+    mUpstream->deallocate(mBuffer, mCapacity, alignof(std::max_align_t));
+}
+
+void Arena::reset()
+{
+    auto spilledBytes = mSpill.getStatistics().bytesAllocated;
+
+    mResource.reset();
+
+    if (spilledBytes > 0)
+    {
+        mUpstream->deallocate(mBuffer, mCapacity, alignof(std::max_align_t));
+        mCapacity += spilledBytes;
+        mBuffer = mUpstream->allocate(mCapacity, alignof(std::max_align_t));
+    }
+
+    mSpill.resetStatistics();
+    mResource.emplace(mBuffer, mCapacity, &mSpill);
+}
+
+std::pmr::memory_resource* Arena::getResource()
+{
+    return &mResource.value();
+}
+
+std::size_t Arena::getCapacity() const
+{
+    return mCapacity;
+}
+
+std::size_t Arena::getHeapAllocationsCount() const
+{
+    return mSpill.getStatistics().allocations;
+}
+
+ArenaScope::ArenaScope(Arena& arena) :
+    mArena(arena)
+{
+    mArena.mScopeDepth++;
+}
+
+ArenaScope::~ArenaScope()
+{
+    if (--mArena.mScopeDepth == 0)
+    {
+        mArena.reset();
+    }
+}
+
+std::pmr::memory_resource* ArenaScope::getResource()
+{
+    return mArena.getResource();
+}
+
+void HeapCheck::begin()
+{
+    mStart = getNewCount();
+}
+
+bool HeapCheck::end(std::uint64_t version)
+{
+    mCount = getNewCount() - mStart;
+
+    // the frames which change the scene rebuild their structures, so the warm up starts again
+    if (version != mVersion)
+    {
+        mVersion = version;
+        mFramesCount = 0;
+        return true;
+    }
+
+    return ++mFramesCount <= WarmUpFramesCount || mCount == 0;
+}
+
+std::size_t HeapCheck::getCount() const
+{
+    return mCount;
+}
+
+std::size_t getNewCount()
+{
+    return tNewCount;
+}
+
+CountingResource* getHeapResource()
+{
+    static CountingResource resource;
+    return &resource;
+}
+
+Arena& getTransientArena()
+{
+    thread_local Arena arena;
+    return arena;
+}
+
+Arena& getFrameArena()
+{
+    thread_local Arena arena;
+    return arena;
+}
+
+}
+}
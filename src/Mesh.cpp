@@ -1,57 +1,148 @@
 #include "Mesh.h"
 #include "Utils.h"
 
+#include <cstring>
+#include <stdexcept>
+
 namespace custom_scene
 {
 
-Mesh::Mesh()
+namespace
+{
+
+/** The count of vertices which are expanded by one job */
+constexpr std::size_t ExpandChunkSize{4096};
+
+/** Throws if the attribute has less than count indices or any index is out of its data */
+template<typename T>
+void checkIndices(const Geometry::Attribute<T>& attribute, std::size_t count)
 {
+    if (attribute.indices.size() < count)
+    {
+        throw std::out_of_range("Mesh::expand the attribute has less indices than the points");
+    }
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        if (attribute.indices[i] >= attribute.data.size())
+        {
+            throw std::out_of_range("Mesh::expand the attribute's index is out of range");
+        }
+    }
 }
 
-Mesh::Mesh(const Geometry& geometry, std::function<void (Vertex&)> processor)
+}
+
+Mesh::Mesh(std::pmr::memory_resource* resource) :
+    mVertices(resource),
+    mIndices(resource)
 {
-    auto isNormalsPresent = geometry.normals.data.empty();
-    auto isColorsPresent = geometry.colors.data.empty();
-    auto isTexturesPresent = geometry.textures.data.empty();
+}
 
-    auto pointsIndexPtr = geometry.points.indices.begin();
-    auto normalsIndexPtr = geometry.normals.indices.begin();
-    auto colorsIndexPtr = geometry.colors.indices.begin();
-    auto texturesIndexPtr = geometry.textures.indices.begin();
+Mesh::Mesh(const Geometry& geometry,
+           std::function<void (Vertex&)> processor,
+           std::pmr::memory_resource* resource) :
+    mVertices(resource),
+    mIndices(resource)
+{
+    mVertices.resize(geometry.points.indices.size());
+    mIndices.resize(geometry.points.indices.size());
 
-    while (pointsIndexPtr != geometry.points.indices.end())
-    {
-        Vertex vertex;
+    expand(geometry, processor, mVertices.data(), mIndices.data());
+}
+
+Mesh::Mesh(std::size_t verticesCount,
+           std::size_t indicesCount,
+           std::pmr::memory_resource* resource) :
+    mVertices(verticesCount, resource),
+    mIndices(indicesCount, resource)
+{
+}
+
+void Mesh::expand(const Geometry& geometry,
+                  const std::function<void(Vertex&)>& processor,
+                  Vertex* vertices,
+                  uint* indices)
+{
+    auto count = geometry.points.indices.size();
 
-        vertex.position = geometry.points.data.at(*pointsIndexPtr++);
+    auto isNormalsPresent = !geometry.normals.data.empty();
+    auto isColorsPresent = !geometry.colors.data.empty();
+    auto isTexturesPresent = !geometry.textures.data.empty();
 
-        vertex.normal =  isNormalsPresent
-                ? Point3f{0, 0, 0}
-                : geometry.normals.data.at(*normalsIndexPtr++);
-        vertex.color = isColorsPresent
-                ? Point3f{0, 0, 0}
-                : geometry.colors.data.at(*colorsIndexPtr++);
-        vertex.texture = isTexturesPresent
-                ? Point2f{0,0}
-                : geometry.textures.data.at(*texturesIndexPtr++);
+    // the indices are checked by the calling thread, so the jobs do not throw
+    checkIndices(geometry.points, count);
+    if (isNormalsPresent)
+    {
+        checkIndices(geometry.normals, count);
+    }
+    if (isColorsPresent)
+    {
+        checkIndices(geometry.colors, count);
+    }
+    if (isTexturesPresent)
+    {
+        checkIndices(geometry.textures, count);
+    }
 
-        if (processor)
+    auto expandChunk = [&](std::size_t chunk, uint)
+    {
+        auto end = std::min(count, (chunk + 1) * ExpandChunkSize);
+
+        for (auto index = chunk * ExpandChunkSize; index < end; index++)
         {
-            processor(vertex);
+            Vertex vertex;
+
+            vertex.position = geometry.points.data[geometry.points.indices[index]];
+
+            vertex.normal = isNormalsPresent
+                    ? geometry.normals.data[geometry.normals.indices[index]]
+                    : Point3f{0, 0, 0};
+            vertex.color = isColorsPresent
+                    ? geometry.colors.data[geometry.colors.indices[index]]
+                    : Point3f{0, 0, 0};
+            vertex.texture = isTexturesPresent
+                    ? geometry.textures.data[geometry.textures.indices[index]]
+                    : Point2f{0, 0};
+
+            if (processor)
+            {
+                processor(vertex);
+            }
+
+            vertices[index] = vertex;
+            indices[index] = static_cast<uint>(index);
         }
+    };
+
+    auto chunksCount = (count + ExpandChunkSize - 1) / ExpandChunkSize;
 
-        mVertices.push_back(vertex);
+    if (chunksCount > 1)
+    {
+        utils::parallelFor(chunksCount, expandChunk);
     }
+    else if (chunksCount == 1)
+    {
+        expandChunk(0, 0);
+    }
+}
+
+const std::pmr::vector<Vertex>& Mesh::getVertices() const
+{
+    return mVertices;
+}
 
-    mIndices = geometry.points.indices;
+const std::pmr::vector<uint>& Mesh::getIndices() const
+{
+    return mIndices;
 }
 
-const std::vector<Vertex>& Mesh::getVertices() const
+std::pmr::vector<Vertex>& Mesh::getVertices()
 {
     return mVertices;
 }
 
-const std::vector<uint>& Mesh::getIndices() const
+std::pmr::vector<uint>& Mesh::getIndices()
 {
     return mIndices;
 }
@@ -61,9 +152,30 @@ uint Mesh::getElementsCount() const
     return mIndices.empty() ? mVertices.size() : mIndices.size();
 }
 
+std::size_t Mesh::getSize() const
+{
+    return mVertices.size() * sizeof(Vertex) + mIndices.size() * sizeof(uint);
+}
+
+std::uint64_t Mesh::getHash() const
+{
+    auto indicesHash = utils::hash(mIndices.data(),
+                                   mIndices.size() * sizeof(uint));
+
+    return utils::hash(mVertices.data(),
+                       mVertices.size() * sizeof(Vertex),
+                       indicesHash);
+}
+
+void Mesh::reserve(std::size_t verticesCount, std::size_t indicesCount)
+{
+    mVertices.reserve(verticesCount);
+    mIndices.reserve(indicesCount);
+}
+
 Mesh& Mesh::operator+=(const Mesh& rhv)
 {
-    auto indexCount = mIndices.size();
+    auto indexCount = mVertices.size();
 
     std::copy(rhv.mVertices.begin(),
               rhv.mVertices.end(),
@@ -77,4 +189,22 @@ Mesh& Mesh::operator+=(const Mesh& rhv)
     return *this;
 }
 
+bool Mesh::operator==(const Mesh& rhv) const
+{
+    if (mVertices.size() != rhv.mVertices.size() ||
+        mIndices.size() != rhv.mIndices.size())
+    {
+        return false;
+    }
+
+    return (mVertices.empty() ||
+            std::memcmp(mVertices.data(),
+                        rhv.mVertices.data(),
+                        mVertices.size() * sizeof(Vertex)) == 0) &&
+           (mIndices.empty() ||
+            std::memcmp(mIndices.data(),
+                        rhv.mIndices.data(),
+                        mIndices.size() * sizeof(uint)) == 0);
+}
+
 }
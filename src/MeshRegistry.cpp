@@ -0,0 +1,110 @@
+#include "MeshRegistry.h"
+
+namespace custom_scene
+{
+
+std::shared_ptr<Mesh> MeshRegistry::intern(const std::shared_ptr<Mesh>& mesh)
+{
+    if (!mesh)
+    {
+        return mesh;
+    }
+
+    // the mesh whose canonical one is destroyed is interned again, but it is not counted again
+    bool isKnown{false};
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // the address of the destroyed mesh may be taken by the new one, so the owner is compared
+        auto known = mKnown.find(mesh.get());
+        if (known != mKnown.end() && known->second.mesh.lock() == mesh)
+        {
+            if (auto canonical = known->second.canonical.lock())
+            {
+                return canonical;
+            }
+
+            isKnown = true;
+        }
+    }
+
+    auto hash = mesh->getHash();
+    auto size = mesh->getSize();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    prune();
+
+    if (!isKnown)
+    {
+        mReport.meshesCount++;
+        mReport.totalBytes += size;
+    }
+
+    auto [begin, end] = mMeshes.equal_range(hash);
+    for (auto it = begin; it != end;)
+    {
+        auto canonical = it->second.lock();
+
+        if (!canonical)
+        {
+            it = mMeshes.erase(it);
+            continue;
+        }
+
+        if (canonical == mesh || *canonical == *mesh)
+        {
+            if (canonical != mesh && !isKnown)
+            {
+                mReport.deduplicatedBytes += size;
+            }
+
+            mKnown[mesh.get()] = {mesh, canonical};
+            return canonical;
+        }
+
+        ++it;
+    }
+
+    mMeshes.emplace(hash, mesh);
+    mKnown[mesh.get()] = {mesh, mesh};
+    mReport.uniqueMeshesCount++;
+    mReport.uniqueBytes += size;
+
+    return mesh;
+}
+
+void MeshRegistry::prune()
+{
+    if (mKnown.size() < 2 * mPrunedCount + 64)
+    {
+        return;
+    }
+
+    for (auto it = mKnown.begin(); it != mKnown.end();)
+    {
+        it = it->second.mesh.expired() ? mKnown.erase(it) : std::next(it);
+    }
+
+    mPrunedCount = mKnown.size();
+}
+
+void MeshRegistry::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mMeshes.clear();
+    mKnown.clear();
+    mPrunedCount = 0;
+    mReport = {0, 0, 0, 0, 0};
+}
+
+MeshRegistry::Report MeshRegistry::getReport() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mReport;
+}
+
+}
@@ -0,0 +1,105 @@
+#include "MeshWriter.h"
+
+#include <algorithm>
+
+namespace custom_scene
+{
+
+MeshWriter::MeshWriter(Pipe& pipe, const Pipe::Range& range, Callback onUnmap) :
+    mPipe(&pipe),
+    mRange(range),
+    mOnUnmap(onUnmap)
+{
+    mVertices = mPipe->mapVertices(mRange);
+    mIndices = mPipe->mapIndices(mRange);
+}
+
+MeshWriter::MeshWriter(MeshWriter&& other) noexcept :
+    mPipe(other.mPipe),
+    mRange(other.mRange),
+    mVertices(other.mVertices),
+    mIndices(other.mIndices),
+    mOnUnmap(std::move(other.mOnUnmap))
+{
+    other.mPipe = nullptr;
+}
+
+MeshWriter::~MeshWriter()
+{
+    unmap();
+}
+
+Vertex* MeshWriter::getVertices() const
+{
+    return mVertices;
+}
+
+uint* MeshWriter::getIndices() const
+{
+    return mIndices;
+}
+
+const Pipe::Range& MeshWriter::getRange() const
+{
+    return mRange;
+}
+
+bool MeshWriter::isFitting(std::size_t verticesCount, std::size_t indicesCount) const
+{
+    // the failed map leaves the null pointer
+    return mPipe &&
+           verticesCount <= mRange.verticesCount &&
+           indicesCount <= mRange.indicesCount &&
+           (verticesCount == 0 || mVertices) &&
+           (indicesCount == 0 || mIndices);
+}
+
+bool MeshWriter::write(const Mesh& mesh)
+{
+    const auto& vertices = mesh.getVertices();
+    const auto& indices = mesh.getIndices();
+
+    if (!isFitting(vertices.size(), indices.size()))
+    {
+        return false;
+    }
+
+    std::copy(vertices.begin(), vertices.end(), mVertices);
+    std::copy(indices.begin(), indices.end(), mIndices);
+
+    return true;
+}
+
+bool MeshWriter::write(const Geometry& geometry,
+                       const std::function<void(Vertex&)>& processor)
+{
+    auto size = geometry.points.indices.size();
+
+    if (!isFitting(size, size))
+    {
+        return false;
+    }
+
+    Mesh::expand(geometry, processor, mVertices, mIndices);
+
+    return true;
+}
+
+void MeshWriter::unmap()
+{
+    if (!mPipe)
+    {
+        return;
+    }
+
+    mPipe->unmap();
+    mPipe->release();
+    mPipe = nullptr;
+
+    if (mOnUnmap)
+    {
+        mOnUnmap(mRange);
+    }
+}
+
+}
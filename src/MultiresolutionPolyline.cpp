@@ -0,0 +1,215 @@
+#include "MultiresolutionPolyline.h"
+#include "Camera.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+constexpr uint MaxChunkSize{std::numeric_limits<std::uint16_t>::max()};
+
+Vec3 toVec3(const Point3f& point)
+{
+    return {point[0], point[1], point[2]};
+}
+
+float getSegmentDistance(const Vec3& point, const Vec3& start, const Vec3& end)
+{
+    auto segment = end - start;
+    auto lengthSquared = segment.lengthSquared();
+    auto t = lengthSquared > 0.0f
+            ? std::clamp(Vec3::dotProduct(point - start, segment) / lengthSquared, 0.0f, 1.0f)
+            : 0.0f;
+
+    return (point - (start + segment * t)).length();
+}
+
+float getBoxDistance(const Vec3& point, const Vec3& min, const Vec3& max)
+{
+    auto dx = std::max({min.x() - point.x(), 0.0f, point.x() - max.x()});
+    auto dy = std::max({min.y() - point.y(), 0.0f, point.y() - max.y()});
+    auto dz = std::max({min.z() - point.z(), 0.0f, point.z() - max.z()});
+
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+}
+
+MultiresolutionPolyline::MultiresolutionPolyline(std::vector<Point3f> points, uint chunkSize) :
+    mPoints(std::move(points)),
+    mErrors(mPoints.size(), 0.0f),
+    mOffsets(mPoints.size(), 0)
+{
+    chunkSize = std::clamp(chunkSize, 2u, MaxChunkSize);
+
+    for (std::size_t first = 0; first + 1 < mPoints.size(); first += chunkSize)
+    {
+        auto last = std::min<std::size_t>(first + chunkSize, mPoints.size() - 1);
+        mChunks.push_back({static_cast<uint>(first), static_cast<uint>(last), {}, {}});
+    }
+
+    utils::parallelFor(mChunks.size(), [this](std::size_t index, uint)
+    {
+        buildChunk(mChunks[index]);
+    });
+}
+
+std::pmr::vector<Point3f> MultiresolutionPolyline::select(const Camera& camera,
+                                                          float pixelTolerance,
+                                                          std::pmr::memory_resource* resource) const
+{
+    std::pmr::vector<Point3f> points(resource);
+
+    if (mChunks.empty())
+    {
+        points.assign(mPoints.begin(), mPoints.end());
+        return points;
+    }
+
+    auto transformation = camera.getTransformation();
+    const auto& position = camera.getPosition();
+
+    // the first pass counts the points of the chunks, the second one writes them
+    // to their places, the chunk's first point is followed by its interior points
+    std::pmr::vector<std::size_t> counts(mChunks.size() + 1, 0, resource);
+
+    utils::parallelFor(mChunks.size(), [&](std::size_t index, uint)
+    {
+        const auto& chunk = mChunks[index];
+        std::size_t count{0};
+
+        if (utils::isBoxVisible(transformation, chunk.min, chunk.max))
+        {
+            auto distance = getBoxDistance(position, chunk.min, chunk.max);
+            auto tolerance = camera.getProjectionKoef(distance) * pixelTolerance;
+
+            auto first = mErrors.begin() + chunk.first + 1;
+            auto last = mErrors.begin() + chunk.last;
+            count = std::partition_point(first,
+                                         last,
+                                         [tolerance](float error) { return error >= tolerance; })
+                    - first;
+        }
+
+        counts[index + 1] = count + 1;
+    });
+
+    std::partial_sum(counts.begin(), counts.end(), counts.begin());
+    points.resize(counts.back() + 1);
+
+    // every chunk sorts its offsets in its own part, the resource is used by the calling thread only
+    std::pmr::vector<std::uint16_t> offsets(counts.back(), resource);
+
+    utils::parallelFor(mChunks.size(), [&](std::size_t index, uint)
+    {
+        const auto& chunk = mChunks[index];
+        auto output = points.begin() + counts[index];
+        auto count = counts[index + 1] - counts[index] - 1;
+
+        // the prefix of the points sorted by the errors is restored to the polyline's order
+        auto chunkOffsets = offsets.begin() + counts[index];
+        std::copy_n(mOffsets.begin() + chunk.first + 1, count, chunkOffsets);
+        std::sort(chunkOffsets, chunkOffsets + count);
+
+        *output++ = mPoints[chunk.first];
+        std::for_each(chunkOffsets, chunkOffsets + count, [&](std::uint16_t offset)
+        {
+            *output++ = mPoints[chunk.first + offset];
+        });
+    });
+
+    points.back() = mPoints[mChunks.back().last];
+
+    return points;
+}
+
+const std::vector<Point3f>& MultiresolutionPolyline::getPoints() const
+{
+    return mPoints;
+}
+
+void MultiresolutionPolyline::buildChunk(Chunk& chunk)
+{
+    chunk.min = chunk.max = toVec3(mPoints[chunk.first]);
+
+    for (auto index = chunk.first + 1; index <= chunk.last; index++)
+    {
+        auto point = toVec3(mPoints[index]);
+        chunk.min = Vec3(std::min(chunk.min.x(), point.x()),
+                         std::min(chunk.min.y(), point.y()),
+                         std::min(chunk.min.z(), point.z()));
+        chunk.max = Vec3(std::max(chunk.max.x(), point.x()),
+                         std::max(chunk.max.y(), point.y()),
+                         std::max(chunk.max.z(), point.z()));
+    }
+
+    // the point's error is its distance to the chord of the interval which it splits,
+    // clamped by the parent's error, so the coarser tolerances select the subsets
+    struct Interval
+    {
+        uint first;
+        uint last;
+        float error;
+    };
+
+    std::vector<Interval> intervals{{chunk.first, chunk.last, std::numeric_limits<float>::max()}};
+
+    while (!intervals.empty())
+    {
+        auto interval = intervals.back();
+        intervals.pop_back();
+
+        if (interval.last - interval.first < 2)
+        {
+            continue;
+        }
+
+        auto start = toVec3(mPoints[interval.first]);
+        auto end = toVec3(mPoints[interval.last]);
+        auto split = interval.first + 1;
+        auto maxError = -1.0f;
+
+        for (auto index = interval.first + 1; index < interval.last; index++)
+        {
+            auto error = getSegmentDistance(toVec3(mPoints[index]), start, end);
+            if (error > maxError)
+            {
+                maxError = error;
+                split = index;
+            }
+        }
+
+        auto error = std::min(maxError, interval.error);
+        mErrors[split] = error;
+        intervals.push_back({interval.first, split, error});
+        intervals.push_back({split, interval.last, error});
+    }
+
+    // the interior points are sorted by the errors in place of their errors
+    auto first = chunk.first + 1;
+    auto count = chunk.last - first;
+    std::vector<std::uint16_t> offsets(count);
+    std::iota(offsets.begin(), offsets.end(), 1);
+    std::stable_sort(offsets.begin(), offsets.end(), [&](auto lhv, auto rhv)
+    {
+        return mErrors[chunk.first + lhv] > mErrors[chunk.first + rhv];
+    });
+
+    std::vector<float> errors(count);
+    for (uint i = 0; i < count; i++)
+    {
+        errors[i] = mErrors[chunk.first + offsets[i]];
+    }
+
+    std::copy(errors.begin(), errors.end(), mErrors.begin() + first);
+    std::copy(offsets.begin(), offsets.end(), mOffsets.begin() + first);
+}
+
+}
@@ -2,6 +2,8 @@
 #include "Mesh.h"
 #include "Program.h"
 
+#include <algorithm>
+
 namespace custom_scene
 {
 
@@ -15,7 +17,13 @@ Pipe::Pipe(std::shared_ptr<Program> program,
 void Pipe::initialize()
 {
     initializeOpenGLFunctions();
-    mProgram->initialize();
+
+    // the program which is submitted to the compiler is linked in the background
+    if (!mProgram->isSubmitted())
+    {
+        mProgram->initialize();
+    }
+
     create();
     bind();
     initializeAttributes();
@@ -41,9 +49,34 @@ bool Pipe::isInitialized() const
     return mIsInitialized;
 }
 
+bool Pipe::isReady() const
+{
+    return mIsInitialized && mProgram->isReady();
+}
+
+std::shared_ptr<Program> Pipe::getProgram() const
+{
+    return mProgram;
+}
+
+uint Pipe::getVerticesCount() const
+{
+    return mVerticesCount;
+}
+
+uint Pipe::getIndicesCount() const
+{
+    return mIndicesCount;
+}
+
 void Pipe::bind()
 {
-    mProgram->bind();
+    // the buffers are written while the program is being linked
+    if (mProgram->isReady())
+    {
+        mProgram->bind();
+    }
+
     mVAO.bind();
     mVBO.bind();
     mEBO.bind();
@@ -51,7 +84,11 @@ void Pipe::bind()
 
 void Pipe::release()
 {
-    mProgram->release();
+    if (mProgram->isReady())
+    {
+        mProgram->release();
+    }
+
     mVAO.release();
     mVBO.release();
     mEBO.release();
@@ -66,9 +103,191 @@ void Pipe::allocate(const Mesh& mesh)
     mVBO.allocate(vertices.data(), vertices.size() * sizeof(Vertex));
     mEBO.allocate(indices.data(), indices.size() * sizeof(uint));
     release();
+
+    mVerticesCount = mVerticesCapacity = vertices.size();
+    mIndicesCount = mIndicesCapacity = indices.size();
     mIsAllocated = true;
 }
 
+Pipe::Range Pipe::reserve(uint verticesCount, uint indicesCount)
+{
+    if (mVerticesCount + verticesCount > mVerticesCapacity ||
+        mIndicesCount + indicesCount > mIndicesCapacity)
+    {
+        Range used{0, mVerticesCount, 0, mIndicesCount};
+
+        relocate(std::max(mVerticesCapacity * 2, mVerticesCount + verticesCount),
+                 std::max(mIndicesCapacity * 2, mIndicesCount + indicesCount),
+                 {&used});
+    }
+
+    Range range{mVerticesCount, verticesCount, mIndicesCount, indicesCount};
+
+    mVerticesCount += verticesCount;
+    mIndicesCount += indicesCount;
+
+    return range;
+}
+
+Vertex* Pipe::mapVertices(const Range& range)
+{
+    if (range.verticesCount == 0)
+    {
+        return nullptr;
+    }
+
+    mVBO.bind();
+    mIsVerticesMapped = true;
+
+    return static_cast<Vertex*>(
+                mVBO.mapRange(range.baseVertex * sizeof(Vertex),
+                              range.verticesCount * sizeof(Vertex),
+                              QOpenGLBuffer::RangeWrite |
+                              QOpenGLBuffer::RangeInvalidate));
+}
+
+uint* Pipe::mapIndices(const Range& range)
+{
+    if (range.indicesCount == 0)
+    {
+        return nullptr;
+    }
+
+    mEBO.bind();
+    mIsIndicesMapped = true;
+
+    return static_cast<uint*>(
+                mEBO.mapRange(range.startIndex * sizeof(uint),
+                              range.indicesCount * sizeof(uint),
+                              QOpenGLBuffer::RangeWrite |
+                              QOpenGLBuffer::RangeInvalidate));
+}
+
+void Pipe::unmap()
+{
+    if (mIsVerticesMapped)
+    {
+        mVBO.bind();
+        mVBO.unmap();
+        mIsVerticesMapped = false;
+    }
+
+    if (mIsIndicesMapped)
+    {
+        mEBO.bind();
+        mEBO.unmap();
+        mIsIndicesMapped = false;
+    }
+}
+
+void Pipe::copy(const Range& range, GLuint buffer, GLintptr verticesOffset, GLintptr indicesOffset)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+
+    if (range.verticesCount > 0)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, mVBO.bufferId());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                            GL_COPY_WRITE_BUFFER,
+                            verticesOffset,
+                            range.baseVertex * sizeof(Vertex),
+                            range.verticesCount * sizeof(Vertex));
+    }
+
+    if (range.indicesCount > 0)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, mEBO.bufferId());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                            GL_COPY_WRITE_BUFFER,
+                            indicesOffset,
+                            range.startIndex * sizeof(uint),
+                            range.indicesCount * sizeof(uint));
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void Pipe::compact(const std::vector<Range*>& ranges)
+{
+    relocate(mVerticesCapacity, mIndicesCapacity, ranges);
+}
+
+void Pipe::reset()
+{
+    mVerticesCount = 0;
+    mIndicesCount = 0;
+    mIsAllocated = false;
+}
+
+void Pipe::relocate(uint verticesCapacity,
+                    uint indicesCapacity,
+                    const std::vector<Range*>& ranges)
+{
+    QOpenGLBuffer vbo(QOpenGLBuffer::VertexBuffer);
+    QOpenGLBuffer ebo(QOpenGLBuffer::IndexBuffer);
+
+    mVAO.bind();
+
+    vbo.create();
+    vbo.bind();
+    vbo.allocate(verticesCapacity * sizeof(Vertex));
+
+    ebo.create();
+    ebo.bind();
+    ebo.allocate(indicesCapacity * sizeof(uint));
+
+    uint verticesCount{0};
+    uint indicesCount{0};
+
+    for (auto range : ranges)
+    {
+        if (range->verticesCount > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, mVBO.bufferId());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vbo.bufferId());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                                GL_COPY_WRITE_BUFFER,
+                                range->baseVertex * sizeof(Vertex),
+                                verticesCount * sizeof(Vertex),
+                                range->verticesCount * sizeof(Vertex));
+        }
+
+        if (range->indicesCount > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, mEBO.bufferId());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ebo.bufferId());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                                GL_COPY_WRITE_BUFFER,
+                                range->startIndex * sizeof(uint),
+                                indicesCount * sizeof(uint),
+                                range->indicesCount * sizeof(uint));
+        }
+
+        range->baseVertex = verticesCount;
+        range->startIndex = indicesCount;
+        verticesCount += range->verticesCount;
+        indicesCount += range->indicesCount;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    mVBO.destroy();
+    mEBO.destroy();
+    mVBO = vbo;
+    mEBO = ebo;
+
+    mVBO.bind();
+    mEBO.bind();
+    initializeAttributes();
+
+    mVerticesCount = verticesCount;
+    mIndicesCount = indicesCount;
+    mVerticesCapacity = verticesCapacity;
+    mIndicesCapacity = indicesCapacity;
+}
+
 void Pipe::initializeAttributes()
 {
     GLuint index{0};
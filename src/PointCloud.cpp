@@ -0,0 +1,269 @@
+#include "PointCloud.h"
+
+#include <QFile>
+#include <algorithm>
+#include <array>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+constexpr std::uint64_t PathMask{(std::uint64_t{1} << 58) - 1};
+
+struct IndexHeader
+{
+    float min[3];
+    float size;
+    std::uint32_t gridSize;
+    std::uint32_t nodesCount;
+};
+
+QString getIndexPath(const QString& directory)
+{
+    return QString("%1/index.bin").arg(directory);
+}
+
+}
+
+bool PointCloudIndex::read(const QString& directory)
+{
+    QFile file(getIndexPath(directory));
+    IndexHeader header;
+
+    if (!file.open(QFile::ReadOnly) ||
+        file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header))
+    {
+        return false;
+    }
+
+    auto size = static_cast<qint64>(header.nodesCount * sizeof(Node));
+
+    // the corrupted header does not make the nodes larger than the file
+    if (size != file.size() - static_cast<qint64>(sizeof(header)))
+    {
+        return false;
+    }
+
+    nodes.resize(header.nodesCount);
+
+    if (file.read(reinterpret_cast<char*>(nodes.data()), size) != size)
+    {
+        nodes.clear();
+        return false;
+    }
+
+    min = Vec3(header.min[0], header.min[1], header.min[2]);
+    this->size = header.size;
+    gridSize = header.gridSize;
+
+    return true;
+}
+
+bool PointCloudIndex::write(const QString& directory) const
+{
+    QFile file(getIndexPath(directory));
+    IndexHeader header{{min.x(), min.y(), min.z()},
+                       size,
+                       gridSize,
+                       static_cast<std::uint32_t>(nodes.size())};
+    auto nodesSize = static_cast<qint64>(nodes.size() * sizeof(Node));
+
+    return file.open(QFile::WriteOnly | QFile::Truncate) &&
+           file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header) &&
+           file.write(reinterpret_cast<const char*>(nodes.data()), nodesSize) == nodesSize;
+}
+
+float PointCloudIndex::getBounds(std::uint64_t key, Vec3& min) const
+{
+    auto nodeSize = size;
+    min = this->min;
+
+    for (auto level = getLevel(key); level > 0; level--)
+    {
+        auto child = (key >> (3 * (level - 1))) & 7;
+        nodeSize /= 2.0f;
+        min += Vec3(child & 1, (child >> 1) & 1, child >> 2) * nodeSize;
+    }
+
+    return nodeSize;
+}
+
+std::uint64_t PointCloudIndex::getChildKey(std::uint64_t key, uint child)
+{
+    return (static_cast<std::uint64_t>(getLevel(key) + 1) << 58) |
+           ((key & PathMask) << 3) |
+           child;
+}
+
+uint PointCloudIndex::getLevel(std::uint64_t key)
+{
+    return static_cast<uint>(key >> 58);
+}
+
+QString PointCloudIndex::getNodePath(const QString& directory, std::uint64_t key)
+{
+    return QString("%1/%2.bin").arg(directory).arg(QString::number(key, 16));
+}
+
+std::vector<CloudPoint> PointCloudIndex::readNode(const QString& directory, std::uint64_t key)
+{
+    std::vector<CloudPoint> points;
+    QFile file(getNodePath(directory, key));
+
+    if (file.open(QFile::ReadOnly))
+    {
+        points.resize(file.size() / sizeof(CloudPoint));
+
+        auto size = static_cast<qint64>(points.size() * sizeof(CloudPoint));
+        if (file.read(reinterpret_cast<char*>(points.data()), size) != size)
+        {
+            points.clear();
+        }
+    }
+
+    return points;
+}
+
+PointCloudWriter::PointCloudWriter(const QString& directory,
+                                   const Vec3& min,
+                                   const Vec3& max,
+                                   uint maxDepth) :
+    mDirectory(directory),
+    mMaxDepth(std::min(maxDepth, PointCloudIndex::MaxDepth))
+{
+    // the octree is built over the cube
+    auto extent = max - min;
+    mIndex.min = min;
+    mIndex.size = std::max({extent.x(), extent.y(), extent.z(), 1e-6f});
+    mIndex.gridSize = DefaultGridSize;
+}
+
+bool PointCloudWriter::add(const CloudPoint* points, std::size_t count)
+{
+    const int gridSize = mIndex.gridSize;
+    auto isOk = true;
+
+    for (const auto* point = points; point != points + count; ++point)
+    {
+        std::uint64_t key{0};
+        auto nodeMin = mIndex.min;
+        auto nodeSize = mIndex.size;
+
+        for (uint level = 0;; level++)
+        {
+            auto& node = mNodes[key];
+
+            std::array<int, 3> cell;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                cell[axis] = std::clamp(static_cast<int>((point->position[axis] - nodeMin[axis]) /
+                                                         nodeSize * gridSize),
+                                        0,
+                                        gridSize - 1);
+            }
+
+            auto isTaken = level >= mMaxDepth;
+
+            if (!isTaken)
+            {
+                auto index = (static_cast<std::size_t>(cell[2]) * gridSize + cell[1]) * gridSize +
+                        cell[0];
+
+                if (node.cells.empty())
+                {
+                    node.cells.resize((gridSize * gridSize * gridSize + 63) / 64, 0);
+                }
+
+                auto& word = node.cells[index / 64];
+                auto bit = std::uint64_t{1} << (index % 64);
+                isTaken = (word & bit) == 0;
+                word |= bit;
+            }
+
+            if (isTaken)
+            {
+                node.buffer.push_back(*point);
+                node.pointsCount++;
+                mBufferedPoints++;
+
+                if (node.buffer.size() >= NodeBufferSize)
+                {
+                    isOk = flush(key, node) && isOk;
+                }
+                break;
+            }
+
+            uint child = (cell[0] >= gridSize / 2 ? 1 : 0) |
+                    (cell[1] >= gridSize / 2 ? 2 : 0) |
+                    (cell[2] >= gridSize / 2 ? 4 : 0);
+
+            nodeSize /= 2.0f;
+            nodeMin += Vec3(child & 1, (child >> 1) & 1, child >> 2) * nodeSize;
+            key = PointCloudIndex::getChildKey(key, child);
+        }
+
+        if (mBufferedPoints >= MaxBufferedPoints)
+        {
+            isOk = flush() && isOk;
+        }
+    }
+
+    return isOk;
+}
+
+bool PointCloudWriter::finish()
+{
+    auto isOk = flush();
+
+    mIndex.nodes.clear();
+    mIndex.nodes.reserve(mNodes.size());
+
+    for (const auto& [key, node] : mNodes)
+    {
+        mIndex.nodes.push_back({key, node.pointsCount});
+    }
+
+    std::sort(mIndex.nodes.begin(),
+              mIndex.nodes.end(),
+              [](const auto& lhv, const auto& rhv) { return lhv.key < rhv.key; });
+
+    return mIndex.write(mDirectory) && isOk;
+}
+
+bool PointCloudWriter::flush(std::uint64_t key, Node& node)
+{
+    if (node.buffer.empty())
+    {
+        return true;
+    }
+
+    // the first write replaces the file which is left from the previous build
+    auto isFirstWrite = node.pointsCount == node.buffer.size();
+    auto size = static_cast<qint64>(node.buffer.size() * sizeof(CloudPoint));
+
+    QFile file(PointCloudIndex::getNodePath(mDirectory, key));
+    auto isOk = file.open(isFirstWrite ? QFile::WriteOnly | QFile::Truncate
+                                       : QFile::WriteOnly | QFile::Append) &&
+            file.write(reinterpret_cast<const char*>(node.buffer.data()), size) == size;
+
+    mBufferedPoints -= node.buffer.size();
+    std::vector<CloudPoint>().swap(node.buffer);
+
+    return isOk;
+}
+
+bool PointCloudWriter::flush()
+{
+    auto isOk = true;
+
+    for (auto& [key, node] : mNodes)
+    {
+        isOk = flush(key, node) && isOk;
+    }
+
+    return isOk;
+}
+
+}
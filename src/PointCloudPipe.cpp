@@ -0,0 +1,354 @@
+#include "PointCloudPipe.h"
+#include "Camera.h"
+#include "Program.h"
+#include "Memory.h"
+#include "Utils.h"
+#include "Defaults.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <queue>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+float getDistance(const Vec3& point, const Vec3& min, const Vec3& max)
+{
+    auto dx = std::max({min.x() - point.x(), 0.0f, point.x() - max.x()});
+    auto dy = std::max({min.y() - point.y(), 0.0f, point.y() - max.y()});
+    auto dz = std::max({min.z() - point.z(), 0.0f, point.z() - max.z()});
+
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+}
+
+PointCloudPipe::PointCloudPipe(std::shared_ptr<Program> program, const Parameters& parameters) :
+    ScenePipe(program, defaults::attributes::Vertex),
+    mParameters(parameters),
+    mLoader([directory = parameters.directory](std::uint64_t key)
+            {
+                return PointCloudIndex::readNode(directory, key);
+            })
+{
+    if (!mIndex.read(mParameters.directory))
+    {
+        return;
+    }
+
+    // the index is sorted by keys, so the parents precede their children
+    mNodes.reserve(mIndex.nodes.size());
+
+    for (const auto& indexNode : mIndex.nodes)
+    {
+        Node node{indexNode.key, indexNode.pointsCount, {}, 0.0f, {}, 0, 0, 0, false, 0};
+        node.size = mIndex.getBounds(node.key, node.min);
+        node.children.fill(-1);
+
+        auto level = PointCloudIndex::getLevel(node.key);
+
+        if (level > 0)
+        {
+            auto path = node.key & ((std::uint64_t{1} << 58) - 1);
+            auto parentKey = (static_cast<std::uint64_t>(level - 1) << 58) | (path >> 3);
+            auto parent = mNodeIndices.find(parentKey);
+
+            if (parent == mNodeIndices.end())
+            {
+                continue;
+            }
+
+            mNodes[parent->second].children[path & 7] = static_cast<int>(mNodes.size());
+        }
+        else if (!mNodes.empty())
+        {
+            continue;
+        }
+
+        mNodeIndices.emplace(node.key, static_cast<uint>(mNodes.size()));
+        mNodes.push_back(node);
+    }
+}
+
+PointCloudPipe::~PointCloudPipe()
+{
+    mContextGuard.release();
+}
+
+void PointCloudPipe::render(std::shared_ptr<Camera> camera,
+                            const Lights&,
+                            const Textures&)
+{
+    if (!mIsInitialized || mNodes.empty())
+    {
+        return;
+    }
+
+    // the nodes which are still needed are requested again by the selection
+    mLoader.cancel();
+    uploadNodes();
+
+    std::pmr::vector<uint> nodes(memory::getFrameArena().getResource());
+    selectNodes(camera, nodes);
+
+    bind();
+    mProgram->setView(camera->getPosition(),
+                      camera->getProjection(),
+                      camera->getView());
+    mProgram->setTransformation(Mat4());
+    mProgram->setAlfa(1.0f);
+    mProgram->setUniformValue("pointSize", mParameters.pointSize);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glDisable(GL_BLEND);
+
+    for (auto index : nodes)
+    {
+        const auto& node = mNodes[index];
+
+        glBindVertexArray(node.vertexArray);
+        glDrawArrays(GL_POINTS, 0, node.residentCount);
+    }
+
+    glBindVertexArray(0);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+
+    release();
+
+    evictNodes();
+    mFrame++;
+}
+
+PointCloudPipe::Statistics PointCloudPipe::getStatistics() const
+{
+    return {mVisibleNodesCount,
+            mVisiblePointsCount,
+            mResidentNodesCount,
+            mResidentPointsCount,
+            mLoader.getPendingCount()};
+}
+
+void PointCloudPipe::selectNodes(std::shared_ptr<Camera> camera, std::pmr::vector<uint>& nodes)
+{
+    auto transformation = camera->getProjection() * camera->getView();
+    const auto& position = camera->getPosition();
+    auto isPerspective = camera->isProjectionPerspective();
+
+    // the projected size of the unit length at the unit distance in pixels
+    auto pixelsPerUnit = camera->getProjection()(1, 1) * camera->getViewPortSize().second / 2.0f;
+
+    // the node's error is the distance between its points, so the points of the node
+    // with the error below the limit are dense enough and its children are not needed
+    auto getError = [&](const Node& node)
+    {
+        auto error = node.size / mIndex.gridSize * pixelsPerUnit;
+
+        if (isPerspective)
+        {
+            auto distance = getDistance(position, node.min, node.min + Vec3(node.size,
+                                                                            node.size,
+                                                                            node.size));
+            error /= std::max(distance, 1e-3f);
+        }
+
+        return error;
+    };
+
+    using Candidate = std::pair<float, uint>;
+    std::priority_queue<Candidate, std::pmr::vector<Candidate>> candidates(
+                std::less<Candidate>(),
+                std::pmr::vector<Candidate>(memory::getFrameArena().getResource()));
+    candidates.emplace(std::numeric_limits<float>::max(), 0);
+
+    mVisiblePointsCount = 0;
+
+    while (!candidates.empty())
+    {
+        auto [error, index] = candidates.top();
+        candidates.pop();
+
+        auto& node = mNodes[index];
+        node.lastUsedFrame = mFrame;
+
+        if (error < mParameters.maxScreenSpaceError && index != 0)
+        {
+            break;
+        }
+
+        Vec3 max = node.min + Vec3(node.size, node.size, node.size);
+
+        if (!utils::isBoxVisible(transformation, node.min, max))
+        {
+            continue;
+        }
+
+        // the children are refined only when their parent is drawn, so there are no holes
+        if (!node.isResident)
+        {
+            mLoader.request(node.key);
+            continue;
+        }
+
+        if (mVisiblePointsCount + node.residentCount > mParameters.pointBudget)
+        {
+            break;
+        }
+
+        if (node.residentCount > 0)
+        {
+            nodes.push_back(index);
+            mVisiblePointsCount += node.residentCount;
+        }
+
+        for (auto child : node.children)
+        {
+            if (child >= 0)
+            {
+                candidates.emplace(getError(mNodes[child]), child);
+            }
+        }
+    }
+
+    mVisibleNodesCount = nodes.size();
+}
+
+void PointCloudPipe::uploadNodes()
+{
+    for (auto& [key, points] : mLoader.take(mParameters.maxUploadsPerFrame))
+    {
+        auto index = mNodeIndices.find(key);
+
+        if (index == mNodeIndices.end())
+        {
+            continue;
+        }
+
+        auto& node = mNodes[index->second];
+        node.lastUsedFrame = mFrame;
+        node.isResident = true;
+        node.residentCount = static_cast<GLsizei>(points.size());
+
+        // the missing node is resident without points, so it is not requested again
+        if (points.empty())
+        {
+            continue;
+        }
+
+        mContextGuard.attach([this]() { return takeNodes(); });
+
+        glGenVertexArrays(1, &node.vertexArray);
+        glGenBuffers(1, &node.buffer);
+
+        glBindVertexArray(node.vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, node.buffer);
+        glBufferData(GL_ARRAY_BUFFER,
+                     points.size() * sizeof(CloudPoint),
+                     points.data(),
+                     GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0,
+                              3,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              sizeof(CloudPoint),
+                              reinterpret_cast<void*>(offsetof(CloudPoint, position)));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(2,
+                              4,
+                              GL_UNSIGNED_BYTE,
+                              GL_TRUE,
+                              sizeof(CloudPoint),
+                              reinterpret_cast<void*>(offsetof(CloudPoint, color)));
+        glEnableVertexAttribArray(2);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        mResidentNodesCount++;
+        mResidentPointsCount += points.size();
+    }
+}
+
+void PointCloudPipe::evictNodes()
+{
+    if (mResidentPointsCount <= mParameters.maxResidentPoints)
+    {
+        return;
+    }
+
+    using Candidate = std::pair<std::size_t, uint>;
+    std::pmr::vector<Candidate> candidates(memory::getFrameArena().getResource());
+
+    for (uint index = 1; index < mNodes.size(); index++)
+    {
+        // the root and the nodes used by the current frame are kept
+        const auto& node = mNodes[index];
+        if (node.vertexArray != 0 && node.lastUsedFrame < mFrame)
+        {
+            candidates.emplace_back(node.lastUsedFrame, index);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    for (auto candidate = candidates.begin();
+         candidate != candidates.end() && mResidentPointsCount > mParameters.maxResidentPoints;
+         ++candidate)
+    {
+        releaseNode(mNodes[candidate->second]);
+    }
+}
+
+void PointCloudPipe::releaseNode(Node& node)
+{
+    if (node.vertexArray != 0)
+    {
+        glDeleteVertexArrays(1, &node.vertexArray);
+        glDeleteBuffers(1, &node.buffer);
+
+        mResidentNodesCount--;
+        mResidentPointsCount -= node.residentCount;
+    }
+
+    node.vertexArray = 0;
+    node.buffer = 0;
+    node.residentCount = 0;
+    node.isResident = false;
+}
+
+ContextGuard::Release PointCloudPipe::takeNodes()
+{
+    std::vector<GLuint> vertexArrays;
+    std::vector<GLuint> buffers;
+
+    for (auto& node : mNodes)
+    {
+        if (node.vertexArray != 0)
+        {
+            vertexArrays.push_back(node.vertexArray);
+            buffers.push_back(node.buffer);
+        }
+
+        node.vertexArray = 0;
+        node.buffer = 0;
+        node.residentCount = 0;
+        node.isResident = false;
+    }
+
+    mResidentNodesCount = 0;
+    mResidentPointsCount = 0;
+
+    return [vertexArrays, buffers](QOpenGLExtraFunctions& functions)
+    {
+        functions.glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+        functions.glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+    };
+}
+
+}
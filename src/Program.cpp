@@ -2,11 +2,42 @@
 #include "Utils.h"
 #include "Material.h"
 #include "Light.h"
+#include "ProgramCache.h"
 
+#include <QFile>
 #include <QFileInfo>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 
 namespace custom_scene {
 
+namespace
+{
+
+/** GL_COMPLETION_STATUS_KHR of KHR_parallel_shader_compile */
+constexpr GLenum CompletionStatus{0x91B1};
+
+GLenum getShaderType(QOpenGLShader::ShaderType type)
+{
+    switch (type)
+    {
+        case QOpenGLShader::Vertex:
+            return GL_VERTEX_SHADER;
+        case QOpenGLShader::Geometry:
+            return GL_GEOMETRY_SHADER;
+        case QOpenGLShader::TessellationControl:
+            return GL_TESS_CONTROL_SHADER;
+        case QOpenGLShader::TessellationEvaluation:
+            return GL_TESS_EVALUATION_SHADER;
+        case QOpenGLShader::Compute:
+            return GL_COMPUTE_SHADER;
+        default:
+            return GL_FRAGMENT_SHADER;
+    }
+}
+
+}
+
 Program::Program(const ShaderSources& sources, QObject* parent) :
     QOpenGLShaderProgram(parent),
     mSources(sources)
@@ -15,30 +46,137 @@ Program::Program(const ShaderSources& sources, QObject* parent) :
 
 void Program::initialize()
 {
-    if (mIsInitialized)
+    if (mState == State::kNone)
     {
-        return;
+        if (submit())
+        {
+            return;
+        }
+
+        compile();
     }
 
-    auto isCreated = create();
+    if (mState == State::kSubmitted)
+    {
+        finish();
+    }
+}
 
-    if (isCreated)
+bool Program::submit()
+{
+    if (mState != State::kNone)
     {
-        for (const auto& [type, source] : mSources)
+        return mState == State::kLinked;
+    }
+
+    mTimer.start();
+
+    if (!create())
+    {
+        mState = State::kFailed;
+        return false;
+    }
+
+    if (ProgramCache::getInstance().load(*this, mSources))
+    {
+        mState = State::kLinked;
+        return true;
+    }
+
+    mState = State::kSubmitted;
+    return false;
+}
+
+void Program::compile()
+{
+    auto functions = QOpenGLContext::currentContext()->extraFunctions();
+
+    for (const auto& [type, source] : mSources)
+    {
+        QByteArray code;
+
+        if (QFileInfo(source).isFile())
         {
-            if (QFileInfo(source).isFile())
-            {
-                addShaderFromSourceFile(type, source);
-            }
-            else
+            QFile file(source);
+            if (file.open(QFile::ReadOnly))
             {
-                addShaderFromSourceCode(type, source);
+                code = file.readAll();
             }
         }
+        else
+        {
+            code = source.toUtf8();
+        }
+
+        auto shader = functions->glCreateShader(getShaderType(type));
+        auto data = code.constData();
+        auto size = static_cast<GLint>(code.size());
 
-        auto isLinked = link();
-        mIsInitialized = isCreated && isLinked;
+        functions->glShaderSource(shader, 1, &data, &size);
+        functions->glCompileShader(shader);
+        functions->glAttachShader(programId(), shader);
+        mShaders.push_back(shader);
     }
+
+    // the driver keeps the binary only when it is asked before the link
+    functions->glProgramParameteri(programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    // the statuses are not asked, so the driver compiles in the background if it can
+    functions->glLinkProgram(programId());
+}
+
+bool Program::isLinkCompleted()
+{
+    auto functions = QOpenGLContext::currentContext()->extraFunctions();
+    GLint isCompleted{GL_FALSE};
+
+    functions->glGetProgramiv(programId(), CompletionStatus, &isCompleted);
+
+    return isCompleted != GL_FALSE;
+}
+
+bool Program::finish()
+{
+    if (mState != State::kSubmitted)
+    {
+        return mState == State::kLinked;
+    }
+
+    // the program without Qt's shaders takes the status of the finished link
+    auto isLinked = link();
+    mState = isLinked ? State::kLinked : State::kFailed;
+
+    auto functions = QOpenGLContext::currentContext()->extraFunctions();
+
+    for (auto shader : mShaders)
+    {
+        functions->glDetachShader(programId(), shader);
+        functions->glDeleteShader(shader);
+    }
+    mShaders.clear();
+
+    auto compileTime = std::chrono::microseconds(mTimer.nsecsElapsed() / 1000);
+
+    if (isLinked)
+    {
+        ProgramCache::getInstance().store(*this, mSources, compileTime);
+    }
+
+#ifdef SHOW_DEBUG
+    qDebug() << "Program::finish compilation:" << compileTime.count() << "mks";
+#endif
+
+    return isLinked;
+}
+
+bool Program::isSubmitted() const
+{
+    return mState != State::kNone;
+}
+
+bool Program::isReady() const
+{
+    return mState == State::kLinked;
 }
 
 void Program::setView(const Vec3& position,
@@ -67,13 +205,28 @@ void Program::setLight(Light* light)
 void Program::setMaterial(Material* material)
 {
     setUniformValue("material.shininess", material->shininess);
+    setUniformValue("material.type", static_cast<GLint>(material->type));
 
-    if (auto standartMaterial = dynamic_cast<StandartMaterial*>(material))
+    if (material->type == Material::Type::kStandart)
     {
+        auto standartMaterial = static_cast<StandartMaterial*>(material);
         setUniformValue("material.ambient", standartMaterial->ambient);
         setUniformValue("material.diffuse", standartMaterial->diffuse);
         setUniformValue("material.specular", standartMaterial->specular);
+        return;
     }
+
+    // the maps' colors are taken as they are
+    const Vec3 white(1.0f, 1.0f, 1.0f);
+    setUniformValue("material.ambient", white);
+    setUniformValue("material.diffuse", white);
+    setUniformValue("material.specular", white);
+    setUniformValue("diffuseMap", Material::DiffuseUnit);
+    setUniformValue("specularMap", Material::SpecularUnit);
+    setUniformValue("normalMap", Material::NormalUnit);
+    setUniformValue("displacementMap", Material::DisplacementUnit);
+
+    material->bindMaps();
 }
 
 void Program::setAlfa(float alfa)
@@ -0,0 +1,261 @@
+#include "ProgramCache.h"
+#include "Utils.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QStandardPaths>
+#include <cstring>
+#include <vector>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+constexpr std::uint32_t BinaryMagic{0x42505343}; // "CSPB"
+constexpr std::uint32_t BinaryVersion{1};
+
+struct BinaryHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t format;
+    std::uint32_t size;
+    std::uint64_t hash;
+    /** The compilation time of the program in microseconds */
+    std::uint64_t compileTime;
+};
+
+QOpenGLExtraFunctions* getFunctions()
+{
+    auto context = QOpenGLContext::currentContext();
+    return context ? context->extraFunctions() : nullptr;
+}
+
+bool isSupported(QOpenGLExtraFunctions& functions)
+{
+    GLint formatsCount{0};
+    functions.glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatsCount);
+    return formatsCount > 0;
+}
+
+std::uint64_t hashString(QOpenGLExtraFunctions& functions, GLenum name, std::uint64_t seed)
+{
+    auto string = reinterpret_cast<const char*>(functions.glGetString(name));
+    return string ? utils::hash(string, std::strlen(string), seed) : seed;
+}
+
+}
+
+ProgramCache& ProgramCache::getInstance()
+{
+    static ProgramCache instance;
+    return instance;
+}
+
+ProgramCache::ProgramCache() :
+    mDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/programs")
+{
+}
+
+void ProgramCache::setDirectory(const QString& directory)
+{
+    std::lock_guard lock(mMutex);
+    mDirectory = directory;
+}
+
+void ProgramCache::setEnabled(bool isEnabled)
+{
+    std::lock_guard lock(mMutex);
+    mIsEnabled = isEnabled;
+}
+
+bool ProgramCache::isEnabled() const
+{
+    std::lock_guard lock(mMutex);
+    return mIsEnabled;
+}
+
+bool ProgramCache::load(Program& program, const ShaderSources& sources)
+{
+    auto functions = getFunctions();
+
+    if (!isEnabled() || !functions || !isSupported(*functions))
+    {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    auto path = getPath(sources);
+    QFile file(path);
+    BinaryHeader header;
+
+    if (!file.open(QFile::ReadOnly))
+    {
+        std::lock_guard lock(mMutex);
+        mStats.missesCount++;
+        return false;
+    }
+
+    // the size of the corrupted file is checked before the binary is allocated
+    std::vector<char> binary;
+    auto isValid = file.read(reinterpret_cast<char*>(&header), sizeof(header)) == sizeof(header) &&
+                   header.magic == BinaryMagic &&
+                   header.version == BinaryVersion &&
+                   header.size == file.size() - static_cast<qint64>(sizeof(header));
+
+    if (isValid)
+    {
+        binary.resize(header.size);
+        isValid = file.read(binary.data(), header.size) == header.size &&
+                  utils::hash(binary.data(), binary.size()) == header.hash;
+    }
+    file.close();
+
+    if (isValid)
+    {
+        functions->glProgramBinary(program.programId(),
+                                   header.format,
+                                   binary.data(),
+                                   static_cast<GLsizei>(binary.size()));
+
+        // the program without shaders takes the link status of the binary
+        isValid = program.link();
+    }
+
+    std::lock_guard lock(mMutex);
+
+    // the binary of the updated driver is rejected too, it is replaced by the compiled one
+    if (!isValid)
+    {
+        QFile::remove(path);
+        mStats.rejectedCount++;
+        mStats.missesCount++;
+        return false;
+    }
+
+    mStats.hitsCount++;
+    mStats.loadTime += std::chrono::microseconds(timer.nsecsElapsed() / 1000);
+    mStats.savedTime += std::chrono::microseconds(header.compileTime);
+
+    return true;
+}
+
+void ProgramCache::store(Program& program,
+                         const ShaderSources& sources,
+                         std::chrono::microseconds compileTime)
+{
+    addCompileTime(compileTime);
+
+    auto functions = getFunctions();
+
+    if (!isEnabled() || !functions || !isSupported(*functions))
+    {
+        return;
+    }
+
+    GLint size{0};
+    functions->glGetProgramiv(program.programId(), GL_PROGRAM_BINARY_LENGTH, &size);
+
+    if (size <= 0)
+    {
+        return;
+    }
+
+    std::vector<char> binary(static_cast<std::size_t>(size));
+    GLenum format{0};
+    GLsizei length{0};
+    functions->glGetProgramBinary(program.programId(), size, &length, &format, binary.data());
+    binary.resize(static_cast<std::size_t>(length));
+
+    BinaryHeader header{BinaryMagic,
+                        BinaryVersion,
+                        format,
+                        static_cast<std::uint32_t>(binary.size()),
+                        utils::hash(binary.data(), binary.size()),
+                        static_cast<std::uint64_t>(compileTime.count())};
+
+    QString directory;
+    {
+        std::lock_guard lock(mMutex);
+        directory = mDirectory;
+    }
+
+    if (!QDir().mkpath(directory))
+    {
+        return;
+    }
+
+    auto path = getPath(sources);
+    QFile file(path);
+    auto size64 = static_cast<qint64>(binary.size());
+
+    auto isWritten = file.open(QFile::WriteOnly | QFile::Truncate) &&
+                     file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header) &&
+                     file.write(binary.data(), size64) == size64;
+    file.close();
+
+    // the partial binary would be rejected anyway
+    if (!isWritten)
+    {
+        QFile::remove(path);
+    }
+}
+
+void ProgramCache::addCompileTime(std::chrono::microseconds compileTime)
+{
+    std::lock_guard lock(mMutex);
+    mStats.compileTime += compileTime;
+}
+
+ProgramCache::Stats ProgramCache::getStats() const
+{
+    std::lock_guard lock(mMutex);
+    return mStats;
+}
+
+QString ProgramCache::getPath(const ShaderSources& sources) const
+{
+    std::uint64_t key{0};
+
+    for (const auto& [type, source] : sources)
+    {
+        QByteArray data;
+
+        if (QFileInfo(source).isFile())
+        {
+            QFile file(source);
+            if (file.open(QFile::ReadOnly))
+            {
+                data = file.readAll();
+            }
+        }
+        else
+        {
+            data = source.toUtf8();
+        }
+
+        key = utils::hash(&type, sizeof(type), key);
+        key = utils::hash(data.constData(), static_cast<std::size_t>(data.size()), key);
+    }
+
+    // the binaries of other drivers are not compatible
+    if (auto functions = getFunctions())
+    {
+        key = hashString(*functions, GL_VENDOR, key);
+        key = hashString(*functions, GL_RENDERER, key);
+        key = hashString(*functions, GL_VERSION, key);
+    }
+
+    std::lock_guard lock(mMutex);
+    return QString("%1/%2.bin").arg(mDirectory).arg(QString::number(key, 16));
+}
+
+}
@@ -0,0 +1,234 @@
+#include "ProgramCompiler.h"
+#include "Program.h"
+
+#include <QOffscreenSurface>
+#include <QOpenGLExtraFunctions>
+#include <QThread>
+#include <algorithm>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+using MaxShaderCompilerThreads = void (QOPENGLF_APIENTRYP)(GLuint count);
+
+/** The count of threads which means the driver's maximum */
+constexpr GLuint MaxThreadsCount{0xFFFFFFFF};
+
+}
+
+ProgramCompiler::ProgramCompiler(QObject* parent) :
+    QObject(parent)
+{
+}
+
+ProgramCompiler::~ProgramCompiler()
+{
+    {
+        std::lock_guard lock(mMutex);
+        mIsRunning = false;
+    }
+
+    mCondition.notify_one();
+
+    if (mThread)
+    {
+        mThread->wait();
+        delete mThread;
+    }
+}
+
+void ProgramCompiler::initialize(QOpenGLContext* shareContext)
+{
+    if (mIsInitialized)
+    {
+        return;
+    }
+
+    mIsInitialized = true;
+
+    for (const char* extension : {"GL_KHR_parallel_shader_compile", "GL_ARB_parallel_shader_compile"})
+    {
+        if (!shareContext->hasExtension(extension))
+        {
+            continue;
+        }
+
+        auto function = std::string(extension).find("KHR") != std::string::npos
+                ? "glMaxShaderCompilerThreadsKHR"
+                : "glMaxShaderCompilerThreadsARB";
+
+        if (auto setThreadsCount = reinterpret_cast<MaxShaderCompilerThreads>(
+                    shareContext->getProcAddress(function)))
+        {
+            setThreadsCount(MaxThreadsCount);
+        }
+
+        mIsParallel = true;
+        return;
+    }
+
+    // the surface must be created by the GUI thread
+    mSurface = std::make_unique<QOffscreenSurface>();
+    mSurface->setFormat(shareContext->format());
+    mSurface->create();
+
+    mContext = std::make_unique<QOpenGLContext>();
+    mContext->setShareContext(shareContext);
+    mContext->setFormat(shareContext->format());
+    mContext->create();
+
+    mThread = QThread::create([this]() { compile(); });
+    mContext->moveToThread(mThread);
+    mThread->start();
+}
+
+void ProgramCompiler::submit(std::shared_ptr<Program> program)
+{
+    if (program->isSubmitted())
+    {
+        return;
+    }
+
+    if (!mIsInitialized)
+    {
+        program->initialize();
+        return;
+    }
+
+    if (program->submit())
+    {
+        return;
+    }
+
+    std::lock_guard lock(mMutex);
+
+    if (mIsParallel)
+    {
+        program->compile();
+    }
+    else
+    {
+        mQueue.push_back(program);
+        mCondition.notify_one();
+    }
+
+    mPending.push_back({std::move(program), nullptr});
+}
+
+std::size_t ProgramCompiler::poll()
+{
+    std::vector<std::shared_ptr<Program>> finished;
+    auto functions = QOpenGLContext::currentContext()->extraFunctions();
+
+    {
+        std::lock_guard lock(mMutex);
+
+        auto end = std::remove_if(mPending.begin(), mPending.end(), [&](Pending& pending)
+        {
+            if (mIsParallel)
+            {
+                if (!pending.program->isLinkCompleted())
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                if (!pending.fence || functions->glClientWaitSync(pending.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                {
+                    return false;
+                }
+
+                functions->glDeleteSync(pending.fence);
+            }
+
+            finished.push_back(std::move(pending.program));
+            return true;
+        });
+
+        mPending.erase(end, mPending.end());
+    }
+
+    for (const auto& program : finished)
+    {
+        program->finish();
+    }
+
+    return finished.size();
+}
+
+std::size_t ProgramCompiler::getPendingCount() const
+{
+    std::lock_guard lock(mMutex);
+    return mPending.size();
+}
+
+bool ProgramCompiler::isParallel() const
+{
+    return mIsParallel;
+}
+
+void ProgramCompiler::compile()
+{
+    mContext->makeCurrent(mSurface.get());
+    QOpenGLExtraFunctions functions(mContext.get());
+
+    std::unique_lock lock(mMutex);
+
+    while (true)
+    {
+        mCondition.wait(lock, [this]() { return !mIsRunning || !mQueue.empty(); });
+
+        if (!mIsRunning)
+        {
+            break;
+        }
+
+        auto program = std::move(mQueue.front());
+        mQueue.pop_front();
+
+        lock.unlock();
+
+        program->compile();
+
+        // the status waits for the link, so the fence is put after the finished link
+        GLint isLinked{GL_FALSE};
+        functions.glGetProgramiv(program->programId(), GL_LINK_STATUS, &isLinked);
+
+        // the fence is seen by the other contexts after the commands are flushed
+        auto fence = functions.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        functions.glFlush();
+
+        lock.lock();
+
+        auto pending = std::find_if(mPending.begin(), mPending.end(), [&](const Pending& pending)
+        {
+            return pending.program == program;
+        });
+        pending->fence = fence;
+
+        lock.unlock();
+
+        emit compiled();
+
+        lock.lock();
+    }
+
+    // the programs which are not finished are dropped with their fences
+    for (auto& pending : mPending)
+    {
+        if (pending.fence)
+        {
+            functions.glDeleteSync(pending.fence);
+            pending.fence = nullptr;
+        }
+    }
+
+    lock.unlock();
+    mContext->doneCurrent();
+}
+
+}
@@ -44,6 +44,11 @@ void ProjectionOrtho::setRatio(float ratio)
     calculate();
 }
 
+std::shared_ptr<Projection> ProjectionOrtho::clone() const
+{
+    return std::make_shared<ProjectionOrtho>(*this);
+}
+
 void ProjectionOrtho::setXRange(float min, float max)
 {
     mMinX = min;
@@ -133,6 +138,11 @@ void ProjectionPerspective::setRatio(float ratio)
     calculate();
 }
 
+std::shared_ptr<Projection> ProjectionPerspective::clone() const
+{
+    return std::make_shared<ProjectionPerspective>(*this);
+}
+
 void ProjectionPerspective::setAlfa(float alfa)
 {
     mAlfa = alfa;
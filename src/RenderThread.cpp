@@ -0,0 +1,376 @@
+#include "RenderThread.h"
+#include "Scene.h"
+#include "ScenePipe.h"
+#include "SceneGraph.h"
+#include "ScenePreparer.h"
+#include "ProgramCompiler.h"
+#include "TextureManager.h"
+#include "Camera.h"
+#include "Memory.h"
+#include "ContextGuard.h"
+
+#include <QDebug>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QThread>
+
+namespace custom_scene
+{
+
+RenderThread::RenderThread(std::shared_ptr<Scene> scene,
+                           ScenePreparer* preparer,
+                           ProgramCompiler* compiler,
+                           std::shared_ptr<TextureManager> textureManager,
+                           const Color& background,
+                           int samplesCount,
+                           QObject* parent) :
+    QObject(parent),
+    mScene(std::move(scene)),
+    mPreparer(preparer),
+    mCompiler(compiler),
+    mTextureManager(std::move(textureManager)),
+    mBackground(background),
+    mSamplesCount(samplesCount)
+{
+}
+
+RenderThread::~RenderThread()
+{
+    stop();
+}
+
+void RenderThread::start(QOpenGLContext* shareContext)
+{
+    if (mThread)
+    {
+        return;
+    }
+
+    // the surface must be created by the GUI thread
+    mSurface = std::make_unique<QOffscreenSurface>();
+    mSurface->setFormat(shareContext->format());
+    mSurface->create();
+
+    mContext = std::make_unique<QOpenGLContext>();
+    mContext->setShareContext(shareContext);
+    mContext->setFormat(shareContext->format());
+    mContext->create();
+
+    mIsRunning = true;
+
+    mThread = QThread::create([this]() { run(); });
+    mContext->moveToThread(mThread);
+    mThread->start();
+}
+
+void RenderThread::stop()
+{
+    if (!mThread)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lock(mRequestMutex);
+        mIsRunning = false;
+    }
+
+    mRequestCondition.notify_one();
+
+    mThread->wait();
+    delete mThread;
+    mThread = nullptr;
+}
+
+void RenderThread::setCamera(const Camera& camera)
+{
+    mCameras.getBack() = camera.getSnapshot();
+    mCameras.publish();
+
+    requestFrame();
+}
+
+void RenderThread::requestFrame()
+{
+    {
+        std::lock_guard lock(mRequestMutex);
+        mIsRequested = true;
+    }
+
+    mRequestCondition.notify_one();
+}
+
+RenderThread::Frame* RenderThread::acquireFrame()
+{
+    mFrames.update();
+
+    auto& frame = mFrames.getFront();
+    return frame.texture ? &frame : nullptr;
+}
+
+void RenderThread::run()
+{
+    mContext->makeCurrent(mSurface.get());
+    initializeOpenGLFunctions();
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    std::unique_lock lock(mRequestMutex);
+
+    while (true)
+    {
+        mRequestCondition.wait(lock, [this]() { return !mIsRunning || mIsRequested; });
+
+        if (!mIsRunning)
+        {
+            break;
+        }
+
+        mIsRequested = false;
+
+        lock.unlock();
+        renderFrame();
+        lock.lock();
+    }
+
+    lock.unlock();
+
+    // the pipes outlive the thread's context, so their objects are released by it
+    release();
+    ContextGuard::releaseAll();
+    mContext->doneCurrent();
+}
+
+void RenderThread::renderFrame()
+{
+    ContextGuard::collect();
+
+    if (mCameras.update())
+    {
+        mCamera = mCameras.getFront();
+    }
+
+    if (!mCamera)
+    {
+        return;
+    }
+
+    auto [width, height] = mCamera->getViewPortSize();
+    if (width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    resizeBuffers(width, height);
+
+    mHeapCheck.begin();
+    auto snapshot = mScene->acquire();
+
+    for (const auto& pipe : snapshot->pipes)
+    {
+        if (!pipe->isInitialized())
+        {
+            // the buffers are uploaded while the program is linked
+            if (mCompiler)
+            {
+                mCompiler->submit(pipe->getProgram());
+            }
+
+            pipe->setTextureManager(mTextureManager);
+            pipe->initialize();
+        }
+
+        if (!pipe->isAllocated())
+        {
+            pipe->realocate();
+        }
+    }
+
+    // the rest of the prepared items is added by the next frames
+    if (mPreparer)
+    {
+        mPreparer->commit(PreparationBudget);
+
+        if (mPreparer->hasUploaded())
+        {
+            requestFrame();
+        }
+    }
+
+    // the scene's textures are packed before the materials ask for them
+    if (mTextureManager)
+    {
+        mTextureManager->update(snapshot->textures);
+    }
+
+    // the pipe is rendered by the frame which follows its program's link
+    if (mCompiler)
+    {
+        mCompiler->poll();
+
+        if (mCompiler->getPendingCount() > 0)
+        {
+            requestFrame();
+        }
+    }
+
+    mScene->getSceneGraph()->update();
+
+    memory::getFrameArena().reset();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glViewport(0, 0, width, height);
+    glClearColor(mBackground.redF(),
+                 mBackground.greenF(),
+                 mBackground.blueF(),
+                 mBackground.alphaF());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    for (const auto& pipe : snapshot->pipes)
+    {
+        if (pipe->isReady())
+        {
+            pipe->render(mCamera, snapshot->lights, snapshot->textures);
+        }
+    }
+
+    auto& frame = mFrames.getBack();
+
+    // the frame which is not taken by the view is overwritten
+    if (frame.renderFence)
+    {
+        glDeleteSync(frame.renderFence);
+        frame.renderFence = nullptr;
+    }
+
+    // the view may still sample the frame which it has just released
+    if (frame.compositeFence)
+    {
+        glWaitSync(frame.compositeFence, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(frame.compositeFence);
+        frame.compositeFence = nullptr;
+    }
+
+    resizeFrame(frame, width, height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame.framebuffer);
+    glBlitFramebuffer(0, 0, width, height,
+                      0, 0, width, height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // the fence is seen by the view's context after the commands are flushed
+    frame.renderFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    mFrames.publish();
+
+    if (!mHeapCheck.end(snapshot->version))
+    {
+        qWarning() << "RenderThread::renderFrame the warmed up frame called operator new"
+                   << mHeapCheck.getCount() << "times";
+    }
+
+    emit frameReady();
+}
+
+void RenderThread::resizeBuffers(int width, int height)
+{
+    if (mFramebuffer && mWidth == width && mHeight == height)
+    {
+        return;
+    }
+
+    if (!mFramebuffer)
+    {
+        glGenFramebuffers(1, &mFramebuffer);
+        glGenRenderbuffers(1, &mColorBuffer);
+        glGenRenderbuffers(1, &mDepthBuffer);
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, mColorBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, mSamplesCount, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, mDepthBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER,
+                                     mSamplesCount,
+                                     GL_DEPTH24_STENCIL8,
+                                     width,
+                                     height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                              GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER,
+                              mColorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                              GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER,
+                              mDepthBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    mWidth = width;
+    mHeight = height;
+}
+
+void RenderThread::resizeFrame(Frame& frame, int width, int height)
+{
+    if (frame.texture && frame.width == width && frame.height == height)
+    {
+        return;
+    }
+
+    if (!frame.texture)
+    {
+        glGenTextures(1, &frame.texture);
+        glGenFramebuffers(1, &frame.framebuffer);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, frame.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, frame.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D,
+                           frame.texture,
+                           0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    frame.width = width;
+    frame.height = height;
+}
+
+void RenderThread::release()
+{
+    for (auto& frame : mFrames.getValues())
+    {
+        if (frame.renderFence)
+        {
+            glDeleteSync(frame.renderFence);
+        }
+        if (frame.compositeFence)
+        {
+            glDeleteSync(frame.compositeFence);
+        }
+
+        glDeleteFramebuffers(1, &frame.framebuffer);
+        glDeleteTextures(1, &frame.texture);
+
+        frame = Frame();
+    }
+
+    glDeleteFramebuffers(1, &mFramebuffer);
+    glDeleteRenderbuffers(1, &mColorBuffer);
+    glDeleteRenderbuffers(1, &mDepthBuffer);
+
+    mFramebuffer = mColorBuffer = mDepthBuffer = 0;
+    mCamera = nullptr;
+}
+
+}
@@ -1,146 +1,371 @@
 #include "Scene.h"
 #include "Item.h"
-#include "Pipe.h"
+#include "ScenePipe.h"
+#include "MeshRegistry.h"
+#include "SceneGraph.h"
 
 namespace custom_scene
 {
 
 Scene::Scene(const Pipes& pipes, QObject* parent) :
-    QObject(parent)
+    QObject(parent),
+    mMeshRegistry(std::make_shared<MeshRegistry>()),
+    mSceneGraph(std::make_shared<SceneGraph>()),
+    mSnapshot(std::make_shared<Snapshot>())
 {
+    qRegisterMetaType<custom_scene::Changes>("custom_scene::Changes");
+
     addPipes(pipes);
 }
 
 void Scene::addPipe(std::shared_ptr<ScenePipe> pipe, bool isNotify)
 {
+    auto lock = lockStaging();
+    mOperations.push_back({Operation::kAttach, pipe, nullptr, nullptr});
     mPipes.push_back(pipe);
-    if (isNotify)
-    {
-        emit changed();
-    }
+    mJournal.addPipe(pipe);
+    notify(lock, isNotify);
 }
 
 void Scene::addPipes(const Scene::Pipes& pipes, bool isNotify)
 {
+    auto lock = lockStaging();
     for (auto& pipe : pipes)
     {
+        mOperations.push_back({Operation::kAttach, pipe, nullptr, nullptr});
         mPipes.push_back(pipe);
+        mJournal.addPipe(pipe);
     }
 
-    if (isNotify)
-    {
-        emit changed();
-    }
+    notify(lock, isNotify);
 }
 
 void Scene::removePipe(std::shared_ptr<ScenePipe> pipe, bool isNotify)
 {
+    auto lock = lockStaging();
     mPipes.remove(pipe);
+    mJournal.removePipe(pipe);
 
-    if (isNotify)
-    {
-        emit changed();
-    }
+    notify(lock, isNotify);
 }
 
 void Scene::removePipes(bool isNotify)
 {
-    mPipes.clear();
-
-    if (isNotify)
+    auto lock = lockStaging();
+    for (const auto& pipe : mPipes)
     {
-        emit changed();
+        mJournal.removePipe(pipe);
     }
+    mPipes.clear();
+
+    notify(lock, isNotify);
 }
 
 void Scene::addLight(std::shared_ptr<Light> light, bool isNotify)
 {
+    auto lock = lockStaging();
     mLights.push_back(light);
+    mJournal.addLight(light);
 
-    if (isNotify)
-    {
-        emit changed();
-    }
+    notify(lock, isNotify);
 }
 
 void Scene::addLights(const Scene::Lights& lights, bool isNotify)
 {
+    auto lock = lockStaging();
     for (auto& light : lights)
     {
         mLights.push_back(light);
+        mJournal.addLight(light);
     }
 
-    if (isNotify)
-    {
-        emit changed();
-    }
+    notify(lock, isNotify);
 }
 
 void Scene::removeLight(std::shared_ptr<Light> light, bool isNotify)
 {
+    auto lock = lockStaging();
     mLights.remove(light);
+    mJournal.removeLight(light);
 
-    if (isNotify)
-    {
-        emit changed();
-    }
+    notify(lock, isNotify);
 }
 
 void Scene::removeLights(bool isNotify)
 {
-    mLights.clear();
-
-    if (isNotify)
+    auto lock = lockStaging();
+    for (const auto& light : mLights)
     {
-        emit changed();
+        mJournal.removeLight(light);
     }
+    mLights.clear();
+
+    notify(lock, isNotify);
 }
 
 void Scene::addTexture(std::shared_ptr<Texture> texture, bool isNotify)
 {
+    auto lock = lockStaging();
     mTextures.push_back(texture);
+    mJournal.addTexture(texture);
+
+    notify(lock, isNotify);
+}
 
-    if (isNotify)
+void Scene::addTextures(const Scene::Textures& textures, bool isNotify)
+{
+    auto lock = lockStaging();
+    for (auto& texture : textures)
     {
-        emit changed();
+        mTextures.push_back(texture);
+        mJournal.addTexture(texture);
     }
+
+    notify(lock, isNotify);
 }
 
 void Scene::removeTexture(std::shared_ptr<Texture> texture, bool isNotify)
 {
+    auto lock = lockStaging();
     mTextures.remove(texture);
+    mJournal.removeTexture(texture);
 
-    if (isNotify)
-    {
-        emit changed();
-    }
+    notify(lock, isNotify);
 }
 
 void Scene::removeTextures(bool isNotify)
 {
+    auto lock = lockStaging();
+    for (const auto& texture : mTextures)
+    {
+        mJournal.removeTexture(texture);
+    }
     mTextures.clear();
 
-    if (isNotify)
+    notify(lock, isNotify);
+}
+
+void Scene::addItem(std::shared_ptr<ScenePipe> pipe,
+                    std::shared_ptr<Item> item,
+                    bool isNotify)
+{
+    auto lock = lockStaging();
+    mOperations.push_back({Operation::kAdd, pipe, item, nullptr});
+    mJournal.addItem(pipe, item);
+
+    notify(lock, isNotify);
+}
+
+void Scene::addItems(std::shared_ptr<ScenePipe> pipe,
+                     const std::vector<std::shared_ptr<Item>>& items,
+                     bool isNotify)
+{
+    auto lock = lockStaging();
+    for (const auto& item : items)
     {
-        emit changed();
+        mOperations.push_back({Operation::kAdd, pipe, item, nullptr});
+        mJournal.addItem(pipe, item);
     }
+
+    notify(lock, isNotify);
+}
+
+void Scene::removeItem(std::shared_ptr<ScenePipe> pipe,
+                       std::shared_ptr<Item> item,
+                       bool isNotify)
+{
+    auto lock = lockStaging();
+    mOperations.push_back({Operation::kRemove, pipe, item, nullptr});
+    mJournal.removeItem(pipe, item);
+
+    notify(lock, isNotify);
+}
+
+void Scene::updateItem(std::shared_ptr<ScenePipe> pipe,
+                       std::shared_ptr<Item> item,
+                       bool isNotify)
+{
+    auto lock = lockStaging();
+    mOperations.push_back({Operation::kUpdate, pipe, item, nullptr});
+    mJournal.modifyItem(pipe, item);
+
+    notify(lock, isNotify);
+}
+
+void Scene::changeItem(std::shared_ptr<ScenePipe> pipe,
+                       std::shared_ptr<Item> item,
+                       ItemChange change,
+                       bool isNotify)
+{
+    auto lock = lockStaging();
+    mOperations.push_back({Operation::kChange, pipe, item, std::move(change)});
+    mJournal.modifyItem(pipe, item);
+
+    notify(lock, isNotify);
 }
 
 void Scene::clear(bool isNotify)
 {
-    removePipes(false);
-    removeLights(false);
-    removeTextures(false);
+    auto lock = lockStaging();
 
-    if (isNotify)
+    for (const auto& pipe : mPipes)
+    {
+        mJournal.removePipe(pipe);
+    }
+    for (const auto& light : mLights)
+    {
+        mJournal.removeLight(light);
+    }
+    for (const auto& texture : mTextures)
     {
-        emit changed();
+        mJournal.removeTexture(texture);
     }
+
+    mPipes.clear();
+    mLights.clear();
+    mTextures.clear();
+    mSceneGraph->clear();
+
+    notify(lock, isNotify);
 }
 
 void Scene::update()
 {
-    emit changed();
+    auto lock = lockStaging();
+    publish(lock);
+}
+
+void Scene::begin()
+{
+    auto lock = lockStaging();
+    mTransactionsCount++;
+}
+
+void Scene::commit()
+{
+    auto lock = lockStaging();
+
+    if (mTransactionsCount > 0 && --mTransactionsCount == 0 && !mJournal.isEmpty())
+    {
+        publish(lock);
+    }
+}
+
+std::shared_ptr<const Scene::Snapshot> Scene::acquire()
+{
+    std::vector<ItemOperation> operations;
+    std::shared_ptr<const Snapshot> snapshot;
+
+    {
+        auto lock = lockStaging();
+        operations.swap(mPublishedOperations);
+        snapshot = std::move(mPendingSnapshot);
+
+        // the items' changes start the new version, so the frames are warmed up again
+        if (!operations.empty())
+        {
+            auto changed = std::make_shared<Snapshot>(snapshot ? *snapshot : *mSnapshot);
+            changed->version = mStats.snapshotsCount++;
+            snapshot = std::move(changed);
+        }
+
+        mStats.acquiresCount++;
+        mStats.operationsCount += operations.size();
+        mStats.pendingOperationsCount = 0;
+    }
+
+    // the pipes and items are changed by the renderer only, so the producers are not waited for
+    for (const auto& [operation, pipe, item, change] : operations)
+    {
+        switch (operation)
+        {
+            case Operation::kAdd:
+                pipe->addItem(item);
+                break;
+            case Operation::kRemove:
+                pipe->removeItem(item);
+                break;
+            case Operation::kUpdate:
+                pipe->updateItem(item);
+                break;
+            case Operation::kChange:
+                change(*item);
+                break;
+            case Operation::kAttach:
+                pipe->setMeshRegistry(mMeshRegistry);
+                break;
+        }
+    }
+
+    if (snapshot)
+    {
+        std::atomic_store(&mSnapshot, snapshot);
+        return snapshot;
+    }
+
+    return std::atomic_load(&mSnapshot);
+}
+
+std::shared_ptr<const Scene::Snapshot> Scene::getSnapshot() const
+{
+    return std::atomic_load(&mSnapshot);
+}
+
+Scene::Stats Scene::getStats() const
+{
+    std::lock_guard lock(mMutex);
+    return mStats;
+}
+
+Scene::Lock Scene::lockStaging()
+{
+    Lock lock(mMutex, std::try_to_lock);
+
+    if (!lock.owns_lock())
+    {
+        lock.lock();
+        mStats.contentionsCount++;
+    }
+
+    return lock;
+}
+
+void Scene::notify(Lock& lock, bool isNotify)
+{
+    if (isNotify && mTransactionsCount == 0)
+    {
+        publish(lock);
+    }
+}
+
+void Scene::publish(Lock& lock)
+{
+    auto changes = mJournal.take();
+
+    // the snapshot shares the objects, only the lists are copied
+    if (!changes.pipes.isEmpty() || !changes.lights.isEmpty() || !changes.textures.isEmpty())
+    {
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->pipes = mPipes;
+        snapshot->lights = mLights;
+        snapshot->textures = mTextures;
+        snapshot->version = mStats.snapshotsCount++;
+
+        mPendingSnapshot = std::move(snapshot);
+    }
+
+    mPublishedOperations.insert(mPublishedOperations.end(),
+                                std::make_move_iterator(mOperations.begin()),
+                                std::make_move_iterator(mOperations.end()));
+    mOperations.clear();
+
+    mStats.publishesCount++;
+    mStats.pendingOperationsCount = mPublishedOperations.size();
+
+    lock.unlock();
+
+    // the receivers in other threads get the changes by the queued connections
+    emit changed(changes);
 }
 
 const Scene::Pipes& Scene::getPipes() const
@@ -158,4 +383,14 @@ const Scene::Textures& Scene::getTextures() const
     return mTextures;
 }
 
+std::shared_ptr<MeshRegistry> Scene::getMeshRegistry() const
+{
+    return mMeshRegistry;
+}
+
+std::shared_ptr<SceneGraph> Scene::getSceneGraph() const
+{
+    return mSceneGraph;
+}
+
 }
@@ -0,0 +1,391 @@
+#include "SceneGraph.h"
+#include "Item.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+/** The count of the nodes computed by one task, the smaller levels are computed in place */
+constexpr std::size_t ChunkSize{4096};
+
+}
+
+SceneGraph::Handle SceneGraph::addNode(const Mat4& local,
+                                       Handle parent,
+                                       std::shared_ptr<Item> item)
+{
+    std::lock_guard lock(mMutex);
+
+    Handle handle;
+
+    if (!mFreeHandles.empty())
+    {
+        handle = mFreeHandles.back();
+        mFreeHandles.pop_back();
+    }
+    else
+    {
+        handle = static_cast<Handle>(mIndices.size());
+        mIndices.push_back(InvalidIndex);
+        mParentHandles.push_back(InvalidHandle);
+        mFirstChildren.push_back(InvalidHandle);
+        mNextSiblings.push_back(InvalidHandle);
+    }
+
+    // the node is appended, its place by depth is found by the next update
+    mIndices[handle] = static_cast<uint>(mHandles.size());
+    mParentHandles[handle] = InvalidHandle;
+    mFirstChildren[handle] = InvalidHandle;
+    mNextSiblings[handle] = InvalidHandle;
+
+    mHandles.push_back(handle);
+    mParents.push_back(InvalidIndex);
+    mLocals.push_back(local);
+    mWorlds.push_back(local);
+    mStamps.push_back(mStamp);
+    mItems.push_back(std::move(item));
+
+    mNodesCount++;
+    mIsReordered = true;
+
+    if (contains(parent))
+    {
+        mParentHandles[handle] = parent;
+        mNextSiblings[handle] = mFirstChildren[parent];
+        mFirstChildren[parent] = handle;
+    }
+
+    return handle;
+}
+
+SceneGraph::Handle SceneGraph::addItem(std::shared_ptr<Item> item, Handle parent)
+{
+    auto local = item->getTransformation();
+    return addNode(local, parent, std::move(item));
+}
+
+void SceneGraph::removeNode(Handle handle)
+{
+    std::lock_guard lock(mMutex);
+
+    if (!contains(handle))
+    {
+        return;
+    }
+
+    unlink(handle);
+
+    std::vector<Handle> nodes{handle};
+
+    while (!nodes.empty())
+    {
+        auto node = nodes.back();
+        nodes.pop_back();
+
+        for (auto child = mFirstChildren[node]; child != InvalidHandle; child = mNextSiblings[child])
+        {
+            nodes.push_back(child);
+        }
+
+        mItems[mIndices[node]] = nullptr;
+        mIndices[node] = InvalidIndex;
+        mFreeHandles.push_back(node);
+        mNodesCount--;
+    }
+
+    mIsReordered = true;
+}
+
+void SceneGraph::setParent(Handle handle, Handle parent)
+{
+    std::lock_guard lock(mMutex);
+
+    if (!contains(handle) || mParentHandles[handle] == parent)
+    {
+        return;
+    }
+
+    for (auto ancestor = parent; contains(ancestor); ancestor = mParentHandles[ancestor])
+    {
+        if (ancestor == handle)
+        {
+            return;
+        }
+    }
+
+    unlink(handle);
+
+    if (contains(parent))
+    {
+        mParentHandles[handle] = parent;
+        mNextSiblings[handle] = mFirstChildren[parent];
+        mFirstChildren[parent] = handle;
+    }
+
+    mStamps[mIndices[handle]] = mStamp;
+    mIsReordered = true;
+}
+
+void SceneGraph::setLocalTransformation(Handle handle, const Mat4& local)
+{
+    std::lock_guard lock(mMutex);
+
+    if (!contains(handle))
+    {
+        return;
+    }
+
+    auto index = mIndices[handle];
+    mLocals[index] = local;
+    mStamps[index] = mStamp;
+    mFirstChanged = std::min(mFirstChanged, index);
+}
+
+void SceneGraph::update()
+{
+    std::lock_guard lock(mMutex);
+
+    if (mIsReordered)
+    {
+        reorder();
+    }
+
+    mUpdatedCount = 0;
+
+    if (mFirstChanged == InvalidIndex)
+    {
+        return;
+    }
+
+    auto level = static_cast<std::size_t>(
+                std::upper_bound(mLevels.begin(), mLevels.end() - 1, mFirstChanged) -
+                mLevels.begin() - 1);
+
+    // the parents are computed by the previous level, the level's nodes are independent
+    for (; level + 1 < mLevels.size(); level++)
+    {
+        std::size_t first = mLevels[level];
+        std::size_t last = mLevels[level + 1];
+        auto chunksCount = (last - first + ChunkSize - 1) / ChunkSize;
+
+        if (chunksCount < 2)
+        {
+            mUpdatedCount += updateNodes(first, last);
+            continue;
+        }
+
+        std::atomic<std::size_t> updatedCount{0};
+
+        utils::parallelFor(chunksCount, [&](std::size_t chunk, uint)
+        {
+            auto chunkFirst = first + chunk * ChunkSize;
+            updatedCount += updateNodes(chunkFirst, std::min(chunkFirst + ChunkSize, last));
+        });
+
+        mUpdatedCount += updatedCount;
+    }
+
+    mStamp++;
+    mFirstChanged = InvalidIndex;
+}
+
+void SceneGraph::clear()
+{
+    std::lock_guard lock(mMutex);
+
+    mIndices.clear();
+    mParentHandles.clear();
+    mFirstChildren.clear();
+    mNextSiblings.clear();
+    mFreeHandles.clear();
+    mHandles.clear();
+    mParents.clear();
+    mLocals.clear();
+    mWorlds.clear();
+    mStamps.clear();
+    mItems.clear();
+    mLevels.clear();
+    mFirstChanged = InvalidIndex;
+    mNodesCount = 0;
+    mUpdatedCount = 0;
+    mIsReordered = false;
+}
+
+bool SceneGraph::isValid(Handle handle) const
+{
+    std::lock_guard lock(mMutex);
+    return contains(handle);
+}
+
+SceneGraph::Handle SceneGraph::getParent(Handle handle) const
+{
+    std::lock_guard lock(mMutex);
+    return mParentHandles.at(handle);
+}
+
+Mat4 SceneGraph::getLocalTransformation(Handle handle) const
+{
+    std::lock_guard lock(mMutex);
+    return mLocals.at(mIndices.at(handle));
+}
+
+Mat4 SceneGraph::getWorldTransformation(Handle handle) const
+{
+    std::lock_guard lock(mMutex);
+    return mWorlds.at(mIndices.at(handle));
+}
+
+std::size_t SceneGraph::getNodesCount() const
+{
+    std::lock_guard lock(mMutex);
+    return mNodesCount;
+}
+
+std::size_t SceneGraph::getLevelsCount() const
+{
+    std::lock_guard lock(mMutex);
+    return mLevels.empty() ? 0 : mLevels.size() - 1;
+}
+
+std::size_t SceneGraph::getUpdatedCount() const
+{
+    std::lock_guard lock(mMutex);
+    return mUpdatedCount;
+}
+
+bool SceneGraph::contains(Handle handle) const
+{
+    return handle < mIndices.size() && mIndices[handle] != InvalidIndex;
+}
+
+void SceneGraph::unlink(Handle handle)
+{
+    auto parent = mParentHandles[handle];
+
+    if (parent == InvalidHandle)
+    {
+        return;
+    }
+
+    auto* link = &mFirstChildren[parent];
+    while (*link != handle)
+    {
+        link = &mNextSiblings[*link];
+    }
+
+    *link = mNextSiblings[handle];
+    mParentHandles[handle] = InvalidHandle;
+    mNextSiblings[handle] = InvalidHandle;
+}
+
+void SceneGraph::reorder()
+{
+    std::vector<uint> indices(mIndices.size(), InvalidIndex);
+    std::vector<Handle> handles;
+    std::vector<uint> parents;
+    std::vector<Mat4> locals;
+    std::vector<Mat4> worlds;
+    std::vector<std::uint32_t> stamps;
+    std::vector<std::shared_ptr<Item>> items;
+
+    handles.reserve(mNodesCount);
+    parents.reserve(mNodesCount);
+    locals.reserve(mNodesCount);
+    worlds.reserve(mNodesCount);
+    stamps.reserve(mNodesCount);
+    items.reserve(mNodesCount);
+
+    std::vector<Handle> current;
+    std::vector<Handle> next;
+
+    for (Handle handle = 0; handle < mIndices.size(); handle++)
+    {
+        if (mIndices[handle] != InvalidIndex && mParentHandles[handle] == InvalidHandle)
+        {
+            current.push_back(handle);
+        }
+    }
+
+    mLevels.clear();
+
+    while (!current.empty())
+    {
+        mLevels.push_back(static_cast<uint>(handles.size()));
+        next.clear();
+
+        for (auto handle : current)
+        {
+            auto index = mIndices[handle];
+            auto parent = mParentHandles[handle];
+
+            indices[handle] = static_cast<uint>(handles.size());
+            handles.push_back(handle);
+            parents.push_back(parent != InvalidHandle ? indices[parent] : InvalidIndex);
+            locals.push_back(mLocals[index]);
+            worlds.push_back(mWorlds[index]);
+            stamps.push_back(mStamps[index]);
+            items.push_back(std::move(mItems[index]));
+
+            for (auto child = mFirstChildren[handle]; child != InvalidHandle; child = mNextSiblings[child])
+            {
+                next.push_back(child);
+            }
+        }
+
+        std::swap(current, next);
+    }
+
+    mLevels.push_back(static_cast<uint>(handles.size()));
+
+    mIndices = std::move(indices);
+    mHandles = std::move(handles);
+    mParents = std::move(parents);
+    mLocals = std::move(locals);
+    mWorlds = std::move(worlds);
+    mStamps = std::move(stamps);
+    mItems = std::move(items);
+
+    auto changed = std::find(mStamps.begin(), mStamps.end(), mStamp);
+    mFirstChanged = changed != mStamps.end()
+            ? static_cast<uint>(changed - mStamps.begin())
+            : InvalidIndex;
+
+    mIsReordered = false;
+}
+
+std::size_t SceneGraph::updateNodes(std::size_t first, std::size_t last)
+{
+    std::size_t updatedCount{0};
+
+    for (auto index = first; index < last; index++)
+    {
+        auto parent = mParents[index];
+        auto isChanged = mStamps[index] == mStamp ||
+                (parent != InvalidIndex && mStamps[parent] == mStamp);
+
+        if (!isChanged)
+        {
+            continue;
+        }
+
+        mStamps[index] = mStamp;
+        mWorlds[index] = parent != InvalidIndex ? mWorlds[parent] * mLocals[index] : mLocals[index];
+
+        if (mItems[index])
+        {
+            mItems[index]->setTransformation(mWorlds[index]);
+        }
+
+        updatedCount++;
+    }
+
+    return updatedCount;
+}
+
+}
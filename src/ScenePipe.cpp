@@ -4,10 +4,31 @@
 #include "Program.h"
 #include "Camera.h"
 #include "Light.h"
+#include "Memory.h"
+#include "MeshRegistry.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <unordered_set>
 
 namespace custom_scene
 {
 
+namespace
+{
+
+/** The count of the items from which the packets are built by the shared workers */
+constexpr std::size_t ParallelPacketsCount{16384};
+constexpr std::size_t PacketsChunkSize{4096};
+
+std::size_t getRangeSize(const Pipe::Range& range)
+{
+    return range.verticesCount * sizeof(Vertex) +
+           range.indicesCount * sizeof(uint);
+}
+
+}
+
 ScenePipe::ScenePipe(std::shared_ptr<Program> program,
                      const std::vector<Pipe::Attribute>& attributes,
                      const Items& items) :
@@ -18,7 +39,8 @@ ScenePipe::ScenePipe(std::shared_ptr<Program> program,
 
 void ScenePipe::addItem(std::shared_ptr<Item> item)
 {
-    mItems.push_back(item);
+    internMesh(*item);
+    mItems.add(item);
     mIsAllocated = false;
 }
 
@@ -26,31 +48,276 @@ void ScenePipe::addItems(const Items &items)
 {
     for(auto& item : items)
     {
-        mItems.push_back(item);
+        internMesh(*item);
+        mItems.add(item);
     }
     mIsAllocated = false;
 }
 
 void ScenePipe::removeItem(std::shared_ptr<Item> item)
 {
-    mItems.remove(item);
+    mItems.remove(*item);
+
+    auto range = mItemRanges.find(item);
+    if (range != mItemRanges.end())
+    {
+        mWastedSize += getRangeSize(range->second);
+        mItemRanges.erase(range);
+    }
+
+    mIsAllocated = false;
+}
+
+void ScenePipe::addStagedItem(std::shared_ptr<Item> item, GLuint buffer)
+{
+    internMesh(*item);
+
+    const auto& mesh = item->getMesh();
+    auto [range, isInserted] = mMeshRanges.try_emplace(mesh);
+
+    if (isInserted)
+    {
+        bind();
+        range->second = reserve(static_cast<uint>(mesh->getVertices().size()),
+                                static_cast<uint>(mesh->getIndices().size()));
+        copy(range->second, buffer, 0, mesh->getVertices().size() * sizeof(Vertex));
+        release();
+    }
+
+    mItems.add(item);
+    item->updateIndices(range->second.startIndex, range->second.baseVertex);
+}
+
+void ScenePipe::updateItem(std::shared_ptr<Item> item)
+{
+    internMesh(*item);
     mIsAllocated = false;
 }
 
 void ScenePipe::clear()
 {
     mItems.clear();
-    mIsAllocated = false;
+    mMeshRanges.clear();
+    mItemRanges.clear();
+    mWastedSize = 0;
+    reset();
 }
 
 void ScenePipe::realocate()
 {
-    Mesh mesh;
-    for (auto& item : mItems)
+    memory::ArenaScope scope(memory::getTransientArena());
+
+    releaseUnusedRanges(scope.getResource());
+
+    bind();
+
+    if (mWastedSize > getAllocatedSize() / 2)
+    {
+        compactRanges();
+    }
+
+    using MeshRange = std::pair<const Mesh*, Range*>;
+    std::pmr::vector<MeshRange> newRanges(scope.getResource());
+    uint verticesCount{0};
+    uint indicesCount{0};
+
+    for (auto& item : mItems.getItems())
+    {
+        const auto& mesh = item->getMesh();
+
+        if (!mesh)
+        {
+            continue;
+        }
+
+        auto [range, isInserted] = mMeshRanges.try_emplace(mesh);
+
+        if (isInserted)
+        {
+            range->second = {verticesCount,
+                             static_cast<uint>(mesh->getVertices().size()),
+                             indicesCount,
+                             static_cast<uint>(mesh->getIndices().size())};
+            verticesCount += range->second.verticesCount;
+            indicesCount += range->second.indicesCount;
+            newRanges.emplace_back(mesh.get(), &range->second);
+        }
+    }
+
+    if (!newRanges.empty())
+    {
+        auto range = reserve(verticesCount, indicesCount);
+        auto vertices = mapVertices(range);
+        auto indices = mapIndices(range);
+
+        for (auto& [mesh, meshRange] : newRanges)
+        {
+            std::copy(mesh->getVertices().begin(),
+                      mesh->getVertices().end(),
+                      vertices + meshRange->baseVertex);
+            std::copy(mesh->getIndices().begin(),
+                      mesh->getIndices().end(),
+                      indices + meshRange->startIndex);
+
+            meshRange->baseVertex += range.baseVertex;
+            meshRange->startIndex += range.startIndex;
+        }
+
+        unmap();
+    }
+
+    release();
+
+    for (auto& item : mItems.getItems())
+    {
+        if (const auto& mesh = item->getMesh())
+        {
+            const auto& range = mMeshRanges.at(mesh);
+            item->updateIndices(range.startIndex, range.baseVertex);
+        }
+        else if (auto range = mItemRanges.find(item);
+                 range != mItemRanges.end())
+        {
+            item->updateIndices(range->second.startIndex,
+                                range->second.indicesCount,
+                                range->second.baseVertex);
+        }
+    }
+
+    mIsAllocated = true;
+}
+
+MeshWriter ScenePipe::map(std::shared_ptr<Item> item,
+                          uint verticesCount,
+                          uint indicesCount)
+{
+    auto range = mItemRanges.find(item);
+    if (range != mItemRanges.end())
+    {
+        mWastedSize += getRangeSize(range->second);
+        mItemRanges.erase(range);
+    }
+
+    mItems.add(item);
+
+    item->setMesh(nullptr);
+
+    bind();
+
+    return MeshWriter(*this,
+                      reserve(verticesCount, indicesCount),
+                      [this, item](const Range& range)
+                      {
+                          mItemRanges[item] = range;
+                          item->updateIndices(range.startIndex,
+                                              range.indicesCount,
+                                              range.baseVertex);
+                      });
+}
+
+void ScenePipe::releaseUnusedRanges(std::pmr::memory_resource* resource)
+{
+    std::pmr::unordered_set<const Mesh*> meshes(resource);
+
+    for (const auto& item : mItems.getItems())
+    {
+        meshes.insert(item->getMesh().get());
+    }
+
+    for (auto range = mMeshRanges.begin(); range != mMeshRanges.end();)
+    {
+        if (meshes.count(range->first.get()) == 0)
+        {
+            mWastedSize += getRangeSize(range->second);
+            range = mMeshRanges.erase(range);
+        }
+        else
+        {
+            ++range;
+        }
+    }
+}
+
+void ScenePipe::compactRanges()
+{
+    std::vector<Range*> ranges;
+    ranges.reserve(mMeshRanges.size() + mItemRanges.size());
+
+    for (auto& [mesh, range] : mMeshRanges)
+    {
+        ranges.push_back(&range);
+    }
+    for (auto& [item, range] : mItemRanges)
+    {
+        ranges.push_back(&range);
+    }
+
+    compact(ranges);
+    mWastedSize = 0;
+}
+
+void ScenePipe::setMeshRegistry(std::shared_ptr<MeshRegistry> registry)
+{
+    mMeshRegistry = registry;
+
+    for (auto& item : mItems.getItems())
+    {
+        internMesh(*item);
+    }
+    mIsAllocated = false;
+}
+
+void ScenePipe::setTransformBuffered(bool isTransformBuffered)
+{
+    if (isTransformBuffered != (mTransformBuffer != nullptr))
+    {
+        mTransformBuffer = isTransformBuffered ? std::make_unique<TransformBuffer>() : nullptr;
+    }
+}
+
+bool ScenePipe::isTransformBuffered() const
+{
+    return mTransformBuffer != nullptr;
+}
+
+void ScenePipe::setMaterialBuffered(bool isMaterialBuffered)
+{
+    if (isMaterialBuffered != (mMaterialTable != nullptr))
+    {
+        mMaterialTable = isMaterialBuffered ? std::make_unique<MaterialTable>() : nullptr;
+
+        if (mMaterialTable)
+        {
+            mMaterialTable->setTextureManager(mTextureManager);
+        }
+    }
+}
+
+bool ScenePipe::isMaterialBuffered() const
+{
+    return mMaterialTable != nullptr;
+}
+
+void ScenePipe::setTextureManager(std::shared_ptr<TextureManager> manager)
+{
+    mTextureManager = manager;
+
+    if (mMaterialTable)
     {
-        item->updateIndices(mesh.getIndices().size());
-        mesh += *item->getMesh();
-        allocate(mesh);
+        mMaterialTable->setTextureManager(manager);
+    }
+}
+
+std::shared_ptr<TextureManager> ScenePipe::getTextureManager() const
+{
+    return mTextureManager;
+}
+
+void ScenePipe::internMesh(Item& item)
+{
+    if (mMeshRegistry)
+    {
+        item.setMesh(mMeshRegistry->intern(item.getMesh()));
     }
 }
 
@@ -63,32 +330,109 @@ void ScenePipe::render(std::shared_ptr<Camera> camera,
         return;
     }
 
-    for (auto item : mItems)
+    if (mTransformBuffer)
+    {
+        mTransformBuffer->update(mItems);
+    }
+
+    const auto& resources = mItems.getResources();
+    const auto& transformations = mItems.getTransformations();
+    const auto& drawRanges = mItems.getDrawRanges();
+    const auto packets = buildPackets(*camera, memory::getFrameArena().getResource());
+
+    // the materials' maps are packed before the arrays are bound, the packing could grow them
+    if (mMaterialTable)
+    {
+        const Material* material{nullptr};
+
+        for (const auto& packet : packets)
+        {
+            const auto& itemMaterial = resources[packet.index].material;
+
+            if (itemMaterial.get() != material)
+            {
+                material = itemMaterial.get();
+                mMaterialTable->add(itemMaterial);
+            }
+        }
+
+        mMaterialTable->update();
+    }
+
+    bind();
+    mProgram->setView(camera->getPosition(),
+                      camera->getProjection(),
+                      camera->getView());
+    if (!lights.empty())
     {
-        bind();
-        mProgram->setView(camera->getPosition(),
-                          camera->getProjection(),
-                          camera->getView());
         mProgram->setLight(lights.front().get());
-        mProgram->setMaterial(item->getMaterial());
-        mProgram->setTransformation(item->getTransformation());
+    }
 
-        const auto& renderParameters = item->getRenderParameters();
+    if (mTransformBuffer)
+    {
+        mTransformBuffer->bind(*mProgram);
+    }
 
-        glLineWidth(renderParameters->lineWidth);
-        for (const auto& param : renderParameters->enableAttributes)
+    if (mMaterialTable)
+    {
+        mMaterialTable->bind(*mProgram);
+    }
+
+    // the packets of one state are adjacent, so the state is set once for them
+    const Material* material{nullptr};
+    const Item::RenderParameters* renderParameters{nullptr};
+
+    for (const auto& packet : packets)
+    {
+        const auto index = packet.index;
+        const auto& itemResources = resources[index];
+
+        if (itemResources.material.get() != material)
+        {
+            material = itemResources.material.get();
+
+            if (mMaterialTable)
+            {
+                mMaterialTable->setMaterial(itemResources.material);
+            }
+            else
+            {
+                mProgram->setMaterial(itemResources.material.get());
+            }
+        }
+
+        if (mTransformBuffer)
+        {
+            mTransformBuffer->setIndex(index);
+        }
+        else
         {
-            glEnable(param);
+            mProgram->setTransformation(transformations[index]);
         }
-        for (const auto& param : renderParameters->disableAttributes)
+
+        if (itemResources.renderParameters.get() != renderParameters)
         {
-            glDisable(param);
+            renderParameters = itemResources.renderParameters.get();
+
+            glLineWidth(renderParameters->lineWidth);
+            for (const auto& param : renderParameters->enableAttributes)
+            {
+                glEnable(param);
+            }
+            for (const auto& param : renderParameters->disableAttributes)
+            {
+                glDisable(param);
+            }
         }
 
-        glDrawElements(renderParameters->renderMode,
-                       item->getElementsCount(),
-                       GL_UNSIGNED_INT,
-                       (void*)item->getElementsStartIndex());
+        const auto& drawRange = drawRanges[index];
+
+        glDrawElementsBaseVertex(renderParameters->renderMode,
+                                 drawRange.elementsCount,
+                                 GL_UNSIGNED_INT,
+                                 reinterpret_cast<void*>(
+                                     drawRange.startIndex * sizeof(uint)),
+                                 drawRange.baseVertex);
         /*
             ->pipe.program
             ->scene.camera
@@ -104,12 +448,128 @@ void ScenePipe::render(std::shared_ptr<Camera> camera,
             ->draw
         */
     }
+
+    if (mTransformBuffer)
+    {
+        mTransformBuffer->fence();
+    }
+}
+
+std::pmr::vector<ScenePipe::DrawPacket> ScenePipe::buildPackets(
+        const Camera& camera,
+        std::pmr::memory_resource* resource) const
+{
+    struct Chunk
+    {
+        const std::vector<uint>* indices;
+        std::size_t begin;
+        std::size_t end;
+        /** The first packet of the chunk's slice */
+        std::size_t offset;
+        std::size_t count;
+    };
+
+    const auto layerMask = camera.getLayerMask();
+    std::pmr::vector<Chunk> chunks(resource);
+    std::size_t itemsCount{0};
+
+    for (const auto& drawList : mItems.getDrawLists())
+    {
+        if ((drawList.layers & layerMask) == 0)
+        {
+            continue;
+        }
+
+        for (std::size_t begin = 0; begin < drawList.indices.size(); begin += PacketsChunkSize)
+        {
+            auto end = std::min(begin + PacketsChunkSize, drawList.indices.size());
+            chunks.push_back({&drawList.indices, begin, end, itemsCount + begin, 0});
+        }
+
+        itemsCount += drawList.indices.size();
+    }
+
+    const auto& resources = mItems.getResources();
+    const auto& transformations = mItems.getTransformations();
+    const auto& bounds = mItems.getBounds();
+    const auto& stateKeys = mItems.getStateKeys();
+    const auto viewProjection = camera.getProjection() * camera.getView();
+
+    // every chunk writes its own slice, so the workers share nothing
+    std::pmr::vector<DrawPacket> packets(itemsCount, resource);
+
+    auto buildChunk = [&](std::size_t index, uint)
+    {
+        auto& chunk = chunks[index];
+        auto output = packets.data() + chunk.offset;
+
+        for (auto i = chunk.begin; i < chunk.end; i++)
+        {
+            auto item = (*chunk.indices)[i];
+
+            // the items without meshes are written directly and have no bounds
+            if (resources[item].mesh &&
+                !utils::isBoxVisible(viewProjection * transformations[item],
+                                     bounds[item].min,
+                                     bounds[item].max))
+            {
+                continue;
+            }
+
+            output[chunk.count++] = {stateKeys[item], item};
+        }
+    };
+
+    if (itemsCount >= ParallelPacketsCount)
+    {
+        utils::parallelFor(chunks.size(), buildChunk);
+    }
+    else
+    {
+        for (std::size_t chunk = 0; chunk < chunks.size(); chunk++)
+        {
+            buildChunk(chunk, 0);
+        }
+    }
+
+    // the slices are merged by the submitting thread
+    std::size_t count{0};
+    for (const auto& chunk : chunks)
+    {
+        std::copy_n(packets.begin() + chunk.offset, chunk.count, packets.begin() + count);
+        count += chunk.count;
+    }
+    packets.resize(count);
+
+    std::sort(packets.begin(), packets.end(), [](const DrawPacket& lhv, const DrawPacket& rhv)
+    {
+        return lhv.stateKey != rhv.stateKey ? lhv.stateKey < rhv.stateKey
+                                            : lhv.index < rhv.index;
+    });
+
+    return packets;
 }
 
 const ScenePipe::Items& ScenePipe::getItems() const
+{
+    return mItems.getItems();
+}
+
+const ItemStore& ScenePipe::getItemStore() const
 {
     return mItems;
 }
 
+std::shared_ptr<MeshRegistry> ScenePipe::getMeshRegistry() const
+{
+    return mMeshRegistry;
+}
+
+std::size_t ScenePipe::getAllocatedSize() const
+{
+    return getVerticesCount() * sizeof(Vertex) +
+           getIndicesCount() * sizeof(uint);
+}
+
 
 } //custom_scene
@@ -0,0 +1,248 @@
+#include "ScenePreparer.h"
+#include "ScenePipe.h"
+#include "Item.h"
+#include "Mesh.h"
+#include "MeshRegistry.h"
+#include "JobSystem.h"
+
+#include <QElapsedTimer>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QThread>
+#include <algorithm>
+
+namespace custom_scene
+{
+
+ScenePreparer::ScenePreparer(std::shared_ptr<MeshRegistry> registry, QObject* parent) :
+    QObject(parent),
+    mRegistry(std::move(registry))
+{
+}
+
+ScenePreparer::~ScenePreparer()
+{
+    std::unique_lock lock(mMutex);
+    mIsRunning = false;
+    mBuiltCondition.notify_all();
+
+    // the jobs which are not started yet finish without building
+    mIdleCondition.wait(lock, [this]() { return mBuildsCount == 0; });
+    lock.unlock();
+
+    if (mLoader)
+    {
+        mLoader->wait();
+        delete mLoader;
+    }
+}
+
+void ScenePreparer::initialize(QOpenGLContext* shareContext)
+{
+    if (mLoader)
+    {
+        return;
+    }
+
+    initializeOpenGLFunctions();
+
+    // the surface must be created by the GUI thread
+    mSurface = std::make_unique<QOffscreenSurface>();
+    mSurface->setFormat(shareContext->format());
+    mSurface->create();
+
+    mContext = std::make_unique<QOpenGLContext>();
+    mContext->setShareContext(shareContext);
+    mContext->setFormat(shareContext->format());
+    mContext->create();
+
+    mLoader = QThread::create([this]() { load(); });
+    mContext->moveToThread(mLoader);
+    mLoader->start();
+}
+
+void ScenePreparer::prepare(std::shared_ptr<ScenePipe> pipe,
+                            std::shared_ptr<Item> item,
+                            Builder builder)
+{
+    {
+        std::lock_guard lock(mMutex);
+        mBuildsCount++;
+    }
+
+    mPendingCount++;
+
+    Task task{std::move(pipe), std::move(item), std::move(builder)};
+    JobSystem::getInstance().schedule([this, task = std::move(task)]() mutable
+    {
+        build(std::move(task));
+    });
+}
+
+std::size_t ScenePreparer::commit(std::chrono::microseconds budget)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    std::size_t count{0};
+
+    while (true)
+    {
+        Upload upload;
+
+        {
+            std::lock_guard lock(mMutex);
+
+            if (mUploads.empty())
+            {
+                break;
+            }
+
+            upload = mUploads.front();
+        }
+
+        // the uploads are finished in order, so the rest is not ready too
+        if (glClientWaitSync(upload.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            break;
+        }
+
+        {
+            std::lock_guard lock(mMutex);
+            mUploads.pop_front();
+        }
+
+        glDeleteSync(upload.fence);
+        upload.pipe->addStagedItem(upload.item, upload.buffer);
+        glDeleteBuffers(1, &upload.buffer);
+
+        mPendingCount--;
+        count++;
+
+        if (timer.nsecsElapsed() >= std::chrono::nanoseconds(budget).count())
+        {
+            break;
+        }
+    }
+
+    return count;
+}
+
+std::size_t ScenePreparer::getPendingCount() const
+{
+    return mPendingCount;
+}
+
+bool ScenePreparer::hasUploaded() const
+{
+    std::lock_guard lock(mMutex);
+    return !mUploads.empty();
+}
+
+void ScenePreparer::build(Task task)
+{
+    std::shared_ptr<Mesh> mesh;
+    bool isRunning;
+
+    {
+        std::lock_guard lock(mMutex);
+        isRunning = mIsRunning;
+    }
+
+    if (isRunning)
+    {
+        mesh = task.builder();
+        if (mesh && mRegistry)
+        {
+            mesh = mRegistry->intern(mesh);
+        }
+        if (mesh)
+        {
+            task.item->setMesh(mesh);
+        }
+    }
+    task.builder = nullptr;
+
+    std::lock_guard lock(mMutex);
+
+    if (mesh && mIsRunning)
+    {
+        mBuilt.push_back(std::move(task));
+        mBuiltCondition.notify_one();
+    }
+    else
+    {
+        mPendingCount--;
+    }
+
+    if (--mBuildsCount == 0)
+    {
+        mIdleCondition.notify_all();
+    }
+}
+
+void ScenePreparer::load()
+{
+    mContext->makeCurrent(mSurface.get());
+    QOpenGLExtraFunctions functions(mContext.get());
+
+    std::unique_lock lock(mMutex);
+
+    while (true)
+    {
+        mBuiltCondition.wait(lock, [this]() { return !mIsRunning || !mBuilt.empty(); });
+
+        if (!mIsRunning)
+        {
+            break;
+        }
+
+        auto task = std::move(mBuilt.front());
+        mBuilt.pop_front();
+
+        lock.unlock();
+
+        const auto& mesh = *task.item->getMesh();
+        auto verticesSize = mesh.getVertices().size() * sizeof(Vertex);
+        auto indicesSize = mesh.getIndices().size() * sizeof(uint);
+        GLuint buffer;
+
+        functions.glGenBuffers(1, &buffer);
+        functions.glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        functions.glBufferData(GL_COPY_WRITE_BUFFER,
+                               std::max<std::size_t>(verticesSize + indicesSize, 1),
+                               nullptr,
+                               GL_STATIC_DRAW);
+        functions.glBufferSubData(GL_COPY_WRITE_BUFFER, 0, verticesSize, mesh.getVertices().data());
+        functions.glBufferSubData(GL_COPY_WRITE_BUFFER,
+                                  verticesSize,
+                                  indicesSize,
+                                  mesh.getIndices().data());
+        functions.glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        // the fence is seen by the view's context after the commands are flushed
+        auto fence = functions.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        functions.glFlush();
+
+        lock.lock();
+        mUploads.push_back({std::move(task.pipe), std::move(task.item), buffer, fence});
+        lock.unlock();
+
+        emit uploaded();
+
+        lock.lock();
+    }
+
+    // the uploads which are not committed are dropped
+    for (auto& upload : mUploads)
+    {
+        functions.glDeleteSync(upload.fence);
+        functions.glDeleteBuffers(1, &upload.buffer);
+    }
+    mUploads.clear();
+
+    lock.unlock();
+    mContext->doneCurrent();
+}
+
+}
@@ -0,0 +1,223 @@
+#include "StreamBuffer.h"
+
+#include <QOpenGLContext>
+#include <algorithm>
+#include <cstring>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+/** The granularity of uploads of the CPU copy */
+constexpr std::size_t BlockSize{256};
+
+/** GL_ARB_buffer_storage is not a part of QOpenGLExtraFunctions */
+constexpr GLbitfield MapPersistentBit{0x0040};
+constexpr GLbitfield MapCoherentBit{0x0080};
+using BufferStorage = void (QOPENGLF_APIENTRYP)(GLenum target,
+                                                GLsizeiptr size,
+                                                const void* data,
+                                                GLbitfield flags);
+
+BufferStorage getBufferStorage()
+{
+    auto context = QOpenGLContext::currentContext();
+
+    if (!context)
+    {
+        return nullptr;
+    }
+
+    auto format = context->format();
+    auto isSupported = format.majorVersion() > 4 ||
+            (format.majorVersion() == 4 && format.minorVersion() >= 4) ||
+            context->hasExtension("GL_ARB_buffer_storage");
+
+    return isSupported
+            ? reinterpret_cast<BufferStorage>(context->getProcAddress("glBufferStorage"))
+            : nullptr;
+}
+
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    mContextGuard.release();
+}
+
+void StreamBuffer::resize(std::size_t size)
+{
+    if (!mIsInitialized)
+    {
+        initializeOpenGLFunctions();
+        mIsPersistent = getBufferStorage() != nullptr;
+        mIsInitialized = true;
+
+        mContextGuard.attach([this]() { return take(); });
+    }
+
+    if (size == mSize && mBuffer != 0)
+    {
+        return;
+    }
+
+    if (mIsPersistent)
+    {
+        // the storage is immutable, so the data is copied to the new buffer on the GPU side
+        auto oldBuffer = mBuffer;
+        auto flags = GL_MAP_WRITE_BIT | MapPersistentBit | MapCoherentBit;
+
+        glGenBuffers(1, &mBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+        getBufferStorage()(GL_COPY_WRITE_BUFFER, std::max<std::size_t>(size, 1), nullptr, flags);
+
+        if (oldBuffer != 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                                GL_COPY_WRITE_BUFFER,
+                                0,
+                                0,
+                                std::min(size, mSize));
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &oldBuffer);
+        }
+
+        mData = static_cast<std::byte*>(glMapBufferRange(GL_COPY_WRITE_BUFFER,
+                                                         0,
+                                                         std::max<std::size_t>(size, 1),
+                                                         flags));
+    }
+    else
+    {
+        if (mBuffer == 0)
+        {
+            glGenBuffers(1, &mBuffer);
+        }
+
+        mCopy.resize(size);
+        mData = mCopy.data();
+        mDirtyBlocks.assign((size / BlockSize + 64) / 64, 0);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, mCopy.data(), GL_DYNAMIC_DRAW);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    mSize = size;
+}
+
+void StreamBuffer::write(std::size_t offset, const void* data, std::size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    std::memcpy(mData + offset, data, size);
+    markDirty(offset, size);
+}
+
+void StreamBuffer::markDirty(std::size_t offset, std::size_t size)
+{
+    if (!mIsPersistent && size > 0)
+    {
+        for (auto block = offset / BlockSize; block <= (offset + size - 1) / BlockSize; block++)
+        {
+            mDirtyBlocks[block / 64] |= std::uint64_t{1} << (block % 64);
+        }
+    }
+}
+
+void StreamBuffer::flush()
+{
+    if (mIsPersistent || mBuffer == 0)
+    {
+        return;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+
+    // the runs of dirty blocks are uploaded by one call each
+    std::size_t blocksCount = mDirtyBlocks.size() * 64;
+    std::size_t block{0};
+
+    while (block < blocksCount)
+    {
+        if (mDirtyBlocks[block / 64] == 0)
+        {
+            block = (block / 64 + 1) * 64;
+            continue;
+        }
+
+        if ((mDirtyBlocks[block / 64] & (std::uint64_t{1} << (block % 64))) == 0)
+        {
+            block++;
+            continue;
+        }
+
+        auto first = block;
+        while (block < blocksCount &&
+               (mDirtyBlocks[block / 64] & (std::uint64_t{1} << (block % 64))) != 0)
+        {
+            block++;
+        }
+
+        auto offset = first * BlockSize;
+        auto size = std::min(block * BlockSize, mSize) - std::min(offset, mSize);
+
+        if (size > 0)
+        {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, mData + offset);
+        }
+    }
+
+    std::fill(mDirtyBlocks.begin(), mDirtyBlocks.end(), 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+std::byte* StreamBuffer::getData() const
+{
+    return mData;
+}
+
+GLuint StreamBuffer::getId() const
+{
+    return mBuffer;
+}
+
+std::size_t StreamBuffer::getSize() const
+{
+    return mSize;
+}
+
+bool StreamBuffer::isPersistent() const
+{
+    return mIsPersistent;
+}
+
+ContextGuard::Release StreamBuffer::take()
+{
+    auto buffer = mBuffer;
+
+    mBuffer = 0;
+    mSize = 0;
+    mData = nullptr;
+    mCopy.clear();
+    mDirtyBlocks.clear();
+    mIsInitialized = false;
+
+    // the mapping is released with the buffer
+    return [buffer](QOpenGLExtraFunctions& functions)
+    {
+        if (buffer != 0)
+        {
+            functions.glDeleteBuffers(1, &buffer);
+        }
+    };
+}
+
+}
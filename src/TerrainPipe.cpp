@@ -0,0 +1,438 @@
+#include "TerrainPipe.h"
+#include "Item.h"
+#include "Camera.h"
+#include "Program.h"
+#include "Generator.h"
+#include "Memory.h"
+#include "Utils.h"
+#include "Defaults.h"
+
+#include <QDir>
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+/** The part of the level's range where vertices are morphed to the coarser level */
+constexpr float MorphStart{0.7f};
+
+std::uint64_t getTileKey(uint level, uint x, uint y)
+{
+    return (static_cast<std::uint64_t>(level) << 48) |
+           (static_cast<std::uint64_t>(x) << 24) |
+           static_cast<std::uint64_t>(y);
+}
+
+float getDistance(const Vec3& point, const Vec3& min, const Vec3& max)
+{
+    auto dx = std::max({min.x() - point.x(), 0.0f, point.x() - max.x()});
+    auto dy = std::max({min.y() - point.y(), 0.0f, point.y() - max.y()});
+    auto dz = std::max({min.z() - point.z(), 0.0f, point.z() - max.z()});
+
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+QString getTilePath(const QString& directory, uint level, uint x, uint y)
+{
+    return QString("%1/%2/%3_%4.raw").arg(directory).arg(level).arg(x).arg(y);
+}
+
+}
+
+TerrainPipe::TerrainPipe(std::shared_ptr<Program> program,
+                         const Parameters& parameters,
+                         std::shared_ptr<Material> material) :
+    ScenePipe(program, defaults::attributes::Vertex),
+    mParameters(parameters),
+    mLoader([this](std::uint64_t key) { return loadTile(key); })
+{
+    auto patch = Generator::generateMesh(figures::Grid{1.0f,
+                                                       1.0f,
+                                                       mParameters.patchResolution,
+                                                       mParameters.patchResolution});
+
+    auto renderParameters = std::make_shared<Item::RenderParameters>(
+                Item::RenderParameters{GL_TRIANGLES,
+                                       1.0f,
+                                       1.0f,
+                                       {GL_DEPTH_TEST, GL_CULL_FACE},
+                                       {GL_BLEND}});
+
+    mPatch = std::make_shared<Item>(std::make_shared<Mesh>(std::move(patch)),
+                                    renderParameters,
+                                    material,
+                                    nullptr);
+    addItem(mPatch);
+}
+
+void TerrainPipe::render(std::shared_ptr<Camera> camera,
+                         const Lights& lights,
+                         const Textures&)
+{
+    if (!mIsInitialized || !mIsAllocated)
+    {
+        return;
+    }
+
+    // the tiles which are still needed are requested again by the selection
+    mLoader.cancel();
+    uploadTiles();
+
+    auto root = getTile(0, 0, 0);
+
+    if (!root || !root->texture)
+    {
+        mChunksCount = 0;
+        return;
+    }
+
+    std::pmr::vector<Chunk> chunks(memory::getFrameArena().getResource());
+    selectChunks(0,
+                 0,
+                 0,
+                 camera->getPosition(),
+                 camera->getProjection() * camera->getView(),
+                 chunks);
+    mChunksCount = chunks.size();
+
+    const auto& renderParameters = mPatch->getRenderParameters();
+    auto samplesCount = static_cast<float>(mParameters.tileSize + 1);
+
+    bind();
+    mProgram->setView(camera->getPosition(),
+                      camera->getProjection(),
+                      camera->getView());
+    if (!lights.empty())
+    {
+        mProgram->setLight(lights.front().get());
+    }
+    mProgram->setMaterial(mPatch->getMaterial());
+    mProgram->setAlfa(renderParameters->alfa);
+    mProgram->setUniformValue("heightMap", 0);
+    mProgram->setUniformValue("gridResolution",
+                              static_cast<float>(mParameters.patchResolution));
+    mProgram->setUniformValue("heightScale", mParameters.heightScale);
+    // the samples are at the texels' centers
+    mProgram->setUniformValue("tileTransform",
+                              Vec2(mParameters.tileSize / samplesCount,
+                                   0.5f / samplesCount));
+
+    for (const auto& param : renderParameters->enableAttributes)
+    {
+        glEnable(param);
+    }
+    for (const auto& param : renderParameters->disableAttributes)
+    {
+        glDisable(param);
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+
+    for (const auto& chunk : chunks)
+    {
+        chunk.tile->texture->bind(0);
+        mProgram->setUniformValue("chunkOrigin", chunk.origin);
+        mProgram->setUniformValue("chunkSize", chunk.size);
+        mProgram->setUniformValue("morphRange",
+                                  Vec2(chunk.morphEnd * MorphStart, chunk.morphEnd));
+
+        glDrawElementsBaseVertex(renderParameters->renderMode,
+                                 mPatch->getElementsCount(),
+                                 GL_UNSIGNED_INT,
+                                 reinterpret_cast<void*>(
+                                     mPatch->getElementsStartIndex() * sizeof(uint)),
+                                 mPatch->getBaseVertex());
+    }
+
+    release();
+
+    evictTiles();
+    mFrame++;
+}
+
+TerrainPipe::Statistics TerrainPipe::getStatistics() const
+{
+    return {mChunksCount, mTiles.size(), mLoader.getPendingCount()};
+}
+
+void TerrainPipe::selectChunks(uint level,
+                               uint x,
+                               uint y,
+                               const Vec3& position,
+                               const Mat4& transformation,
+                               std::pmr::vector<Chunk>& chunks)
+{
+    auto tile = getTile(level, x, y);
+    tile->lastUsedFrame = mFrame;
+
+    auto chunkSize = mParameters.size / (1u << level);
+    auto origin = mParameters.origin + Vec2(x, y) * chunkSize;
+    auto minHeight = tile->minHeight * mParameters.heightScale;
+    auto maxHeight = tile->maxHeight * mParameters.heightScale;
+
+    Vec3 min(origin.x(), origin.y(), std::min(minHeight, maxHeight));
+    Vec3 max(origin.x() + chunkSize, origin.y() + chunkSize, std::max(minHeight, maxHeight));
+
+    if (!utils::isBoxVisible(transformation, min, max))
+    {
+        return;
+    }
+
+    // the chunk is replaced by its parent beyond the parent's range,
+    // the root is never replaced
+    auto morphEnd = level > 0 ? 2.0f * mParameters.lodDistance * chunkSize
+                              : std::numeric_limits<float>::max();
+
+    auto isLeaf = level + 1 >= mParameters.levels ||
+            getDistance(position, min, max) > mParameters.lodDistance * chunkSize;
+
+    // the chunk is drawn instead of its children until all of them are loaded
+    if (!isLeaf)
+    {
+        for (uint child = 0; child < 4; child++)
+        {
+            auto childX = 2 * x + (child & 1);
+            auto childY = 2 * y + (child >> 1);
+
+            if (auto childTile = getTile(level + 1, childX, childY))
+            {
+                childTile->lastUsedFrame = mFrame;
+                isLeaf = isLeaf || !childTile->texture;
+            }
+            else
+            {
+                mLoader.request(getTileKey(level + 1, childX, childY));
+                isLeaf = true;
+            }
+        }
+    }
+
+    if (isLeaf)
+    {
+        chunks.push_back({tile, origin, chunkSize, morphEnd});
+        return;
+    }
+
+    for (uint child = 0; child < 4; child++)
+    {
+        selectChunks(level + 1,
+                     2 * x + (child & 1),
+                     2 * y + (child >> 1),
+                     position,
+                     transformation,
+                     chunks);
+    }
+}
+
+TerrainPipe::Tile* TerrainPipe::getTile(uint level, uint x, uint y)
+{
+    auto key = getTileKey(level, x, y);
+    auto tile = mTiles.find(key);
+
+    if (tile == mTiles.end())
+    {
+        if (level == 0)
+        {
+            mLoader.request(key);
+        }
+        return nullptr;
+    }
+
+    return &tile->second;
+}
+
+void TerrainPipe::uploadTiles()
+{
+    auto samplesCount = mParameters.tileSize + 1;
+
+    for (auto& [key, heights] : mLoader.take(mParameters.maxUploadsPerFrame))
+    {
+        auto& tile = mTiles[key];
+        tile.lastUsedFrame = mFrame;
+
+        // the missing tile is remembered, so it is not requested again
+        auto isBounded = heights.size() == samplesCount * samplesCount + 2;
+        if (heights.size() != samplesCount * samplesCount && !isBounded)
+        {
+            continue;
+        }
+
+        if (isBounded)
+        {
+            tile.minHeight = heights[samplesCount * samplesCount];
+            tile.maxHeight = heights[samplesCount * samplesCount + 1];
+        }
+        else
+        {
+            auto [minHeight, maxHeight] = std::minmax_element(heights.begin(), heights.end());
+            tile.minHeight = *minHeight;
+            tile.maxHeight = *maxHeight;
+        }
+
+        tile.texture = std::make_shared<Texture>(QOpenGLTexture::Target2D);
+        tile.texture->setFormat(QOpenGLTexture::R32F);
+        tile.texture->setSize(samplesCount, samplesCount);
+        tile.texture->setMipLevels(1);
+        tile.texture->allocateStorage(QOpenGLTexture::Red, QOpenGLTexture::Float32);
+        tile.texture->setData(QOpenGLTexture::Red, QOpenGLTexture::Float32, heights.data());
+        tile.texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+        tile.texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+    }
+}
+
+void TerrainPipe::evictTiles()
+{
+    if (mTiles.size() <= mParameters.maxResidentTiles)
+    {
+        return;
+    }
+
+    using Candidate = std::pair<std::size_t, std::uint64_t>;
+    std::pmr::vector<Candidate> candidates(memory::getFrameArena().getResource());
+    candidates.reserve(mTiles.size());
+
+    for (const auto& [key, tile] : mTiles)
+    {
+        // the root and the tiles used by the current frame are kept
+        if (key != getTileKey(0, 0, 0) && tile.lastUsedFrame < mFrame)
+        {
+            candidates.emplace_back(tile.lastUsedFrame, key);
+        }
+    }
+
+    auto count = std::min(candidates.size(), mTiles.size() - mParameters.maxResidentTiles);
+    std::nth_element(candidates.begin(), candidates.begin() + count, candidates.end());
+
+    for (auto candidate = candidates.begin(); candidate != candidates.begin() + count; ++candidate)
+    {
+        mTiles.erase(candidate->second);
+    }
+}
+
+std::vector<float> TerrainPipe::loadTile(std::uint64_t key) const
+{
+    if (!mParameters.loader)
+    {
+        return {};
+    }
+
+    return mParameters.loader(static_cast<uint>(key >> 48),
+                              static_cast<uint>((key >> 24) & 0xFFFFFF),
+                              static_cast<uint>(key & 0xFFFFFF));
+}
+
+TerrainPipe::TileLoader TerrainPipe::createFileLoader(const QString& directory, uint tileSize)
+{
+    return [directory, tileSize](uint level, uint x, uint y)
+    {
+        // the heights are followed by the area's minimal and maximal heights
+        auto count = (tileSize + 1) * (tileSize + 1) + 2;
+        auto size = static_cast<qint64>(count * sizeof(float));
+        std::vector<float> heights;
+
+        QFile file(getTilePath(directory, level, x, y));
+        if (file.open(QFile::ReadOnly) && file.size() == size)
+        {
+            heights.resize(count);
+            if (file.read(reinterpret_cast<char*>(heights.data()), size) != size)
+            {
+                heights.clear();
+            }
+        }
+
+        return heights;
+    };
+}
+
+bool TerrainPipe::writeTiles(const figures::Heightfield& heightfield,
+                             const QString& directory,
+                             uint tileSize,
+                             uint levels)
+{
+    if (heightfield.columns < 2 || heightfield.rows < 2)
+    {
+        return false;
+    }
+
+    auto samplesCount = tileSize + 1;
+    std::vector<float> heights(samplesCount * samplesCount + 2);
+
+    for (uint level = 0; level < levels; level++)
+    {
+        uint tilesCount = 1u << level;
+        auto stepX = static_cast<float>(heightfield.columns - 1) / (tilesCount * tileSize);
+        auto stepY = static_cast<float>(heightfield.rows - 1) / (tilesCount * tileSize);
+
+        if (!QDir(directory).mkpath(QString::number(level)))
+        {
+            return false;
+        }
+
+        for (uint y = 0; y < tilesCount; y++)
+        {
+            for (uint x = 0; x < tilesCount; x++)
+            {
+                for (uint row = 0; row < samplesCount; row++)
+                {
+                    auto sourceRow = std::min(
+                                static_cast<uint>(std::lround((y * tileSize + row) * stepY)),
+                                heightfield.rows - 1);
+
+                    for (uint column = 0; column < samplesCount; column++)
+                    {
+                        auto sourceColumn = std::min(
+                                    static_cast<uint>(std::lround((x * tileSize + column) * stepX)),
+                                    heightfield.columns - 1);
+
+                        heights[row * samplesCount + column] =
+                                heightfield.heights[sourceRow * heightfield.columns + sourceColumn] *
+                                heightfield.heightScale;
+                    }
+                }
+
+                // the samples skip the source heights between them, so the bounds are found
+                // among all source heights of the tile's area
+                auto firstRow = static_cast<uint>(std::floor(y * tileSize * stepY));
+                auto lastRow = std::min(static_cast<uint>(std::ceil((y + 1) * tileSize * stepY)),
+                                        heightfield.rows - 1);
+                auto firstColumn = static_cast<uint>(std::floor(x * tileSize * stepX));
+                auto lastColumn = std::min(static_cast<uint>(std::ceil((x + 1) * tileSize * stepX)),
+                                           heightfield.columns - 1);
+
+                auto minHeight = std::numeric_limits<float>::max();
+                auto maxHeight = std::numeric_limits<float>::lowest();
+
+                for (auto row = firstRow; row <= lastRow; row++)
+                {
+                    auto first = heightfield.heights + static_cast<std::size_t>(row) * heightfield.columns;
+                    auto [rowMin, rowMax] = std::minmax_element(first + firstColumn,
+                                                                first + lastColumn + 1);
+                    minHeight = std::min(minHeight, *rowMin);
+                    maxHeight = std::max(maxHeight, *rowMax);
+                }
+
+                heights[samplesCount * samplesCount] = minHeight * heightfield.heightScale;
+                heights[samplesCount * samplesCount + 1] = maxHeight * heightfield.heightScale;
+
+                QFile file(getTilePath(directory, level, x, y));
+                auto size = static_cast<qint64>(heights.size() * sizeof(float));
+
+                if (!file.open(QFile::WriteOnly | QFile::Truncate) ||
+                    file.write(reinterpret_cast<const char*>(heights.data()), size) != size)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,479 @@
+#include "TextureManager.h"
+#include "Program.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+const char* const ArrayNames[TextureManager::MaxArraysCount] = {"textureArray0",
+                                                               "textureArray1",
+                                                               "textureArray2",
+                                                               "textureArray3"};
+
+/** The size of the smallest cell, the smaller textures take it too */
+constexpr int MinCellSize{32};
+
+/** The formats which are color-renderable, so the textures are copied by the blits */
+bool isPackable(GLenum format)
+{
+    switch (format)
+    {
+        case GL_RGBA8:
+        case GL_SRGB8_ALPHA8:
+        case GL_RGB8:
+        case GL_RG8:
+        case GL_R8:
+        case GL_RGBA16F:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int getLog2(int size)
+{
+    int log{0};
+    while ((1 << (log + 1)) <= size)
+    {
+        log++;
+    }
+    return log;
+}
+
+int getNextPowerOfTwo(int size)
+{
+    int power{1};
+    while (power < size)
+    {
+        power <<= 1;
+    }
+    return power;
+}
+
+/** Keeps the bound framebuffers of the view, the manager's blits go to its own ones */
+class FramebufferScope
+{
+public:
+    explicit FramebufferScope(QOpenGLExtraFunctions& functions) :
+        mFunctions(functions)
+    {
+        mFunctions.glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &mRead);
+        mFunctions.glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &mDraw);
+        mFunctions.glGenFramebuffers(2, mFramebuffers);
+        mFunctions.glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffers[0]);
+        mFunctions.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mFramebuffers[1]);
+    }
+
+    ~FramebufferScope()
+    {
+        mFunctions.glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(mRead));
+        mFunctions.glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(mDraw));
+        mFunctions.glDeleteFramebuffers(2, mFramebuffers);
+    }
+
+private:
+    QOpenGLExtraFunctions& mFunctions;
+    GLint mRead{0};
+    GLint mDraw{0};
+    GLuint mFramebuffers[2]{};
+};
+
+}
+
+bool TextureManager::Location::isValid() const
+{
+    return array >= 0;
+}
+
+bool TextureManager::Cell::operator<(const Cell& other) const
+{
+    return std::tie(layer, x, y) < std::tie(other.layer, other.x, other.y);
+}
+
+TextureManager::TextureManager(int pageSize) :
+    mPageSize(getNextPowerOfTwo(std::max(pageSize, MinCellSize))),
+    mLevelsCount(getLog2(mPageSize / MinCellSize) + 1)
+{
+}
+
+TextureManager::~TextureManager()
+{
+    mContextGuard.release();
+}
+
+TextureManager::Location TextureManager::add(const std::shared_ptr<Texture>& texture)
+{
+    if (!mIsInitialized)
+    {
+        initializeOpenGLFunctions();
+        mIsInitialized = true;
+
+        mContextGuard.attach([this]() { return take(); });
+    }
+
+    auto [position, isInserted] = mEntries.try_emplace(texture.get());
+    auto& entry = position->second;
+
+    if (!isInserted)
+    {
+        if (!entry.texture.expired())
+        {
+            return entry.location;
+        }
+
+        // the released texture's address is taken by the new one before the update
+        if (entry.location.isValid())
+        {
+            auto& array = mArrays[entry.location.array];
+            release(array, entry.level, entry.cell);
+        }
+        entry = {};
+    }
+
+    entry.texture = texture;
+
+    auto format = static_cast<GLenum>(texture->format());
+    auto width = texture->width();
+    auto height = texture->height();
+    auto cellSize = getNextPowerOfTwo(std::max({width + 2 * GutterSize,
+                                                height + 2 * GutterSize,
+                                                MinCellSize}));
+
+    // the texture without the storage is packed when it gets it
+    if (width <= 0 || height <= 0)
+    {
+        mEntries.erase(position);
+        return {};
+    }
+
+    if (texture->target() != QOpenGLTexture::Target2D ||
+        !isPackable(format) ||
+        cellSize > mPageSize)
+    {
+        return entry.location;
+    }
+
+    auto arrayIndex = getArray(format);
+    if (arrayIndex < 0)
+    {
+        return entry.location;
+    }
+
+    auto& array = mArrays[arrayIndex];
+    auto level = getLog2(mPageSize / cellSize);
+    Cell cell;
+
+    if (!allocate(array, level, cell))
+    {
+        return entry.location;
+    }
+
+    copy(*texture, array, cell, cellSize);
+    array.isChanged = true;
+
+    auto pageSize = static_cast<float>(mPageSize);
+
+    entry.level = level;
+    entry.cell = cell;
+    entry.location.array = arrayIndex;
+    entry.location.layer = cell.layer;
+    entry.location.rect = QVector4D((cell.x + GutterSize) / pageSize,
+                                    (cell.y + GutterSize) / pageSize,
+                                    width / pageSize,
+                                    height / pageSize);
+    // the gutter is halved by every level, the bilinear filter reads half of the texel around
+    entry.location.maxLod = static_cast<float>(std::min(getLog2(cellSize), getLog2(2 * GutterSize)));
+
+    return entry.location;
+}
+
+void TextureManager::update(const Textures& textures)
+{
+    for (auto entry = mEntries.begin(); entry != mEntries.end();)
+    {
+        if (!entry->second.texture.expired())
+        {
+            ++entry;
+            continue;
+        }
+
+        if (entry->second.location.isValid())
+        {
+            release(mArrays[entry->second.location.array], entry->second.level, entry->second.cell);
+        }
+        entry = mEntries.erase(entry);
+    }
+
+    for (const auto& texture : textures)
+    {
+        add(texture);
+    }
+
+    generateMipmaps();
+}
+
+void TextureManager::bind(Program& program)
+{
+    if (!mIsInitialized)
+    {
+        return;
+    }
+
+    // the textures which are added by the materials during the frame
+    generateMipmaps();
+
+    for (int array = 0; array < static_cast<int>(mArrays.size()); array++)
+    {
+        glActiveTexture(GL_TEXTURE0 + FirstUnit + array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mArrays[array].texture);
+        program.setUniformValue(ArrayNames[array], FirstUnit + array);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    program.setUniformValue("texturePageSize", static_cast<float>(mPageSize));
+}
+
+TextureManager::Location TextureManager::getLocation(const Texture* texture) const
+{
+    auto entry = mEntries.find(texture);
+    return entry != mEntries.end() && !entry->second.texture.expired()
+            ? entry->second.location
+            : Location();
+}
+
+TextureManager::Stats TextureManager::getStats() const
+{
+    Stats stats;
+    stats.arraysCount = mArrays.size();
+
+    for (const auto& array : mArrays)
+    {
+        stats.layersCount += static_cast<std::size_t>(array.layersCount);
+    }
+
+    for (const auto& [texture, entry] : mEntries)
+    {
+        if (entry.location.isValid())
+        {
+            auto cellSize = static_cast<std::size_t>(mPageSize >> entry.level);
+            stats.packedCount++;
+            stats.usedTexels += cellSize * cellSize;
+        }
+        else
+        {
+            stats.rejectedCount++;
+        }
+    }
+
+    return stats;
+}
+
+int TextureManager::getArray(GLenum format)
+{
+    for (int array = 0; array < static_cast<int>(mArrays.size()); array++)
+    {
+        if (mArrays[array].format == format)
+        {
+            return array;
+        }
+    }
+
+    if (static_cast<int>(mArrays.size()) == MaxArraysCount)
+    {
+        return -1;
+    }
+
+    mArrays.emplace_back();
+    mArrays.back().format = format;
+    mArrays.back().freeCells.resize(static_cast<std::size_t>(mLevelsCount));
+
+    return static_cast<int>(mArrays.size() - 1);
+}
+
+bool TextureManager::allocate(Array& array, int level, Cell& cell)
+{
+    // the smallest free cell which is not smaller than the needed one
+    auto found = level;
+    while (found >= 0 && array.freeCells[found].empty())
+    {
+        found--;
+    }
+
+    if (found < 0)
+    {
+        grow(array);
+        found = 0;
+    }
+
+    cell = *array.freeCells[found].begin();
+    array.freeCells[found].erase(array.freeCells[found].begin());
+
+    // the cell is split, the first quarter is split further
+    for (; found < level; found++)
+    {
+        auto half = mPageSize >> (found + 1);
+        array.freeCells[found + 1].insert({cell.layer, cell.x + half, cell.y});
+        array.freeCells[found + 1].insert({cell.layer, cell.x, cell.y + half});
+        array.freeCells[found + 1].insert({cell.layer, cell.x + half, cell.y + half});
+    }
+
+    return true;
+}
+
+void TextureManager::release(Array& array, int level, Cell cell)
+{
+    // the free quarters are merged back to their cell
+    for (; level > 0; level--)
+    {
+        auto size = mPageSize >> level;
+        auto parent = Cell{cell.layer, cell.x & ~(2 * size - 1), cell.y & ~(2 * size - 1)};
+        Cell quarters[] = {parent,
+                           {parent.layer, parent.x + size, parent.y},
+                           {parent.layer, parent.x, parent.y + size},
+                           {parent.layer, parent.x + size, parent.y + size}};
+
+        auto& freeCells = array.freeCells[level];
+        auto isMerged = std::all_of(std::begin(quarters), std::end(quarters), [&](const Cell& quarter)
+        {
+            return (quarter.x == cell.x && quarter.y == cell.y) || freeCells.count(quarter) > 0;
+        });
+
+        if (!isMerged)
+        {
+            break;
+        }
+
+        for (const auto& quarter : quarters)
+        {
+            freeCells.erase(quarter);
+        }
+        cell = parent;
+    }
+
+    array.freeCells[level].insert(cell);
+}
+
+void TextureManager::grow(Array& array)
+{
+    auto layersCount = std::max(1, 2 * array.layersCount);
+    GLuint texture{0};
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY,
+                   getLog2(mPageSize) + 1,
+                   array.format,
+                   mPageSize,
+                   mPageSize,
+                   layersCount);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // the packed pages are moved, their mip levels are generated again
+    if (array.texture)
+    {
+        FramebufferScope scope(*this);
+
+        for (int layer = 0; layer < array.layersCount; layer++)
+        {
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array.texture, 0, layer);
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, layer);
+            glBlitFramebuffer(0, 0, mPageSize, mPageSize,
+                              0, 0, mPageSize, mPageSize,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+
+        glDeleteTextures(1, &array.texture);
+    }
+
+    for (int layer = array.layersCount; layer < layersCount; layer++)
+    {
+        array.freeCells[0].insert({layer, 0, 0});
+    }
+
+    array.texture = texture;
+    array.layersCount = layersCount;
+    array.isChanged = true;
+}
+
+void TextureManager::copy(const Texture& texture, const Array& array, const Cell& cell, int cellSize)
+{
+    FramebufferScope scope(*this);
+
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.textureId(), 0);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array.texture, 0, cell.layer);
+
+    const int w = texture.width();
+    const int h = texture.height();
+    const int x0 = cell.x;
+    const int y0 = cell.y;
+    const int x1 = cell.x + GutterSize;
+    const int y1 = cell.y + GutterSize;
+    const int x2 = x1 + w;
+    const int y2 = y1 + h;
+    const int x3 = cell.x + cellSize;
+    const int y3 = cell.y + cellSize;
+
+    // the texture, its edges are stretched over the gutter, its corners fill the gutter's corners
+    const int blits[][8] = {
+        {0, 0, w, h, x1, y1, x2, y2},
+        {0, 0, 1, h, x0, y1, x1, y2},
+        {w - 1, 0, w, h, x2, y1, x3, y2},
+        {0, 0, w, 1, x1, y0, x2, y1},
+        {0, h - 1, w, h, x1, y2, x2, y3},
+        {0, 0, 1, 1, x0, y0, x1, y1},
+        {w - 1, 0, w, 1, x2, y0, x3, y1},
+        {0, h - 1, 1, h, x0, y2, x1, y3},
+        {w - 1, h - 1, w, h, x2, y2, x3, y3}
+    };
+
+    for (const auto& blit : blits)
+    {
+        glBlitFramebuffer(blit[0], blit[1], blit[2], blit[3],
+                          blit[4], blit[5], blit[6], blit[7],
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+}
+
+void TextureManager::generateMipmaps()
+{
+    for (auto& array : mArrays)
+    {
+        if (array.isChanged)
+        {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            array.isChanged = false;
+        }
+    }
+}
+
+ContextGuard::Release TextureManager::take()
+{
+    std::vector<GLuint> textures;
+
+    for (const auto& array : mArrays)
+    {
+        textures.push_back(array.texture);
+    }
+
+    mArrays.clear();
+    mEntries.clear();
+    mIsInitialized = false;
+
+    return [textures](QOpenGLExtraFunctions& functions)
+    {
+        functions.glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+    };
+}
+
+}
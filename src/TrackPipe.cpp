@@ -0,0 +1,461 @@
+#include "TrackPipe.h"
+#include "Camera.h"
+#include "Program.h"
+#include "Memory.h"
+#include "Utils.h"
+#include "Defaults.h"
+
+#include <QOpenGLContext>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+/** The segment is drawn as two triangles without vertex buffers */
+constexpr GLint VerticesPerSegment{6};
+
+/** The point is stored as RGBA32F texel */
+constexpr std::size_t PointSize{4 * sizeof(float)};
+
+constexpr uint MinSlotsCapacity{16};
+
+/** The header is two RGBA32UI texels */
+constexpr GLint TexelsPerHeader{2};
+
+/** The timeout of one wait for the fence, the wait is repeated until the fence is signaled */
+constexpr GLuint64 WaitTimeout{1000000};
+
+template<typename Bits>
+void markDirty(Bits& bits, std::size_t index)
+{
+    for (auto& region : bits)
+    {
+        region[index / 64] |= std::uint64_t{1} << (index % 64);
+    }
+}
+
+/** Calls the function for every set bit and clears the bits */
+template<typename Function>
+void takeDirty(std::vector<std::uint64_t>& bits, const Function& function)
+{
+    for (std::size_t word = 0; word < bits.size(); word++)
+    {
+        for (std::size_t bit = 0; bits[word] != 0; bit++)
+        {
+            if (bits[word] & (std::uint64_t{1} << bit))
+            {
+                function(word * 64 + bit);
+                bits[word] &= ~(std::uint64_t{1} << bit);
+            }
+        }
+    }
+}
+
+}
+
+TrackPipe::TrackPipe(std::shared_ptr<Program> program, const Parameters& parameters) :
+    ScenePipe(program, defaults::attributes::Vertex),
+    mParameters(parameters)
+{
+    mParameters.pointsCapacity = std::max(mParameters.pointsCapacity, 4u);
+}
+
+TrackPipe::~TrackPipe()
+{
+    mContextGuard.release();
+}
+
+TrackPipe::Handle TrackPipe::addTrack(const Track& track)
+{
+    uint slot;
+
+    if (!mFreeSlots.empty())
+    {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+    else
+    {
+        slot = mSlotsCount++;
+        reserveSlots(mSlotsCount);
+    }
+
+    auto handle = mNextHandle++;
+    auto& state = mTracks[handle];
+    state.slot = slot;
+    state.header = {};
+    state.isVisible = true;
+
+    setTrack(handle, track);
+
+    return handle;
+}
+
+void TrackPipe::removeTrack(Handle handle)
+{
+    auto track = mTracks.find(handle);
+
+    if (track != mTracks.end())
+    {
+        mFreeSlots.push_back(track->second.slot);
+        mTracks.erase(track);
+    }
+}
+
+void TrackPipe::setTrack(Handle handle, const Track& track)
+{
+    auto state = mTracks.find(handle);
+
+    if (state == mTracks.end())
+    {
+        return;
+    }
+
+    auto& header = state->second.header;
+    header.width = track.width;
+    header.style = LinePipe::getStyle(track.join, track.cap);
+    header.color = utils::toRGBA8(track.color);
+
+    writeHeader(state->second);
+}
+
+void TrackPipe::setTrackVisible(Handle handle, bool isVisible)
+{
+    auto track = mTracks.find(handle);
+
+    if (track != mTracks.end())
+    {
+        track->second.isVisible = isVisible;
+    }
+}
+
+void TrackPipe::append(Handle handle, const Vec3& point)
+{
+    append(handle, &point, 1);
+}
+
+void TrackPipe::append(Handle handle, const Vec3* points, std::size_t count)
+{
+    auto state = mTracks.find(handle);
+
+    if (state == mTracks.end())
+    {
+        return;
+    }
+
+    auto& track = state->second;
+    auto& header = track.header;
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        if (header.count == mParameters.pointsCapacity)
+        {
+            decimate(track);
+        }
+
+        writePoint(track.slot,
+                   (header.tail + header.count) % mParameters.pointsCapacity,
+                   utils::toPoint3(points[i]));
+        header.count++;
+    }
+
+    writeHeader(track);
+}
+
+void TrackPipe::render(std::shared_ptr<Camera> camera,
+                       const Lights&,
+                       const Textures&)
+{
+    if (!mIsInitialized)
+    {
+        return;
+    }
+
+    // every track is one or two runs of the segments, the second one if the ring wraps
+    std::pmr::vector<GLint> firsts(memory::getFrameArena().getResource());
+    std::pmr::vector<GLsizei> counts(memory::getFrameArena().getResource());
+    firsts.reserve(2 * mTracks.size());
+    counts.reserve(2 * mTracks.size());
+
+    const auto capacity = mParameters.pointsCapacity;
+
+    for (const auto& [handle, track] : mTracks)
+    {
+        if (!track.isVisible || track.header.count < 2)
+        {
+            continue;
+        }
+
+        auto base = static_cast<GLint>(track.slot * capacity);
+        auto tail = track.header.tail;
+        auto segmentsCount = track.header.count - 1;
+        auto firstCount = std::min(segmentsCount, capacity - tail);
+
+        firsts.push_back((base + tail) * VerticesPerSegment);
+        counts.push_back(firstCount * VerticesPerSegment);
+
+        if (firstCount < segmentsCount)
+        {
+            firsts.push_back(base * VerticesPerSegment);
+            counts.push_back((segmentsCount - firstCount) * VerticesPerSegment);
+        }
+    }
+
+    if (firsts.empty())
+    {
+        return;
+    }
+
+    if (mIsResized)
+    {
+        upload();
+        mIsResized = false;
+    }
+
+    mRegion = (mRegion + 1) % RegionsCount;
+    wait(mRegion);
+    writeRegion(mRegion);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    bind();
+    mProgram->setView(camera->getPosition(),
+                      camera->getProjection(),
+                      camera->getView());
+    mProgram->setTransformation(Mat4());
+    mProgram->setAlfa(1.0f);
+    mProgram->setUniformValue("viewportSize", Vec2(viewport[2], viewport[3]));
+    mProgram->setUniformValue("miterLimit", mParameters.miterLimit);
+    mProgram->setUniformValue("pointsCapacity", static_cast<GLint>(capacity));
+    mProgram->setUniformValue("pointsOffset", static_cast<GLint>(mRegion * mRegionSlots * capacity));
+    mProgram->setUniformValue("headersOffset", static_cast<GLint>(mRegion * mRegionSlots) * TexelsPerHeader);
+    mProgram->setUniformValue("points", 0);
+    mProgram->setUniformValue("headers", 1);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, mPointsTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, mHeadersTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+
+    if (mMultiDrawArrays)
+    {
+        mMultiDrawArrays(GL_TRIANGLES,
+                         firsts.data(),
+                         counts.data(),
+                         static_cast<GLsizei>(firsts.size()));
+    }
+    else
+    {
+        for (std::size_t i = 0; i < firsts.size(); i++)
+        {
+            glDrawArrays(GL_TRIANGLES, firsts[i], counts[i]);
+        }
+    }
+
+    // without the mapping the uploads are synchronized by the driver
+    if (mPointsBuffer.isPersistent())
+    {
+        mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    release();
+}
+
+std::size_t TrackPipe::getTracksCount() const
+{
+    return mTracks.size();
+}
+
+std::size_t TrackPipe::getPointsCount(Handle handle) const
+{
+    auto track = mTracks.find(handle);
+    return track != mTracks.end() ? track->second.header.count : 0;
+}
+
+void TrackPipe::writePoint(uint slot, uint index, const Point3f& point)
+{
+    auto offset = static_cast<std::size_t>(slot) * mParameters.pointsCapacity + index;
+    mPoints[offset] = point;
+    markDirty(mDirtyPoints, offset);
+}
+
+void TrackPipe::writeHeader(const TrackState& track)
+{
+    mHeaders[track.slot] = track.header;
+    markDirty(mDirtyHeaders, track.slot);
+}
+
+void TrackPipe::decimate(TrackState& track)
+{
+    auto& header = track.header;
+    const auto capacity = mParameters.pointsCapacity;
+
+    if (!mParameters.isDecimated)
+    {
+        header.tail = (header.tail + 1) % capacity;
+        header.count--;
+        return;
+    }
+
+    // the even points of the older half are moved to the end of that half,
+    // the moves go from the newest one, so the sources are not overwritten
+    auto half = capacity / 2;
+    auto kept = half / 2;
+    auto tail = (header.tail + half - kept) % capacity;
+    auto base = static_cast<std::size_t>(track.slot) * capacity;
+
+    for (auto point = kept; point-- > 0;)
+    {
+        writePoint(track.slot,
+                   (tail + point) % capacity,
+                   mPoints[base + (header.tail + 2 * point) % capacity]);
+    }
+
+    header.tail = tail;
+    header.count -= half - kept;
+}
+
+void TrackPipe::reserveSlots(uint slotsCount)
+{
+    if (slotsCount <= mSlotsCapacity)
+    {
+        return;
+    }
+
+    mSlotsCapacity = std::max({slotsCount, 2 * mSlotsCapacity, MinSlotsCapacity});
+    mPoints.resize(static_cast<std::size_t>(mSlotsCapacity) * mParameters.pointsCapacity);
+    mHeaders.resize(mSlotsCapacity);
+
+    for (uint region = 0; region < RegionsCount; region++)
+    {
+        mDirtyPoints[region].resize((mPoints.size() + 63) / 64);
+        mDirtyHeaders[region].resize((mHeaders.size() + 63) / 64);
+    }
+
+    mIsResized = true;
+}
+
+void TrackPipe::upload()
+{
+    if (mPointsTexture == 0)
+    {
+        mContextGuard.attach([this]() { return takeTextures(); });
+
+        glGenTextures(1, &mPointsTexture);
+        glGenTextures(1, &mHeadersTexture);
+
+        // glMultiDrawArrays is the desktop function, it is not in QOpenGLExtraFunctions
+        if (auto context = QOpenGLContext::currentContext())
+        {
+            mMultiDrawArrays = reinterpret_cast<MultiDrawArrays>(
+                        context->getProcAddress("glMultiDrawArrays"));
+        }
+    }
+
+    // the regions are moved by resizing, so all of them are written again
+    for (uint region = 0; region < RegionsCount; region++)
+    {
+        wait(region);
+
+        std::fill(mDirtyPoints[region].begin(), mDirtyPoints[region].end(), ~std::uint64_t{0});
+        std::fill(mDirtyHeaders[region].begin(), mDirtyHeaders[region].end(), ~std::uint64_t{0});
+    }
+
+    mRegionSlots = std::max(mSlotsCapacity, MinSlotsCapacity);
+    auto pointsCount = static_cast<std::size_t>(mRegionSlots) * mParameters.pointsCapacity;
+
+    mPointsBuffer.resize(RegionsCount * pointsCount * PointSize);
+    mHeadersBuffer.resize(RegionsCount * mRegionSlots * sizeof(Header));
+
+    // the buffers are recreated by resizing, so the textures are attached again
+    glBindTexture(GL_TEXTURE_BUFFER, mPointsTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mPointsBuffer.getId());
+    glBindTexture(GL_TEXTURE_BUFFER, mHeadersTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, mHeadersBuffer.getId());
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void TrackPipe::writeRegion(uint region)
+{
+    auto pointsOffset = static_cast<std::size_t>(region) * mRegionSlots * mParameters.pointsCapacity;
+    auto headersOffset = static_cast<std::size_t>(region) * mRegionSlots;
+
+    // the bits past the last point are set by the full rewrite, they are skipped
+    takeDirty(mDirtyPoints[region], [&](std::size_t point)
+    {
+        if (point < mPoints.size())
+        {
+            float texel[4] = {mPoints[point][0], mPoints[point][1], mPoints[point][2], 1.0f};
+            mPointsBuffer.write((pointsOffset + point) * PointSize, texel, sizeof(texel));
+        }
+    });
+
+    takeDirty(mDirtyHeaders[region], [&](std::size_t slot)
+    {
+        if (slot < mHeaders.size())
+        {
+            mHeadersBuffer.write((headersOffset + slot) * sizeof(Header), &mHeaders[slot], sizeof(Header));
+        }
+    });
+
+    mPointsBuffer.flush();
+    mHeadersBuffer.flush();
+}
+
+void TrackPipe::wait(uint region)
+{
+    auto& fence = mFences[region];
+
+    if (!fence)
+    {
+        return;
+    }
+
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, WaitTimeout) == GL_TIMEOUT_EXPIRED)
+    {
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+ContextGuard::Release TrackPipe::takeTextures()
+{
+    std::array<GLuint, 2> textures{mPointsTexture, mHeadersTexture};
+    auto fences = mFences;
+
+    mPointsTexture = 0;
+    mHeadersTexture = 0;
+    mFences = {};
+    mMultiDrawArrays = nullptr;
+    mIsResized = true;
+
+    return [textures, fences](QOpenGLExtraFunctions& functions)
+    {
+        for (auto fence : fences)
+        {
+            if (fence)
+            {
+                functions.glDeleteSync(fence);
+            }
+        }
+
+        if (textures[0] != 0)
+        {
+            functions.glDeleteTextures(2, textures.data());
+        }
+    };
+}
+
+}
@@ -0,0 +1,187 @@
+#include "TransformBuffer.h"
+#include "ItemStore.h"
+#include "Program.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+/** The model matrix's columns and the normal matrix's columns padded to RGBA32F texels */
+constexpr std::size_t TexelsPerItem{7};
+constexpr std::size_t ItemSize{TexelsPerItem * 4 * sizeof(float)};
+
+constexpr uint MinCapacity{1024};
+
+/** The timeout of one wait for the fence, the wait is repeated until the fence is signaled */
+constexpr GLuint64 WaitTimeout{1000000};
+
+}
+
+TransformBuffer::~TransformBuffer()
+{
+    mContextGuard.release();
+}
+
+void TransformBuffer::update(const ItemStore& items)
+{
+    if (!mIsInitialized)
+    {
+        initializeOpenGLFunctions();
+        glGenTextures(1, &mTexture);
+        mIsInitialized = true;
+
+        mContextGuard.attach([this]() { return take(); });
+    }
+
+    reserve(items.getSize());
+
+    mRegion = (mRegion + 1) % RegionsCount;
+    wait(mRegion);
+
+    auto& versions = mVersions[mRegion];
+    auto data = mBuffer.getData();
+    auto regionOffset = static_cast<std::size_t>(mRegion) * mCapacity * ItemSize;
+    const auto& transformations = items.getTransformations();
+    const auto& transformationVersions = items.getTransformationVersions();
+    float texels[TexelsPerItem * 4];
+
+    mWrittenCount = 0;
+
+    for (std::size_t index = 0; index < items.getSize(); index++)
+    {
+        auto version = transformationVersions[index];
+
+        if (versions[index] != version)
+        {
+            const auto& transformation = transformations[index];
+            auto normal = transformation.normalMatrix();
+
+            std::memcpy(texels, transformation.constData(), 16 * sizeof(float));
+            for (int column = 0; column < 3; column++)
+            {
+                std::memcpy(texels + 16 + 4 * column,
+                            normal.constData() + 3 * column,
+                            3 * sizeof(float));
+                texels[16 + 4 * column + 3] = 0.0f;
+            }
+
+            auto offset = regionOffset + index * ItemSize;
+            std::memcpy(data + offset, texels, ItemSize);
+            mBuffer.markDirty(offset, ItemSize);
+
+            versions[index] = version;
+            mWrittenCount++;
+        }
+    }
+
+    mBuffer.flush();
+}
+
+void TransformBuffer::bind(Program& program)
+{
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    program.setUniformValue("transforms", TextureUnit);
+    program.setUniformValue("transformsOffset", static_cast<GLint>(mRegion * mCapacity));
+}
+
+void TransformBuffer::setIndex(uint index)
+{
+    glVertexAttribI4ui(IndexLocation, index, 0, 0, 0);
+}
+
+void TransformBuffer::fence()
+{
+    // without the mapping the uploads are synchronized by the driver
+    if (mBuffer.isPersistent())
+    {
+        mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+uint TransformBuffer::getCapacity() const
+{
+    return mCapacity;
+}
+
+std::size_t TransformBuffer::getWrittenCount() const
+{
+    return mWrittenCount;
+}
+
+void TransformBuffer::reserve(std::size_t itemsCount)
+{
+    if (itemsCount <= mCapacity)
+    {
+        return;
+    }
+
+    // the regions are moved by resizing, so all of them are written again
+    for (uint region = 0; region < RegionsCount; region++)
+    {
+        wait(region);
+    }
+
+    mCapacity = std::max({static_cast<uint>(itemsCount), 2 * mCapacity, MinCapacity});
+    mBuffer.resize(RegionsCount * static_cast<std::size_t>(mCapacity) * ItemSize);
+
+    for (auto& versions : mVersions)
+    {
+        versions.assign(mCapacity, 0);
+    }
+
+    glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mBuffer.getId());
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void TransformBuffer::wait(uint region)
+{
+    auto& fence = mFences[region];
+
+    if (!fence)
+    {
+        return;
+    }
+
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, WaitTimeout) == GL_TIMEOUT_EXPIRED)
+    {
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+ContextGuard::Release TransformBuffer::take()
+{
+    auto texture = mTexture;
+    auto fences = mFences;
+
+    // the buffer is released by its own guard, so the capacity is reserved again
+    mTexture = 0;
+    mFences = {};
+    mCapacity = 0;
+    mIsInitialized = false;
+
+    return [texture, fences](QOpenGLExtraFunctions& functions)
+    {
+        for (auto fence : fences)
+        {
+            if (fence)
+            {
+                functions.glDeleteSync(fence);
+            }
+        }
+
+        functions.glDeleteTextures(1, &texture);
+    };
+}
+
+}
@@ -1,4 +1,8 @@
 #include "Utils.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace custom_scene
 {
@@ -6,6 +10,44 @@ namespace custom_scene
 namespace utils
 {
 
+namespace
+{
+
+/** The count of points which are converted by one job, unprojection inverts the matrices */
+constexpr std::size_t ConversionChunkSize{4096};
+
+template<typename Convert>
+std::pmr::vector<Point3f> convert(const std::vector<Point2i>& screenPoints,
+                                  std::pmr::memory_resource* resource,
+                                  const Convert& convertPoint)
+{
+    std::pmr::vector<Point3f> points(screenPoints.size(), resource);
+    auto chunksCount = (screenPoints.size() + ConversionChunkSize - 1) / ConversionChunkSize;
+
+    auto convertChunk = [&](std::size_t chunk, uint)
+    {
+        auto end = std::min(screenPoints.size(), (chunk + 1) * ConversionChunkSize);
+
+        for (auto i = chunk * ConversionChunkSize; i < end; i++)
+        {
+            points[i] = toPoint3(convertPoint(screenPoints[i]));
+        }
+    };
+
+    if (chunksCount > 1)
+    {
+        parallelFor(chunksCount, convertChunk);
+    }
+    else if (chunksCount == 1)
+    {
+        convertChunk(0, 0);
+    }
+
+    return points;
+}
+
+}
+
 Point3f toPoint3(const Vec3& vec)
 {
     return {vec.x(), vec.y(), vec.z()};
@@ -18,6 +60,14 @@ Vec3 toVec3(const Color& color)
             static_cast<float>(color.blueF())};
 }
 
+std::uint32_t toRGBA8(const Color& color)
+{
+    return static_cast<std::uint32_t>(color.red()) |
+           (static_cast<std::uint32_t>(color.green()) << 8) |
+           (static_cast<std::uint32_t>(color.blue()) << 16) |
+           (static_cast<std::uint32_t>(color.alpha()) << 24);
+}
+
 Vec3 toWorldXYCoordinates(const Point2i& point,
                           std::pair<int, int> viewPortSize,
                           const Mat4& view,
@@ -58,33 +108,25 @@ Vec3 toWorldXYCoordinates(const Point2i& point,
     return pos;
 }
 
-std::vector<Point3f> toWorldXYCoordinates(
+std::pmr::vector<Point3f> toWorldXYCoordinates(
         const std::vector<Point2i>& screenPoints,
         std::pair<int, int> viewPortSize,
         const Mat4 &view,
         const Mat4 &projection,
-        float worldZ)
+        float worldZ,
+        std::pmr::memory_resource* resource)
 {
-    std::vector<Point3f> points;
-
-    for (const auto& point : screenPoints)
+    return convert(screenPoints, resource, [&](const Point2i& point)
     {
-        const auto& worldPoint = toWorldXYCoordinates(point,
-                                                      viewPortSize,
-                                                      view,
-                                                      projection,
-                                                      worldZ);
-        points.push_back(toPoint3(worldPoint));
-    }
-
-    return points;
+        return toWorldXYCoordinates(point, viewPortSize, view, projection, worldZ);
+    });
 }
 
 Vec3 toWorldCoordinates(const Point2i& screenPoint,
-                        float distance,
                         std::pair<int, int> viewPortSize,
                         const Mat4& view,
-                        const Mat4& projection)
+                        const Mat4& projection,
+                        float distance)
 {
     int screenW = viewPortSize.first;
     int screenH = viewPortSize.second;
@@ -95,24 +137,18 @@ Vec3 toWorldCoordinates(const Point2i& screenPoint,
                                 QRect(0, 0, screenW, screenH));
 }
 
-std::vector<Point3f> toWorldCoordinates(const std::vector<Point2i>& screenPoints,
-                                       float distance,
-                                       std::pair<int, int> viewPortSize,
-                                       const Mat4& view,
-                                       const Mat4& projection)
+std::pmr::vector<Point3f> toWorldCoordinates(
+        const std::vector<Point2i>& screenPoints,
+        std::pair<int, int> viewPortSize,
+        const Mat4& view,
+        const Mat4& projection,
+        float distance,
+        std::pmr::memory_resource* resource)
 {
-    std::vector<Point3f> points;
-    for (const auto& point : screenPoints)
+    return convert(screenPoints, resource, [&](const Point2i& point)
     {
-        const auto& worldPoint = toWorldCoordinates(point,
-                                                    viewPortSize,
-                                                    view,
-                                                    projection,
-                                                    distance);
-        points.push_back(toPoint3(worldPoint));
-    }
-
-    return points;
+        return toWorldCoordinates(point, viewPortSize, view, projection, distance);
+    });
 }
 
 Vec2 toScreenCoordinates(const Vec3& worldPoint, const Mat4& transformation)
@@ -130,5 +166,136 @@ Vec3 calculateNormal(const Point3f& p1, const Point3f& p2, const Point3f& p3)
     return QVector3D::crossProduct(edge1, edge2);
 }
 
+bool isBoxVisible(const Mat4& transformation, const Vec3& min, const Vec3& max)
+{
+    // the frustum planes are the sums and differences of the matrix rows
+    const auto w = transformation.row(3);
+
+    for (int row = 0; row < 3; row++)
+    {
+        const auto axis = transformation.row(row);
+
+        for (const auto& plane : {w + axis, w - axis})
+        {
+            // the box's corner which is the farthest along the plane's normal
+            QVector4D corner(plane.x() > 0.0f ? max.x() : min.x(),
+                             plane.y() > 0.0f ? max.y() : min.y(),
+                             plane.z() > 0.0f ? max.z() : min.z(),
+                             1.0f);
+
+            if (QVector4D::dotProduct(plane, corner) < 0.0f)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+namespace
+{
+
+constexpr std::uint64_t Prime1{11400714785074694791ULL};
+constexpr std::uint64_t Prime2{14029467366897019727ULL};
+constexpr std::uint64_t Prime3{1609587929392839161ULL};
+constexpr std::uint64_t Prime4{9650029242287828579ULL};
+constexpr std::uint64_t Prime5{2870177450012600261ULL};
+
+inline std::uint64_t rotl(std::uint64_t value, int shift)
+{
+    return (value << shift) | (value >> (64 - shift));
+}
+
+template<typename T>
+inline T read(const unsigned char* pointer)
+{
+    T value;
+    std::memcpy(&value, pointer, sizeof(T));
+    return value;
+}
+
+inline std::uint64_t round(std::uint64_t accumulator, std::uint64_t input)
+{
+    accumulator += input * Prime2;
+    accumulator = rotl(accumulator, 31);
+    return accumulator * Prime1;
+}
+
+inline std::uint64_t mergeRound(std::uint64_t accumulator, std::uint64_t value)
+{
+    accumulator ^= round(0, value);
+    return accumulator * Prime1 + Prime4;
+}
+
+}
+
+std::uint64_t hash(const void* data, std::size_t size, std::uint64_t seed)
+{
+    auto pointer = static_cast<const unsigned char*>(data);
+    auto end = pointer + size;
+    std::uint64_t result;
+
+    if (size >= 32)
+    {
+        std::uint64_t v1 = seed + Prime1 + Prime2;
+        std::uint64_t v2 = seed + Prime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - Prime1;
+
+        for (; pointer + 32 <= end; pointer += 32)
+        {
+            v1 = round(v1, read<std::uint64_t>(pointer));
+            v2 = round(v2, read<std::uint64_t>(pointer + 8));
+            v3 = round(v3, read<std::uint64_t>(pointer + 16));
+            v4 = round(v4, read<std::uint64_t>(pointer + 24));
+        }
+
+        result = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        result = mergeRound(result, v1);
+        result = mergeRound(result, v2);
+        result = mergeRound(result, v3);
+        result = mergeRound(result, v4);
+    }
+    else
+    {
+        result = seed + Prime5;
+    }
+
+    result += size;
+
+    for (; pointer + 8 <= end; pointer += 8)
+    {
+        result ^= round(0, read<std::uint64_t>(pointer));
+        result = rotl(result, 27) * Prime1 + Prime4;
+    }
+
+    if (pointer + 4 <= end)
+    {
+        result ^= static_cast<std::uint64_t>(read<std::uint32_t>(pointer)) * Prime1;
+        result = rotl(result, 23) * Prime2 + Prime3;
+        pointer += 4;
+    }
+
+    for (; pointer < end; pointer++)
+    {
+        result ^= (*pointer) * Prime5;
+        result = rotl(result, 11) * Prime1;
+    }
+
+    result ^= result >> 33;
+    result *= Prime2;
+    result ^= result >> 29;
+    result *= Prime3;
+    result ^= result >> 32;
+
+    return result;
+}
+
+uint getWorkersCount()
+{
+    return JobSystem::getInstance().getWorkersCount();
+}
+
 }
 }
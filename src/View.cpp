@@ -2,7 +2,16 @@
 #include "Scene.h"
 #include "ScenePipe.h"
 #include "Item.h"
+#include "SceneGraph.h"
+#include "ScenePreparer.h"
+#include "ProgramCompiler.h"
+#include "TextureManager.h"
+#include "RenderThread.h"
+#include "Program.h"
+#include "Defaults.h"
 #include "Manipulator.h"
+#include "Memory.h"
+#include "ContextGuard.h"
 
 #include <QMouseEvent>
 
@@ -18,12 +27,51 @@ View::View(QWidget* parent) :
     setFormat(format);
 }
 
+View::~View()
+{
+    // the contexts share the view's objects, so they are released first,
+    // the render thread commits the preparer's items
+    mRenderThread.reset();
+    mPreparer.reset();
+    mCompiler.reset();
+}
+
 void View::setScene(std::shared_ptr<Scene> scene)
 {
     mScene = scene;
 
     connect(mScene.get(), &Scene::changed,
             this, &View::updateScene);
+
+    mPreparer = std::make_unique<ScenePreparer>(mScene->getMeshRegistry());
+
+    connect(mPreparer.get(), &ScenePreparer::uploaded,
+            this, [this]()
+    {
+        if (mRenderThread)
+        {
+            mRenderThread->requestFrame();
+        }
+        else
+        {
+            update();
+        }
+    });
+}
+
+ScenePreparer* View::getScenePreparer() const
+{
+    return mPreparer.get();
+}
+
+void View::setThreadedRendering(bool isThreaded)
+{
+    mIsThreaded = isThreaded;
+}
+
+RenderThread* View::getRenderThread() const
+{
+    return mRenderThread.get();
 }
 
 void View::setCamera(std::shared_ptr<Camera> camera)
@@ -31,21 +79,39 @@ void View::setCamera(std::shared_ptr<Camera> camera)
     mCamera = camera;
 }
 
-void View::updateScene()
+void View::setLayerMask(std::uint32_t layerMask)
 {
-    for(const auto& pipe : mScene->getPipes())
+    mCamera->setLayerMask(layerMask);
+
+    if (mRenderThread)
     {
-        if (!pipe->isInitialized())
-        {
-            pipe->initialize();
-        }
+        publishCamera();
+    }
+    else
+    {
+        update();
+    }
+}
 
-        if (!pipe->isAllocated())
-        {
-            pipe->realocate();
-        }
+void View::publishCamera()
+{
+    if (mRenderThread)
+    {
+        mRenderThread->setCamera(*mCamera);
+    }
+}
+
+void View::updateScene()
+{
+    // the pipes are initialized by the frame which acquires them
+    if (mRenderThread)
+    {
+        mRenderThread->requestFrame();
+    }
+    else
+    {
+        update();
     }
-    update();
 }
 
 void View::initializeGL()
@@ -55,7 +121,46 @@ void View::initializeGL()
 
     connect(context(), &QOpenGLContext::aboutToBeDestroyed,
             this, &View::cleanup);
-    
+
+    if (mPreparer)
+    {
+        mPreparer->initialize(context());
+    }
+
+    if (!mCompiler)
+    {
+        mCompiler = std::make_unique<ProgramCompiler>();
+        mCompiler->initialize(context());
+
+        connect(mCompiler.get(), &ProgramCompiler::compiled,
+                this, &View::updateScene);
+    }
+
+    if (!mTextureManager)
+    {
+        mTextureManager = std::make_shared<TextureManager>();
+    }
+
+    if (mIsThreaded && !mRenderThread)
+    {
+        mCompositor = std::make_unique<Program>(defaults::shaders::Composite);
+        mCompositor->initialize();
+        mCompositorArray.create();
+
+        mRenderThread = std::make_unique<RenderThread>(mScene,
+                                                       mPreparer.get(),
+                                                       mCompiler.get(),
+                                                       mTextureManager,
+                                                       mBackgroundColor,
+                                                       format().samples());
+
+        connect(mRenderThread.get(), &RenderThread::frameReady,
+                this, [this]() { update(); });
+
+        mRenderThread->start(context());
+        mRenderThread->setCamera(*mCamera);
+    }
+
     updateScene();
 }
 
@@ -63,6 +168,7 @@ void View::resizeGL(int w, int h)
 {
     glViewport(0, 0, w, h);
     mCamera->setViewPort(w, h);
+    publishCamera();
 }
 
 void View::paintGL()
@@ -72,18 +178,126 @@ void View::paintGL()
     auto t1 = system_clock::now().time_since_epoch();
 #endif
 
+    // the objects of the owners which are destroyed out of the context are deleted now
+    ContextGuard::collect();
+
+    if (mRenderThread)
+    {
+        composite();
+        return;
+    }
+
+    auto& frameArena = memory::getFrameArena();
+    frameArena.reset();
+    mHeapCheck.begin();
+
+    auto snapshot = mScene->acquire();
+
+    for (const auto& pipe : snapshot->pipes)
+    {
+        if (!pipe->isInitialized())
+        {
+            // the buffers are uploaded while the program is linked
+            mCompiler->submit(pipe->getProgram());
+
+            pipe->setTextureManager(mTextureManager);
+            pipe->initialize();
+        }
+
+        if (!pipe->isAllocated())
+        {
+            pipe->realocate();
+        }
+    }
+
+    // the rest of the prepared items is added by the next frames
+    if (mPreparer)
+    {
+        mPreparer->commit(PreparationBudget);
+
+        if (mPreparer->hasUploaded())
+        {
+            update();
+        }
+    }
+
+    // the scene's textures are packed before the materials ask for them
+    mTextureManager->update(snapshot->textures);
+
+    // the pipe is rendered by the frame which follows its program's link
+    mCompiler->poll();
+
+    if (mCompiler->getPendingCount() > 0)
+    {
+        update();
+    }
+
+    mScene->getSceneGraph()->update();
+
     clear();
-    for(const auto& pipe : mScene->getPipes())
+    for (const auto& pipe : snapshot->pipes)
     {
-        pipe->render(mCamera,
-                     mScene->getLights(),
-                     mScene->getTextures());
+        if (pipe->isReady())
+        {
+            pipe->render(mCamera, snapshot->lights, snapshot->textures);
+        }
     }
 
+    // the check is ended before the debug output, which allocates
+    auto isHeapChecked = mHeapCheck.end(snapshot->version);
+
 #ifdef SHOW_DEBUG
     auto t2 = system_clock::now().time_since_epoch();
     qDebug() << "GLSceneView::paintGL duration:" << duration_cast<microseconds>(t2 - t1).count() << "mks";
+    qDebug() << "GLSceneView::paintGL heap allocations:" << frameArena.getHeapAllocationsCount();
 #endif
+
+    if (!isHeapChecked)
+    {
+        qWarning() << "GLSceneView::paintGL the warmed up frame called operator new"
+                   << mHeapCheck.getCount() << "times";
+    }
+}
+
+void View::composite()
+{
+    auto frame = mRenderThread->acquireFrame();
+
+    if (!frame)
+    {
+        clear();
+        return;
+    }
+
+    // the widget's framebuffer is multisampled, so the frame is drawn instead of blitted
+    auto functions = context()->extraFunctions();
+
+    if (frame->renderFence)
+    {
+        functions->glWaitSync(frame->renderFence, 0, GL_TIMEOUT_IGNORED);
+        functions->glDeleteSync(frame->renderFence);
+        frame->renderFence = nullptr;
+    }
+
+    mCompositor->bind();
+    mCompositor->setUniformValue("frame", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, frame->texture);
+
+    mCompositorArray.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    mCompositorArray.release();
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    mCompositor->release();
+
+    // the render thread waits for the frame's sampling before it renders to the frame again
+    if (frame->compositeFence)
+    {
+        functions->glDeleteSync(frame->compositeFence);
+    }
+    frame->compositeFence = functions->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    functions->glFlush();
 }
 
 void View::clear()
@@ -131,22 +345,27 @@ void View::mouseMoveEvent(QMouseEvent* event)
 
     mCamera->getManipulator()->mouseMoveEvent(event);
     updateCursorShape();
+    publishCamera();
 }
 
 void View::keyPressEvent(QKeyEvent *event)
 {
     mCamera->getManipulator()->keyPressEvent(event);
     updateCursorShape();
+    publishCamera();
 }
 
 void View::wheelEvent(QWheelEvent *event)
 {
     mCamera->getManipulator()->wheelEvent(event);
+    publishCamera();
 }
 
 void View::cleanup()
 {
+    // the pipes could outlive the view, so their objects are released while the context lives
     makeCurrent();
+    ContextGuard::releaseAll();
     doneCurrent();
 }
 
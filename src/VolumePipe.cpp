@@ -0,0 +1,508 @@
+#include "VolumePipe.h"
+#include "Item.h"
+#include "Camera.h"
+#include "Program.h"
+#include "Manipulator.h"
+#include "Memory.h"
+#include "Utils.h"
+#include "Defaults.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace custom_scene
+{
+
+namespace
+{
+
+constexpr int TransferFunctionSize{256};
+
+/** The atlas' position of the brick is kept in 8 bits by each axis */
+constexpr uint MaxAtlasBricks{255};
+
+/** The texture's format which matches the depth buffer, so the depth is blitted to it */
+struct DepthFormat
+{
+    QOpenGLTexture::TextureFormat format;
+    QOpenGLTexture::PixelFormat pixelFormat;
+    QOpenGLTexture::PixelType pixelType;
+    GLenum attachment;
+};
+
+DepthFormat getDepthFormat(GLint depthBits, GLint stencilBits, GLint componentType)
+{
+    if (componentType == GL_FLOAT)
+    {
+        return stencilBits > 0
+                ? DepthFormat{QOpenGLTexture::D32FS8X24,
+                              QOpenGLTexture::DepthStencil,
+                              QOpenGLTexture::Float32_D32_UInt32_S8_X24,
+                              GL_DEPTH_STENCIL_ATTACHMENT}
+                : DepthFormat{QOpenGLTexture::D32F,
+                              QOpenGLTexture::Depth,
+                              QOpenGLTexture::Float32,
+                              GL_DEPTH_ATTACHMENT};
+    }
+
+    if (stencilBits > 0)
+    {
+        return {QOpenGLTexture::D24S8,
+                QOpenGLTexture::DepthStencil,
+                QOpenGLTexture::UInt32_D24S8,
+                GL_DEPTH_STENCIL_ATTACHMENT};
+    }
+
+    switch (depthBits)
+    {
+        case 16:
+            return {QOpenGLTexture::D16, QOpenGLTexture::Depth, QOpenGLTexture::UInt16, GL_DEPTH_ATTACHMENT};
+        case 32:
+            return {QOpenGLTexture::D32, QOpenGLTexture::Depth, QOpenGLTexture::UInt32, GL_DEPTH_ATTACHMENT};
+        default:
+            return {QOpenGLTexture::D24, QOpenGLTexture::Depth, QOpenGLTexture::UInt32, GL_DEPTH_ATTACHMENT};
+    }
+}
+
+/** The box faces' corners, the corner's bits are its x, y and z offsets */
+constexpr uint BoxFaces[6][4] = {{0, 4, 6, 2},
+                                 {1, 3, 7, 5},
+                                 {0, 1, 5, 4},
+                                 {2, 6, 7, 3},
+                                 {0, 2, 3, 1},
+                                 {4, 5, 7, 6}};
+
+std::shared_ptr<Mesh> createBox()
+{
+    auto box = std::make_shared<Mesh>(8, 36);
+    auto& vertices = box->getVertices();
+    auto& indices = box->getIndices();
+
+    for (uint corner = 0; corner < 8; corner++)
+    {
+        vertices[corner] = {{static_cast<float>(corner & 1),
+                             static_cast<float>((corner >> 1) & 1),
+                             static_cast<float>(corner >> 2)},
+                            {0.0f, 0.0f, 0.0f},
+                            {0.0f, 0.0f, 0.0f},
+                            {0.0f, 0.0f}};
+    }
+
+    uint index{0};
+    for (const auto& face : BoxFaces)
+    {
+        for (auto corner : {face[0], face[1], face[2], face[0], face[2], face[3]})
+        {
+            indices[index++] = corner;
+        }
+    }
+
+    return box;
+}
+
+}
+
+VolumePipe::VolumePipe(std::shared_ptr<Program> program,
+                       const figures::Volume& volume,
+                       const Parameters& parameters) :
+    ScenePipe(program, defaults::attributes::Vertex),
+    mVolume(volume),
+    mParameters(parameters),
+    mPyramid(volume, parameters.brickSize)
+{
+    // the rays start at the back faces, so the camera could be inside the volume
+    auto renderParameters = std::make_shared<Item::RenderParameters>(
+                Item::RenderParameters{GL_TRIANGLES,
+                                       1.0f,
+                                       1.0f,
+                                       {GL_BLEND, GL_CULL_FACE},
+                                       {GL_DEPTH_TEST}});
+
+    mBox = std::make_shared<Item>(createBox(), renderParameters, nullptr, nullptr);
+    addItem(mBox);
+}
+
+VolumePipe::~VolumePipe()
+{
+    mContextGuard.release();
+}
+
+void VolumePipe::setTransferFunction(float minValue,
+                                     float maxValue,
+                                     const std::vector<Color>& transferFunction)
+{
+    mParameters.minValue = minValue;
+    mParameters.maxValue = maxValue;
+    mParameters.transferFunction = transferFunction;
+    mIsUploaded = false;
+}
+
+void VolumePipe::render(std::shared_ptr<Camera> camera,
+                        const Lights&,
+                        const Textures&)
+{
+    if (!mIsInitialized || !mIsAllocated)
+    {
+        return;
+    }
+
+    if (!mIsUploaded)
+    {
+        uploadTransferFunction();
+        uploadBricks();
+        mIsUploaded = true;
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    copySceneDepth(viewport[2], viewport[3]);
+
+    auto manipulator = camera->getManipulator();
+    auto stepSize = manipulator && manipulator->isDragMode()
+            ? mParameters.interactiveStepSize
+            : mParameters.stepSize;
+
+    // the box's texture coordinates are mapped to the volume centered at the origin
+    Vec3 volumeSize(mVolume.width - 1, mVolume.height - 1, mVolume.depth - 1);
+    Mat4 model = mBox->getTransformation();
+    model.scale(mVolume.cellSize);
+    model.translate(-volumeSize / 2.0f);
+    model.scale(volumeSize);
+
+    const auto& renderParameters = mBox->getRenderParameters();
+
+    bind();
+    mProgram->setView(camera->getPosition(),
+                      camera->getProjection(),
+                      camera->getView());
+    mProgram->setTransformation(model);
+    mProgram->setAlfa(renderParameters->alfa);
+    mProgram->setUniformValue("inverseTransformation",
+                              (camera->getProjection() * camera->getView() * model).inverted());
+    mProgram->setUniformValue("cameraPos", model.inverted().map(camera->getPosition()));
+    mProgram->setUniformValue("volumeSize", volumeSize);
+    mProgram->setUniformValue("atlasSize", mAtlasSize);
+    mProgram->setUniformValue("brickSize", static_cast<float>(mPyramid.getBrickSize()));
+    mProgram->setUniformValue("cellStep", static_cast<float>(1u << mStats.lod));
+    mProgram->setUniformValue("valueRange", Vec2(mParameters.minValue, mParameters.maxValue));
+    mProgram->setUniformValue("viewportSize", Vec2(viewport[2], viewport[3]));
+    mProgram->setUniformValue("stepSize", stepSize);
+    mProgram->setUniformValue("atlas", 0);
+    mProgram->setUniformValue("pageTable", 1);
+    mProgram->setUniformValue("transferFunction", 2);
+    mProgram->setUniformValue("sceneDepth", 3);
+
+    mAtlas->bind(0);
+    mPageTable->bind(1);
+    mTransferFunction->bind(2);
+    mSceneDepth->bind(3);
+
+    for (const auto& param : renderParameters->enableAttributes)
+    {
+        glEnable(param);
+    }
+    for (const auto& param : renderParameters->disableAttributes)
+    {
+        glDisable(param);
+    }
+
+    glCullFace(GL_FRONT);
+    glDepthMask(GL_FALSE);
+
+    glDrawElementsBaseVertex(renderParameters->renderMode,
+                             mBox->getElementsCount(),
+                             GL_UNSIGNED_INT,
+                             reinterpret_cast<void*>(
+                                 mBox->getElementsStartIndex() * sizeof(uint)),
+                             mBox->getBaseVertex());
+
+    glDepthMask(GL_TRUE);
+    glCullFace(GL_BACK);
+
+    release();
+}
+
+std::size_t VolumePipe::getUploadedBricksCount() const
+{
+    return mStats.uploadedBricksCount;
+}
+
+VolumePipe::Stats VolumePipe::getStats() const
+{
+    return mStats;
+}
+
+void VolumePipe::uploadBricks()
+{
+    memory::ArenaScope scope(memory::getTransientArena());
+
+    // the values which are mapped to the transparent entries are not uploaded,
+    // the values out of the range are clamped to the ends of the transfer function
+    const auto& transferFunction = mParameters.transferFunction;
+    auto isVisible = [](const Color& color) { return color.alphaF() > 0.0; };
+    auto first = std::find_if(transferFunction.begin(), transferFunction.end(), isVisible);
+    auto last = std::find_if(transferFunction.rbegin(), transferFunction.rend(), isVisible);
+
+    std::pmr::vector<BrickPyramid::Brick> bricks(scope.getResource());
+
+    if (first != transferFunction.end())
+    {
+        auto step = (mParameters.maxValue - mParameters.minValue) /
+                std::max<std::size_t>(1, transferFunction.size() - 1);
+        auto firstIndex = std::distance(transferFunction.begin(), first);
+        auto lastIndex = std::distance(last, transferFunction.rend()) - 1;
+
+        auto minValue = firstIndex == 0
+                ? std::numeric_limits<float>::lowest()
+                : mParameters.minValue + step * (firstIndex - 1);
+        auto maxValue = lastIndex + 1 == static_cast<long>(transferFunction.size())
+                ? std::numeric_limits<float>::max()
+                : mParameters.minValue + step * (lastIndex + 1);
+
+        bricks = mPyramid.findBricks(minValue, maxValue, scope.getResource());
+    }
+
+    GLint maxTextureSize{0};
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxTextureSize);
+
+    // the brick keeps the samples of its far faces for the linear filtering
+    auto side = mPyramid.getBrickSize() + 1;
+    auto maxBricks = std::min<uint>(MaxAtlasBricks, std::max(1u, maxTextureSize / side));
+
+    // the samples are staged on the CPU too, so the budget limits both copies
+    auto brickBytes = static_cast<std::size_t>(side) * side * side * sizeof(float);
+
+    auto getAtlas = [maxBricks](std::size_t count)
+    {
+        std::array<uint, 3> atlas;
+        atlas[0] = std::clamp<uint>(std::ceil(std::cbrt(count)), 1, maxBricks);
+        atlas[1] = std::clamp<uint>(std::ceil(std::sqrt((count + atlas[0] - 1) / atlas[0])), 1, maxBricks);
+        atlas[2] = std::clamp<uint>((count + atlas[0] * atlas[1] - 1) / (atlas[0] * atlas[1]), 1, maxBricks);
+        return atlas;
+    };
+
+    auto isFitting = [&](std::size_t count)
+    {
+        auto atlas = getAtlas(count);
+        auto atlasBricks = static_cast<std::size_t>(atlas[0]) * atlas[1] * atlas[2];
+        return atlasBricks >= count && atlasBricks * brickBytes <= mParameters.maxAtlasBytes;
+    };
+
+    mStats = {};
+    mStats.visibleBricksCount = bricks.size();
+
+    // the bricks which do not fit are joined 2x2x2, the joined brick is sampled with the doubled step
+    auto bricksCount = mPyramid.getBricksCount();
+
+    while (!isFitting(bricks.size()) &&
+           std::max({bricksCount[0], bricksCount[1], bricksCount[2]}) > 1)
+    {
+        for (auto& count : bricksCount)
+        {
+            count = (count + 1) / 2;
+        }
+
+        std::vector<bool> isJoined(static_cast<std::size_t>(bricksCount[0]) * bricksCount[1] * bricksCount[2]);
+        std::pmr::vector<BrickPyramid::Brick> joined(scope.getResource());
+
+        for (const auto& brick : bricks)
+        {
+            BrickPyramid::Brick parent{brick[0] / 2, brick[1] / 2, brick[2] / 2};
+            auto index = (static_cast<std::size_t>(parent[2]) * bricksCount[1] + parent[1]) *
+                    bricksCount[0] + parent[0];
+
+            if (!isJoined[index])
+            {
+                isJoined[index] = true;
+                joined.push_back(parent);
+            }
+        }
+
+        bricks.swap(joined);
+        mStats.lod++;
+    }
+
+    const auto cellStep = 1u << mStats.lod;
+    const auto brickCells = mPyramid.getBrickSize() * cellStep;
+
+    // only the coarsest level which does not fit drops the bricks, they are reported by the stats
+    auto count = static_cast<uint>(bricks.size());
+    auto atlas = getAtlas(count);
+
+    while (atlas[2] > 1 && static_cast<std::size_t>(atlas[0]) * atlas[1] * atlas[2] * brickBytes >
+           mParameters.maxAtlasBytes)
+    {
+        atlas[2]--;
+    }
+
+    count = std::min(count, atlas[0] * atlas[1] * atlas[2]);
+    mStats.droppedBricksCount = bricks.size() - count;
+    std::vector<uint8_t> pages(std::max(1u, bricksCount[0] * bricksCount[1] * bricksCount[2]) * 4, 0);
+    std::vector<float> values(static_cast<std::size_t>(atlas[0] * side) * atlas[1] * side *
+                              atlas[2] * side, 0.0f);
+
+    utils::parallelFor(count, [&](std::size_t index, uint)
+    {
+        const auto& brick = bricks[index];
+        std::array<uint, 3> slot{static_cast<uint>(index % atlas[0]),
+                                 static_cast<uint>(index / atlas[0] % atlas[1]),
+                                 static_cast<uint>(index / atlas[0] / atlas[1])};
+
+        auto page = pages.data() +
+                ((static_cast<std::size_t>(brick[2]) * bricksCount[1] + brick[1]) *
+                 bricksCount[0] + brick[0]) * 4;
+        page[0] = slot[0];
+        page[1] = slot[1];
+        page[2] = slot[2];
+        page[3] = 255;
+
+        BrickPyramid::Brick first{brick[0] * brickCells, brick[1] * brickCells, brick[2] * brickCells};
+
+        for (uint z = 0; z < side; z++)
+        {
+            auto sourceZ = std::min(first[2] + z * cellStep, mVolume.depth - 1);
+
+            for (uint y = 0; y < side; y++)
+            {
+                auto sourceY = std::min(first[1] + y * cellStep, mVolume.height - 1);
+                auto source = mVolume.values +
+                        (static_cast<std::size_t>(sourceZ) * mVolume.height + sourceY) * mVolume.width;
+                auto target = values.data() +
+                        ((static_cast<std::size_t>(slot[2] * side + z) * atlas[1] * side +
+                          slot[1] * side + y) * atlas[0] * side + slot[0] * side);
+
+                for (uint x = 0; x < side; x++)
+                {
+                    target[x] = source[std::min(first[0] + x * cellStep, mVolume.width - 1)];
+                }
+            }
+        }
+    });
+
+    mAtlas = std::make_unique<Texture>(QOpenGLTexture::Target3D);
+    mAtlas->setFormat(QOpenGLTexture::R16F);
+    mAtlas->setSize(atlas[0] * side, atlas[1] * side, atlas[2] * side);
+    mAtlas->setMipLevels(1);
+    mAtlas->allocateStorage(QOpenGLTexture::Red, QOpenGLTexture::Float32);
+    mAtlas->setData(QOpenGLTexture::Red, QOpenGLTexture::Float32, values.data());
+    mAtlas->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    mAtlas->setWrapMode(QOpenGLTexture::ClampToEdge);
+
+    mPageTable = std::make_unique<Texture>(QOpenGLTexture::Target3D);
+    mPageTable->setFormat(QOpenGLTexture::RGBA8_UNorm);
+    mPageTable->setSize(std::max(1u, bricksCount[0]),
+                        std::max(1u, bricksCount[1]),
+                        std::max(1u, bricksCount[2]));
+    mPageTable->setMipLevels(1);
+    mPageTable->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+    mPageTable->setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, pages.data());
+    mPageTable->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+    mPageTable->setWrapMode(QOpenGLTexture::ClampToEdge);
+
+    mAtlasSize = Vec3(atlas[0] * side, atlas[1] * side, atlas[2] * side);
+    mStats.uploadedBricksCount = count;
+}
+
+void VolumePipe::uploadTransferFunction()
+{
+    const auto& transferFunction = mParameters.transferFunction;
+    std::vector<uint8_t> colors(TransferFunctionSize * 4, 0);
+
+    for (int i = 0; i < TransferFunctionSize && !transferFunction.empty(); i++)
+    {
+        auto position = static_cast<float>(i) / (TransferFunctionSize - 1) *
+                (transferFunction.size() - 1);
+        auto index = std::min<std::size_t>(position, transferFunction.size() - 1);
+        auto next = std::min<std::size_t>(index + 1, transferFunction.size() - 1);
+        auto t = position - index;
+
+        const auto& from = transferFunction[index];
+        const auto& to = transferFunction[next];
+
+        colors[i * 4 + 0] = std::lround(from.red() + t * (to.red() - from.red()));
+        colors[i * 4 + 1] = std::lround(from.green() + t * (to.green() - from.green()));
+        colors[i * 4 + 2] = std::lround(from.blue() + t * (to.blue() - from.blue()));
+        colors[i * 4 + 3] = std::lround(from.alpha() + t * (to.alpha() - from.alpha()));
+    }
+
+    mTransferFunction = std::make_unique<Texture>(QOpenGLTexture::Target2D);
+    mTransferFunction->setFormat(QOpenGLTexture::RGBA8_UNorm);
+    mTransferFunction->setSize(TransferFunctionSize, 1);
+    mTransferFunction->setMipLevels(1);
+    mTransferFunction->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+    mTransferFunction->setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, colors.data());
+    mTransferFunction->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    mTransferFunction->setWrapMode(QOpenGLTexture::ClampToEdge);
+}
+
+void VolumePipe::copySceneDepth(int width, int height)
+{
+    GLint framebuffer{0};
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+    if (!mSceneDepth || mDepthSize != std::make_pair(width, height) || mDepthFramebuffer == 0)
+    {
+        // the format matches the bound framebuffer's depth, otherwise the blit fails
+        GLint depthBits{24};
+        GLint stencilBits{0};
+        GLint componentType{GL_UNSIGNED_NORMALIZED};
+        auto attachment = framebuffer == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, attachment,
+                                              GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depthBits);
+        glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, attachment,
+                                              GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+        glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, attachment,
+                                              GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &componentType);
+
+        auto depthFormat = getDepthFormat(depthBits, stencilBits, componentType);
+
+        mSceneDepth = std::make_unique<Texture>(QOpenGLTexture::Target2D);
+        mSceneDepth->setFormat(depthFormat.format);
+        mSceneDepth->setSize(width, height);
+        mSceneDepth->setMipLevels(1);
+        mSceneDepth->allocateStorage(depthFormat.pixelFormat, depthFormat.pixelType);
+        mSceneDepth->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+        mSceneDepth->setWrapMode(QOpenGLTexture::ClampToEdge);
+
+        if (mDepthFramebuffer == 0)
+        {
+            mContextGuard.attach([this]() { return takeFramebuffer(); });
+            glGenFramebuffers(1, &mDepthFramebuffer);
+        }
+
+        // the stencil attachment of the previous format is detached
+        glBindFramebuffer(GL_FRAMEBUFFER, mDepthFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER,
+                               depthFormat.attachment,
+                               GL_TEXTURE_2D,
+                               mSceneDepth->textureId(),
+                               0);
+        mDepthSize = {width, height};
+    }
+
+    // the multisampled depth is resolved by the blit
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mDepthFramebuffer);
+    glBlitFramebuffer(0, 0, width, height,
+                      0, 0, width, height,
+                      GL_DEPTH_BUFFER_BIT,
+                      GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+ContextGuard::Release VolumePipe::takeFramebuffer()
+{
+    auto framebuffer = mDepthFramebuffer;
+    mDepthFramebuffer = 0;
+
+    return [framebuffer](QOpenGLExtraFunctions& functions)
+    {
+        functions.glDeleteFramebuffers(1, &framebuffer);
+    };
+}
+
+}